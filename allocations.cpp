@@ -0,0 +1,70 @@
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#include "allocations.h"
+
+static std::atomic<long long> nAllocations(0);
+static std::atomic<long long> nAllocationBytes(0);
+
+
+long long getAllocationCount()
+{
+    return nAllocations.load(std::memory_order_relaxed);
+}
+
+long long getAllocationBytes()
+{
+    return nAllocationBytes.load(std::memory_order_relaxed);
+}
+
+static void* allocate(size_t size)
+{
+    nAllocations.fetch_add(1, std::memory_order_relaxed);
+    nAllocationBytes.fetch_add((long long)size, std::memory_order_relaxed);
+    return malloc(size != 0 ? size : 1);
+}
+
+void* operator new(size_t size)
+{
+    void* memory = allocate(size);
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+    free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+    free(memory);
+}
@@ -0,0 +1,18 @@
+#ifndef ALLOCATIONS_H
+#define ALLOCATIONS_H
+
+/*
+    Heap allocation accounting. allocations.cpp replaces the global operator new and
+    delete with versions that count every allocation, on all threads, before handing it
+    to malloc. The frame loop reads the count around a frame: steady-state frames are
+    expected to allocate nothing, since an allocation can take a lock or fault in pages
+    and shows up as a slow frame.
+*/
+
+// Allocations made through operator new since the program started
+long long getAllocationCount();
+
+// Bytes requested by those allocations
+long long getAllocationBytes();
+
+#endif
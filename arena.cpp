@@ -0,0 +1,81 @@
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include "arena.h"
+
+
+Arena::Arena(size_t blockSize)
+{
+    this->nBlockSize = blockSize;
+}
+
+Arena::~Arena()
+{
+    this->release();
+}
+
+void* Arena::allocate(size_t size, size_t alignment)
+{
+    while (this->nCurrent < this->blocks.size())
+    {
+        Block& block = this->blocks[this->nCurrent];
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+        size_t offset = ((base + block.nUsed + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+        if (offset + size <= block.nSize)
+        {
+            block.nUsed = offset + size;
+            return block.data + offset;
+        }
+        this->nCurrent++;
+    }
+
+    // Room for the padding needed to align the first allocation in the new block
+    size_t blockSize = size + alignment > this->nBlockSize ? size + alignment : this->nBlockSize;
+    Block block = { static_cast<char*>(std::malloc(blockSize)), blockSize, 0 };
+    if (block.data == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    this->blocks.push_back(block);
+    this->nCurrent = this->blocks.size() - 1;
+    return this->allocate(size, alignment);
+}
+
+void Arena::reset()
+{
+    for (Block& block: this->blocks)
+    {
+        block.nUsed = 0;
+    }
+    this->nCurrent = 0;
+}
+
+void Arena::release()
+{
+    for (Block& block: this->blocks)
+    {
+        std::free(block.data);
+    }
+    this->blocks.clear();
+    this->nCurrent = 0;
+}
+
+size_t Arena::getBytesUsed() const
+{
+    size_t used = 0;
+    for (const Block& block: this->blocks)
+    {
+        used += block.nUsed;
+    }
+    return used;
+}
+
+size_t Arena::getBytesReserved() const
+{
+    size_t reserved = 0;
+    for (const Block& block: this->blocks)
+    {
+        reserved += block.nSize;
+    }
+    return reserved;
+}
@@ -0,0 +1,53 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+/*
+    Bump allocator. Memory is handed out from large blocks and only released
+    all at once, by reset() or when the arena is destroyed. Destructors of
+    objects placed in the arena are never called, so it is meant for plain data.
+*/
+
+class Arena
+{
+private:
+    struct Block
+    {
+        char* data;
+        size_t nSize;
+        size_t nUsed;
+    };
+
+    std::vector<Block> blocks;
+    size_t nBlockSize;
+    size_t nCurrent = 0;    // Block allocations are served from
+
+public:
+    explicit Arena(size_t blockSize = 64 * 1024);
+
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    // Uninitialized array of count Ts
+    template<typename T>
+    T* allocateArray(size_t count) { return static_cast<T*>(this->allocate(count * sizeof(T), alignof(T))); }
+
+    // Makes all memory available again, blocks are kept for reuse
+    void reset();
+
+    // Returns blocks to the system
+    void release();
+
+    size_t getBytesUsed() const;
+
+    size_t getBytesReserved() const;
+};
+
+#endif
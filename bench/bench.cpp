@@ -0,0 +1,737 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include "geometry.h"
+#include "objects.h"
+#include "world.h"
+#include "framebuffer.h"
+#include "renderer.h"
+#include "terminal.h"
+#include "profiler.h"
+#include "allocations.h"
+#include "raycast.h"
+#include "input.h"
+
+/*
+    Headless frame benchmark.
+    Replays a scripted camera path through the default map and reports
+    ns/ray, frames/s and p50/p99 frame time. With --replay the camera is moved by an input
+    recording of the game instead, one frame per tick.
+
+    Usage: bench [--frames N] [--width W] [--height H] [--mode linear|grid|bvh|scene|column] [--map N] [--maze] [--load FILE] [--save FILE] [--wall-limit N] [--no-merge] [--cubes N] [--agents N] [--sprites N] [--queries N] [--kernel none|scalar|sse|avx2] [--threads N] [--quality full|checkerboard|half|quarter] [--target MS] [--reproject] [--packets] [--pvs] [--path loop|turn|still|walk] [--replay FILE] [--stream MB] [--stream-radius N] [--stream-wait] [--present FILE] [--profile PREFIX]
+*/
+
+enum CameraPath
+{
+    PATH_LOOP,      // Walk a loop through the map, turning from side to side
+    PATH_TURN,      // Stand still and turn at the player's rotation speed, 60 frames per second
+    PATH_STILL,     // Stand still
+    PATH_WALK       // Walk along the map from west to east, crossing it once
+};
+
+struct BenchOptions
+{
+    int nFrames = 200;
+    int nWidth = 120;
+    int nHeight = 40;
+    int nMapSize = 0;   // 0 - default map
+    bool bMaze = false; // The generated map is a maze instead of pillars
+    const char* loadPath = nullptr;     // Map file to render instead
+    const char* savePath = nullptr;     // The map is saved to this binary map file
+    int nWallLimit = N_MAX_WALL_OBJECTS;
+    bool bMergeWalls = true;
+    int nCubes = 0;     // Free-standing cubes moving around the map
+    int nAgents = 0;    // Circles walking the map and colliding with the walls, not rendered
+    int nSprites = 0;   // Sprites moving around the map
+    int nQueries = 0;   // Ray queries cast in a batch every frame, not rendered
+    RenderMode mode = RENDER_LINEAR;
+    BoxKernelType boxKernel = getBestBoxKernel();
+    int nThreads = 1;   // 0 - hardware concurrency
+    RenderQuality quality = QUALITY_FULL;
+    float fTargetTime = 0.0f;   // Adaptive quality target in seconds, 0 - fixed quality
+    bool bReprojection = false;
+    bool bPackets = false;      // Trace 8x8 ray packets in linear and BVH mode
+    bool bVisibilityCulling = false;    // Linear mode only tests the walls the camera's square may see
+    CameraPath path = PATH_LOOP;
+    const char* replayPath = nullptr;   // Input recording moving the camera instead of the path, sets the frame count
+    size_t nStreamingCap = 0;   // Bytes of map chunks kept around the player, 0 - no streaming
+    int nStreamingRadius = 1;
+    bool bStreamingWait = false;    // Wait for the chunks around the player before every frame
+    const char* presentPath = nullptr;  // Frames are sent through TerminalOutput to this file
+    const char* profilePrefix = nullptr; // Stage times are exported to PREFIX.csv and PREFIX.json
+};
+
+static void printUsage()
+{
+    printf("Usage: bench [--frames N] [--width W] [--height H] [--mode linear|grid|bvh|scene|column] [--map N] [--maze] [--load FILE] [--save FILE] [--wall-limit N] [--no-merge] [--cubes N] [--agents N] [--sprites N] [--queries N] [--kernel none|scalar|sse|avx2] [--threads N] [--quality full|checkerboard|half|quarter] [--target MS] [--reproject] [--packets] [--pvs] [--path loop|turn|still|walk] [--replay FILE] [--stream MB] [--stream-radius N] [--stream-wait] [--present FILE] [--profile PREFIX]\n");
+}
+
+static bool parseMode(const char* name, RenderMode& mode)
+{
+    if (strcmp(name, "linear") == 0)    { mode = RENDER_LINEAR; }
+    else if (strcmp(name, "grid") == 0) { mode = RENDER_GRID; }
+    else if (strcmp(name, "bvh") == 0)  { mode = RENDER_BVH; }
+    else if (strcmp(name, "scene") == 0) { mode = RENDER_SCENE; }
+    else if (strcmp(name, "column") == 0) { mode = RENDER_COLUMN; }
+    else { return false; }
+    return true;
+}
+
+static bool parseBoxKernel(const char* name, BoxKernelType& type)
+{
+    const BoxKernelType types[] = { BOX_KERNEL_NONE, BOX_KERNEL_SCALAR, BOX_KERNEL_SSE, BOX_KERNEL_AVX2 };
+    for (BoxKernelType candidate: types)
+    {
+        if (strcmp(name, getBoxKernelName(candidate)) == 0)
+        {
+            type = candidate;
+            return isBoxKernelSupported(type);
+        }
+    }
+    return false;
+}
+
+static bool parseQuality(const char* name, RenderQuality& quality)
+{
+    for (int i = 0; i < QUALITY_COUNT; i++)
+    {
+        if (strcmp(name, Renderer::getQualityName((RenderQuality)i)) == 0)
+        {
+            quality = (RenderQuality)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parseOptions(int argc, char** argv, BenchOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "--frames") == 0)      { options.nFrames = atoi(argv[++i]); }
+        else if (i + 1 < argc && strcmp(argv[i], "--width") == 0)  { options.nWidth = atoi(argv[++i]); }
+        else if (i + 1 < argc && strcmp(argv[i], "--height") == 0) { options.nHeight = atoi(argv[++i]); }
+        else if (i + 1 < argc && strcmp(argv[i], "--map") == 0)    { options.nMapSize = atoi(argv[++i]); }
+        else if (i + 1 < argc && strcmp(argv[i], "--load") == 0)   { options.loadPath = argv[++i]; }
+        else if (i + 1 < argc && strcmp(argv[i], "--save") == 0)   { options.savePath = argv[++i]; }
+        else if (i + 1 < argc && strcmp(argv[i], "--wall-limit") == 0) { options.nWallLimit = atoi(argv[++i]); }
+        else if (i + 1 < argc && strcmp(argv[i], "--cubes") == 0)  { options.nCubes = atoi(argv[++i]); }
+        else if (i + 1 < argc && strcmp(argv[i], "--agents") == 0) { options.nAgents = atoi(argv[++i]); }
+        else if (i + 1 < argc && strcmp(argv[i], "--sprites") == 0) { options.nSprites = atoi(argv[++i]); }
+        else if (i + 1 < argc && strcmp(argv[i], "--queries") == 0) { options.nQueries = atoi(argv[++i]); }
+        else if (i + 1 < argc && strcmp(argv[i], "--threads") == 0) { options.nThreads = atoi(argv[++i]); }
+        else if (i + 1 < argc && strcmp(argv[i], "--replay") == 0) { options.replayPath = argv[++i]; }
+        else if (i + 1 < argc && strcmp(argv[i], "--present") == 0) { options.presentPath = argv[++i]; }
+        else if (i + 1 < argc && strcmp(argv[i], "--profile") == 0) { options.profilePrefix = argv[++i]; }
+        else if (strcmp(argv[i], "--reproject") == 0) { options.bReprojection = true; }
+        else if (strcmp(argv[i], "--packets") == 0) { options.bPackets = true; }
+        else if (strcmp(argv[i], "--pvs") == 0) { options.bVisibilityCulling = true; }
+        else if (strcmp(argv[i], "--maze") == 0) { options.bMaze = true; }
+        else if (strcmp(argv[i], "--no-merge") == 0) { options.bMergeWalls = false; }
+        else if (i + 1 < argc && strcmp(argv[i], "--stream") == 0) { options.nStreamingCap = (size_t)(atof(argv[++i]) * 1024 * 1024); }
+        else if (i + 1 < argc && strcmp(argv[i], "--stream-radius") == 0) { options.nStreamingRadius = atoi(argv[++i]); }
+        else if (strcmp(argv[i], "--stream-wait") == 0) { options.bStreamingWait = true; }
+        else if (i + 1 < argc && strcmp(argv[i], "--path") == 0)
+        {
+            const char* name = argv[++i];
+            if (strcmp(name, "loop") == 0)       { options.path = PATH_LOOP; }
+            else if (strcmp(name, "turn") == 0)  { options.path = PATH_TURN; }
+            else if (strcmp(name, "still") == 0) { options.path = PATH_STILL; }
+            else if (strcmp(name, "walk") == 0)  { options.path = PATH_WALK; }
+            else { return false; }
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "--target") == 0)  { options.fTargetTime = (float)atof(argv[++i]) / 1000.0f; }
+        else if (i + 1 < argc && strcmp(argv[i], "--quality") == 0)
+        {
+            if (!parseQuality(argv[++i], options.quality)) { return false; }
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "--mode") == 0)
+        {
+            if (!parseMode(argv[++i], options.mode)) { return false; }
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "--kernel") == 0)
+        {
+            if (!parseBoxKernel(argv[++i], options.boxKernel)) { return false; }
+        }
+        else { return false; }
+    }
+    return options.nFrames > 0 && options.nWidth > 0 && options.nHeight > 0 &&
+        options.nCubes >= 0 && options.nAgents >= 0 && options.nSprites >= 0 && options.nQueries >= 0 && options.nThreads >= 0 && options.fTargetTime >= 0.0f && options.nStreamingRadius >= 0 && (options.nMapSize == 0 || options.nMapSize >= 16);
+}
+
+// size x size map: the inner wall of the default map around the camera path,
+// border walls and a pillar every 6 squares outside of the first 16x16 squares.
+// A maze fills the squares outside of the first 16x16 instead of the pillars: every odd
+// square is open and opens to its north or west neighbour, picked with a fixed seed
+static std::wstring buildBenchMap(int size, bool maze)
+{
+    std::wstring map(size * size, '.');
+    unsigned int seed = 24680u;
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            bool border = x == 0 || y == 0 || x == size - 1 || y == size - 1;
+            bool outside = x >= 16 || y >= 16;
+            bool pillar = outside && x % 6 == 3 && y % 6 == 3;
+            bool mazeWall = maze && outside && (x % 2 == 0 || y % 2 == 0);
+            if (border || (maze ? mazeWall : pillar))
+            {
+                map[y * size + x] = '#';
+            }
+        }
+    }
+    for (int y = 1; maze && y < size - 1; y += 2)
+    {
+        for (int x = 1; x < size - 1; x += 2)
+        {
+            if (x < 16 && y < 16)
+            {
+                continue;
+            }
+            seed = seed * 1664525u + 1013904223u;
+            bool north = (seed >> 16) & 1;
+            if (north && y > 1)
+            {
+                map[(y - 1) * size + x] = '.';
+            }
+            else if (x > 1)
+            {
+                map[y * size + x - 1] = '.';
+            }
+            else
+            {
+                map[(y - 1) * size + x] = '.';
+            }
+        }
+    }
+    map[7 * size + 9] = '#';
+    map[7 * size + 10] = '#';
+    return map;
+}
+
+// Camera path: a loop around the middle of the map, looking along the path
+// and sweeping left/right, so every frame sees walls, floor and ceiling.
+static void setCameraPose(Player& player, CameraPath path, int frame, int frameCount, const World& world)
+{
+    if (path == PATH_WALK)
+    {
+        float span = (world.getMapWidth() - 16) * (float)N_MAP_WORLD_RATIO;
+        float t = (float)frame / (float)frameCount;
+        player.setCenterPos(Vector3D(37.5f + span * t, 37.5f + 2.0f * sinf(40.0f * t), 2.0f));
+        player.setAngle(0.5f * sinf(20.0f * t));
+        return;
+    }
+
+    if (path != PATH_LOOP)
+    {
+        setCameraPose(player, PATH_LOOP, 0, frameCount, world);
+        if (path == PATH_TURN)
+        {
+            player.setAngle(player.getAngle() + frame * 0.5f / 60.0f);
+        }
+        return;
+    }
+
+    float t = (float)frame / (float)frameCount;
+    float pathAngle = 2.0f * 3.14159f * t;
+
+    float x = 37.5f + 20.0f * cosf(pathAngle);
+    float y = 37.5f + 20.0f * sinf(pathAngle);
+    float z = 2.0f;
+
+    player.setCenterPos(Vector3D(x, y, z));
+    player.setAngle(pathAngle + 3.14159f / 2.0f + 0.75f * sinf(4.0f * pathAngle));
+}
+
+// Scatters cubes over the map with a fixed seed
+static std::vector<GameObject*> buildBenchCubes(const World& world, int count)
+{
+    std::vector<GameObject*> cubes;
+    unsigned int seed = 12345u;
+    float spanX = (world.getMapWidth() - 2) * (float)N_MAP_WORLD_RATIO;
+    float spanY = (world.getMapHeight() - 2) * (float)N_MAP_WORLD_RATIO;
+    for (int i = 0; i < count; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        float x = N_MAP_WORLD_RATIO + spanX * (seed >> 8) / 16777216.0f;
+        seed = seed * 1664525u + 1013904223u;
+        float y = N_MAP_WORLD_RATIO + spanY * (seed >> 8) / 16777216.0f;
+        cubes.push_back(new Cube(Vector3D(x, y, 2.5f), '#', COLOR_GREEN, 1.0f));
+    }
+    return cubes;
+}
+
+// Each cube walks its own small circle
+static void moveBenchCubes(World& world, const std::vector<GameObject*>& cubes, int frame)
+{
+    for (int i = 0; i < (int)cubes.size(); i++)
+    {
+        float angle = 0.05f * frame + i;
+        world.moveObject(cubes[i], Vector3D(cosf(angle), sinf(angle), 0.0f), 1.0f / 60.0f);
+    }
+}
+
+// Scatters agents over the free squares of the map with a fixed seed; the first move puts those that
+//     overlap a wall next to it
+static std::vector<CollisionMove> buildBenchAgents(const World& world, int count, std::vector<float>& headings)
+{
+    std::vector<CollisionMove> agents(count);
+    headings.resize(count);
+    unsigned int seed = 54321u;
+    float spanX = (world.getMapWidth() - 2) * (float)N_MAP_WORLD_RATIO;
+    float spanY = (world.getMapHeight() - 2) * (float)N_MAP_WORLD_RATIO;
+    for (int i = 0; i < count; i++)
+    {
+        // Squares inside walls are drawn again
+        int squareX, squareY;
+        do
+        {
+            seed = seed * 1664525u + 1013904223u;
+            agents[i].fPos[0] = N_MAP_WORLD_RATIO + spanX * (seed >> 8) / 16777216.0f;
+            seed = seed * 1664525u + 1013904223u;
+            agents[i].fPos[1] = N_MAP_WORLD_RATIO + spanY * (seed >> 8) / 16777216.0f;
+            squareX = (int)floorf(agents[i].fPos[0] / N_MAP_WORLD_RATIO + 0.5f);
+            squareY = (int)floorf(agents[i].fPos[1] / N_MAP_WORLD_RATIO + 0.5f);
+        }
+        while (world.getCollisionMap().isWall(squareX, squareY));
+        agents[i].fRadius = 1.0f;
+        headings[i] = (float)i;
+    }
+    return agents;
+}
+
+// Agents walk straight at 20 world units per second and turn when they run into a wall
+static void setBenchAgentMoves(std::vector<CollisionMove>& agents, std::vector<float>& headings)
+{
+    for (int i = 0; i < (int)agents.size(); i++)
+    {
+        if (agents[i].bHit)
+        {
+            headings[i] += 2.0f;
+        }
+        agents[i].fDelta[0] = cosf(headings[i]) * 20.0f / 60.0f;
+        agents[i].fDelta[1] = sinf(headings[i]) * 20.0f / 60.0f;
+    }
+}
+
+// Rays from random free squares at eye level and below; their directions turn a bit every frame
+static std::vector<RayQuery> buildBenchQueries(const World& world, int count, std::vector<float>& headings)
+{
+    std::vector<RayQuery> queries(count);
+    std::vector<float> unusedHeadings;
+    std::vector<CollisionMove> origins = buildBenchAgents(world, count, unusedHeadings);
+    headings.resize(count);
+    unsigned int seed = 98765u;
+    for (int i = 0; i < count; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        queries[i].fOrigin[0] = origins[i].fPos[0];
+        queries[i].fOrigin[1] = origins[i].fPos[1];
+        queries[i].fOrigin[2] = 0.5f + 4.0f * (seed >> 8) / 16777216.0f;
+        queries[i].fDirection[2] = -0.05f + 0.1f * (i % 11) / 10.0f;
+        queries[i].fMaxDistance = 300.0f;
+        headings[i] = (float)i * 2.39996f;
+    }
+    return queries;
+}
+
+static void setBenchQueryDirections(std::vector<RayQuery>& queries, const std::vector<float>& headings, int frameIndex)
+{
+    for (int i = 0; i < (int)queries.size(); i++)
+    {
+        float angle = headings[i] + frameIndex * 0.05f;
+        queries[i].fDirection[0] = cosf(angle);
+        queries[i].fDirection[1] = sinf(angle);
+    }
+}
+
+// Scatters sprites over the map with a fixed seed, letters of the alphabet in turn
+static void addBenchSprites(World& world, int count)
+{
+    unsigned int seed = 98765u;
+    float spanX = (world.getMapWidth() - 2) * (float)N_MAP_WORLD_RATIO;
+    float spanY = (world.getMapHeight() - 2) * (float)N_MAP_WORLD_RATIO;
+    for (int i = 0; i < count; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        float x = N_MAP_WORLD_RATIO + spanX * (seed >> 8) / 16777216.0f;
+        seed = seed * 1664525u + 1013904223u;
+        float y = N_MAP_WORLD_RATIO + spanY * (seed >> 8) / 16777216.0f;
+        Sprite sprite = { { x, y, 1.5f }, 1.5f, 3.0f, (Glyph)('a' + i % 26), COLOR_RED | COLOR_INTENSITY };
+        world.addSprite(sprite);
+    }
+}
+
+// Each sprite bobs up and down at its own phase
+static void moveBenchSprites(World& world, int frame)
+{
+    for (int i = 0; i < (int)world.getSprites().size(); i++)
+    {
+        const Sprite& sprite = world.getSprites()[i];
+        world.setSpritePos(i, Vector3D(sprite.fPos[0], sprite.fPos[1], 1.5f + 0.5f * sinf(0.1f * frame + i)));
+    }
+}
+
+// FNV-1a over the framebuffer, printed so that render paths can be compared
+static unsigned int hashFrame(const Framebuffer& frame, unsigned int hash)
+{
+    for (int i = 0; i < frame.size(); i++)
+    {
+        hash = (hash ^ (unsigned int)frame.chars[i]) * 16777619u;
+        hash = (hash ^ (unsigned int)frame.colors[i]) * 16777619u;
+    }
+    return hash;
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    InputRecording recording;
+    if (options.replayPath != nullptr)
+    {
+        if (!recording.load(options.replayPath) || recording.getTickCount() == 0)
+        {
+            printf("Can't load input recording %s\n", options.replayPath);
+            return 1;
+        }
+        options.nFrames = (int)recording.getTickCount();
+    }
+    InputPlayback playback(recording);
+
+    World world;
+    world.setWallObjectLimit(options.nWallLimit);
+    world.setMergeWalls(options.bMergeWalls);
+    world.setBuildPvs(options.bVisibilityCulling);
+    if (options.nStreamingCap > 0)
+    {
+        world.enableStreaming(options.nStreamingCap, options.nStreamingRadius);
+    }
+    auto loadStart = std::chrono::steady_clock::now();
+    if (options.loadPath != nullptr)
+    {
+        if (!world.loadMap(options.loadPath))
+        {
+            printf("Can't load map %s\n", options.loadPath);
+            return 1;
+        }
+    }
+    else if (options.nMapSize > 0)
+    {
+        world.setMap(options.nMapSize, options.nMapSize, buildBenchMap(options.nMapSize, options.bMaze));
+    }
+    else
+    {
+        world.setUpMap();
+    }
+    auto loadEnd = std::chrono::steady_clock::now();
+    world.buildWorldFromMap();
+    auto buildEnd = std::chrono::steady_clock::now();
+
+    if (options.savePath != nullptr && !world.saveMap(options.savePath))
+    {
+        printf("Can't save map %s\n", options.savePath);
+        return 1;
+    }
+
+    std::vector<GameObject*> cubes = buildBenchCubes(world, options.nCubes);
+    world.addObjects(cubes);
+    addBenchSprites(world, options.nSprites);
+    long long spritesDrawn = 0;
+    long long candidates = 0;
+    long long spriteCells = 0;
+    // Agents are scattered over the whole map, where a map streamed from its file is solid until loaded
+    if (options.nAgents > 0 && world.getMapFile().isStreamed())
+    {
+        printf("--agents needs the map cells in memory, a binary map streamed with --stream has them only in the file\n");
+        return 1;
+    }
+    std::vector<float> agentHeadings;
+    std::vector<CollisionMove> agents = buildBenchAgents(world, options.nAgents, agentHeadings);
+    double agentTime = 0.0;
+    long long agentMoves = 0;
+    long long agentHits = 0;
+    long long agentsInWalls = 0;
+    std::vector<float> queryHeadings;
+    std::vector<RayQuery> queries = buildBenchQueries(world, options.nQueries, queryHeadings);
+    std::vector<RayQueryHit> queryHits(queries.size());
+    double queryTime = 0.0;
+    long long queriesCast = 0;
+    long long queryHitCount = 0;
+
+    Renderer renderer;
+    renderer.setMode(options.mode);
+    renderer.setBoxKernel(options.boxKernel);
+    renderer.setQuality(options.quality);
+    renderer.setAdaptiveQuality(options.fTargetTime);
+    renderer.setReprojection(options.bReprojection);
+    renderer.setPacketTracing(options.bPackets);
+    renderer.setVisibilityCulling(options.bVisibilityCulling);
+
+    // Reduced quality and reprojected frames are compared with fully traced ones rendered outside the timed part
+    bool compare = options.quality != QUALITY_FULL || options.fTargetTime > 0.0f || options.bReprojection;
+    Renderer reference;
+    reference.setMode(options.mode);
+    reference.setBoxKernel(options.boxKernel);
+
+    ThreadPool pool(options.nThreads);
+    RayCaster caster;
+    caster.setBoxKernel(options.boxKernel);
+    if (pool.getThreadCount() > 1)
+    {
+        renderer.setThreadPool(&pool);
+        reference.setThreadPool(&pool);
+        caster.setThreadPool(&pool);
+    }
+    Framebuffer frame(options.nWidth, options.nHeight);
+    Framebuffer referenceFrame(options.nWidth, options.nHeight);
+    long long rays = 0;
+    long long differentCells = 0;
+    int qualityFrames[QUALITY_COUNT] = {};
+    Player player(Vector3D(40, 40, 2.0f), 2.0f);
+
+    FILE* presentFile = nullptr;
+    if (options.presentPath != nullptr)
+    {
+        presentFile = fopen(options.presentPath, "wb");
+        if (presentFile == nullptr)
+        {
+            printf("Can't open %s\n", options.presentPath);
+            return 1;
+        }
+    }
+    TerminalOutput output(presentFile != nullptr ? fileno(presentFile) : -1);
+    double presentTime = 0.0;
+    long long firstFrameBytes = 0;
+
+    Profiler profiler(options.nFrames);
+    if (options.profilePrefix != nullptr)
+    {
+        renderer.setProfiler(&profiler);
+    }
+
+    std::vector<double> frameTimes;
+    frameTimes.reserve(options.nFrames);
+    unsigned int hash = 2166136261u;
+    long long firstFrameAllocations = 0;
+    long long steadyAllocations = 0;
+
+    for (int i = 0; i < options.nFrames; i++)
+    {
+        if (options.replayPath != nullptr)
+        {
+            // The player moves as in the game, with its collision radius
+            applyPlayerInput(player, playback.poll(i), recording.getTickSeconds(), world.getCollisionMap(), 1.0f);
+        }
+        else
+        {
+            setCameraPose(player, options.path, i, options.nFrames, world);
+        }
+        if (!agents.empty())
+        {
+            // Timed on their own, frames are the same with and without agents
+            setBenchAgentMoves(agents, agentHeadings);
+            auto agentStart = std::chrono::steady_clock::now();
+            world.getCollisionMap().moveAll(agents.data(), (int)agents.size(), pool.getThreadCount() > 1 ? &pool : nullptr);
+            agentTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - agentStart).count();
+            agentMoves += agents.size();
+            for (const CollisionMove& agent: agents)
+            {
+                agentHits += agent.bHit;
+                agentsInWalls += world.getCollisionMap().overlaps(agent.fPos, agent.fRadius);
+            }
+        }
+        if (options.bStreamingWait)
+        {
+            world.updateStreaming(player.getCenterPos());
+            world.waitForStreaming();
+        }
+
+        ProfileTime frameStart = getProfileTime();
+        long long allocations = getAllocationCount();
+        auto time1 = std::chrono::steady_clock::now();
+        world.updateStreaming(player.getCenterPos());
+        moveBenchCubes(world, cubes, i);
+        moveBenchSprites(world, i);
+        RenderQuality quality = renderer.getQuality();
+        renderer.render(player, world, frame);
+        auto time2 = std::chrono::steady_clock::now();
+        allocations = getAllocationCount() - allocations;
+        (i == 0 ? firstFrameAllocations : steadyAllocations) += allocations;
+
+        frameTimes.push_back(std::chrono::duration<double>(time2 - time1).count());
+        hash = hashFrame(frame, hash);
+        rays += renderer.getRaysTraced();
+        spritesDrawn += renderer.getSpritesDrawn();
+        candidates += renderer.getCandidateCount();
+        spriteCells += renderer.getSpriteCells();
+        qualityFrames[quality]++;
+
+        if (!queries.empty())
+        {
+            // Timed on their own against the world of this frame
+            setBenchQueryDirections(queries, queryHeadings, i);
+            auto queryStart = std::chrono::steady_clock::now();
+            caster.castAll(world, queries.data(), (int)queries.size(), queryHits.data());
+            queryTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - queryStart).count();
+            queriesCast += queries.size();
+            for (const RayQueryHit& hit: queryHits)
+            {
+                queryHitCount += hit.bHit;
+            }
+        }
+
+        if (compare)
+        {
+            reference.render(player, world, referenceFrame);
+            for (int cell = 0; cell < frame.size(); cell++)
+            {
+                differentCells += frame.chars[cell] != referenceFrame.chars[cell] || frame.colors[cell] != referenceFrame.colors[cell];
+            }
+        }
+
+        if (presentFile != nullptr)
+        {
+            time1 = std::chrono::steady_clock::now();
+            ScopedTimer timer(options.profilePrefix != nullptr ? &profiler : nullptr, STAGE_PRESENT);
+            output.present(frame);
+            if (i == 0)
+            {
+                firstFrameBytes = output.getLastFrameBytes();
+            }
+            time2 = std::chrono::steady_clock::now();
+            presentTime += std::chrono::duration<double>(time2 - time1).count();
+        }
+
+        if (options.profilePrefix != nullptr)
+        {
+            profiler.endFrame(frameStart);
+        }
+    }
+
+    double totalTime = 0.0;
+    for (double t: frameTimes)
+    {
+        totalTime += t;
+    }
+
+    std::vector<double> sorted = frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+    double p50 = sorted[(sorted.size() - 1) * 50 / 100];
+    double p99 = sorted[(sorted.size() - 1) * 99 / 100];
+
+    const char* modeNames[] = { "linear", "grid", "bvh", "scene", "column" };
+    printf("mode        %s\n", modeNames[options.mode]);
+    printf("box kernel  %s\n", getBoxKernelName(renderer.getBoxKernelType()));
+    if (options.bPackets)
+    {
+        bool packets = options.mode == RENDER_LINEAR || options.mode == RENDER_BVH;
+        printf("packets     %s\n", packets ? "8x8" : "off (linear and bvh mode only)");
+    }
+    if (options.bVisibilityCulling)
+    {
+        const PvsTable& pvs = world.getPvs();
+        printf("pvs         %d sets over %d wall objects, %zu bytes, %.1f of %d objects tested per frame%s\n", pvs.getSetCount(),
+            pvs.getBoxCount(), pvs.getBytesUsed(), (double)candidates / options.nFrames, (int)world.getObjects().size(),
+            !pvs.isBuilt() ? " (no sets for this map)" : options.mode != RENDER_LINEAR ? " (linear mode only)" : "");
+    }
+    if (options.replayPath != nullptr)
+    {
+        printf("replay      %s, %lld ticks of %.2f ms, %d input events\n", options.replayPath, recording.getTickCount(),
+            recording.getTickSeconds() * 1e3, (int)recording.getEvents().size());
+    }
+    printf("threads     %d\n", pool.getThreadCount());
+    printf("frames      %d (%dx%d)\n", options.nFrames, options.nWidth, options.nHeight);
+    printf("map         %dx%d, %d walls as %s, loaded in %.3f ms%s, built in %.3f ms\n", world.getMapWidth(), world.getMapHeight(),
+        world.getMapFile().getWallCount(), world.hasWallObjects() ? "objects" : "grid cells",
+        std::chrono::duration<double>(loadEnd - loadStart).count() * 1e3, world.getMapFile().isMapped() ? " (mapped)" : "",
+        std::chrono::duration<double>(buildEnd - loadEnd).count() * 1e3);
+    if (world.hasWallObjects())
+    {
+        printf("walls       %d squares as %d boxes, %d faces (%d unmerged)\n", world.getMapFile().getWallCount(), world.getWallBoxCount(),
+            6 * world.getWallBoxCount(), 6 * world.getMapFile().getWallCount());
+    }
+    printf("objects     %d\n", (int)world.getObjects().size());
+    if (options.nStreamingCap > 0)
+    {
+        const ChunkStreamer& streamer = world.getStreamer();
+        printf("streaming   %d chunks resident (%zu bytes, %zu allocated), %lld loads, %lld evictions\n",
+            streamer.getResidentCount(), streamer.getResidentBytes(), streamer.getAllocatedBytes(),
+            streamer.getLoadCount(), streamer.getEvictionCount());
+    }
+    if (options.nSprites > 0)
+    {
+        printf("sprites     %d, %.1f in view and %.1f cells covered per frame\n", options.nSprites,
+            (double)spritesDrawn / options.nFrames, (double)spriteCells / options.nFrames);
+    }
+    if (!agents.empty())
+    {
+        printf("agents      %d, %.1f ns/move, %.1f%% of moves hit a wall, %lld inside walls after a move\n", (int)agents.size(),
+            agentTime * 1e9 / agentMoves, 100.0 * agentHits / agentMoves, agentsInWalls);
+    }
+    if (!queries.empty())
+    {
+        printf("queries     %d per frame, %.1f ns/query, %.1f%% hit something\n", (int)queries.size(),
+            queryTime * 1e9 / queriesCast, 100.0 * queryHitCount / queriesCast);
+    }
+    printf("scene       %d boxes, %d planes, %d bytes\n", world.getScene().getBoxCount(), world.getScene().getPlaneCount(),
+        (int)world.getScene().getBytesUsed());
+    printf("rays        %lld\n", rays);
+    printf("ns/ray      %.2f\n", totalTime * 1e9 / rays);
+    printf("frames/s    %.2f\n", options.nFrames / totalTime);
+    printf("p50 frame   %.3f ms\n", p50 * 1e3);
+    printf("p99 frame   %.3f ms\n", p99 * 1e3);
+    printf("checksum    %08x\n", hash);
+    printf("allocations %.2f per frame after the first (first %lld)\n",
+        options.nFrames > 1 ? (double)steadyAllocations / (options.nFrames - 1) : 0.0, firstFrameAllocations);
+
+    if (compare)
+    {
+        printf("quality    ");
+        for (int i = 0; i < QUALITY_COUNT; i++)
+        {
+            printf(" %s %d", Renderer::getQualityName((RenderQuality)i), qualityFrames[i]);
+        }
+        printf(" (frames)\n");
+        printf("rays/frame  %.1f of %d\n", (double)rays / options.nFrames, frame.size());
+        printf("differing   %.2f%% of cells vs fully traced\n", 100.0 * differentCells / ((double)options.nFrames * frame.size()));
+    }
+
+    if (presentFile != nullptr)
+    {
+        printf("bytes/frame %.1f (first %lld)\n", (double)output.getTotalBytes() / output.getFrameCount(), firstFrameBytes);
+        printf("present     %.3f ms/frame\n", presentTime * 1e3 / output.getFrameCount());
+        fclose(presentFile);
+    }
+
+    if (options.profilePrefix != nullptr)
+    {
+        printf("\n%-16s %9s %9s   (last frames, ms)\n", "stage", "mean", "p99");
+        for (int i = 0; i < STAGE_COUNT; i++)
+        {
+            ProfileStage stage = (ProfileStage)i;
+            printf("%-16s %9.3f %9.3f\n", Profiler::getStageName(stage), profiler.getMean(stage) / 1e6,
+                profiler.getPercentile(stage, 99) / 1e6);
+        }
+
+        std::string prefix = options.profilePrefix;
+        if (!profiler.exportCsv(prefix + ".csv") || !profiler.exportChromeTrace(prefix + ".json"))
+        {
+            printf("Can't write %s.csv / %s.json\n", options.profilePrefix, options.profilePrefix);
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+#include "geometry.h"
+#include "objects.h"
+#include "boxkernel.h"
+
+/*
+    Micro-benchmark of the ray - box kernels against Cube::getIntersection.
+    Every ray is tested against all boxes; results of every kernel are checked
+    against the Cube path and must match exactly.
+
+    Usage: boxbench [--boxes N] [--rays N]
+*/
+
+struct Nearest
+{
+    int nIndex;
+    float fDistance;
+    Glyph wChar;
+};
+
+static float nextRandom(unsigned int& seed)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return (seed >> 8) / 16777216.0f;
+}
+
+int main(int argc, char** argv)
+{
+    int nBoxes = 64;
+    int nRays = 20000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "--boxes") == 0)     { nBoxes = atoi(argv[++i]); }
+        else if (i + 1 < argc && strcmp(argv[i], "--rays") == 0) { nRays = atoi(argv[++i]); }
+        else
+        {
+            printf("Usage: boxbench [--boxes N] [--rays N]\n");
+            return 1;
+        }
+    }
+
+    const float fDepth = 60.0f;
+    unsigned int seed = 2024u;
+
+    // Boxes scattered over a 80x80 area, rays from inside it in random directions
+    std::vector<Cube*> cubes;
+    BoxArray boxes;
+    boxes.resize(nBoxes);
+    for (int i = 0; i < nBoxes; i++)
+    {
+        Cube* cube = new Cube(Vector3D(80.0f * nextRandom(seed), 80.0f * nextRandom(seed), 2.5f), '#', COLOR_BLUE, 0.0f);
+        Vector3D minCorner, maxCorner;
+        cube->getBounds(minCorner, maxCorner);
+        boxes.set(i, minCorner, maxCorner);
+        cubes.push_back(cube);
+    }
+
+    std::vector<Line> rays;
+    for (int i = 0; i < nRays; i++)
+    {
+        Vector3D origin(80.0f * nextRandom(seed), 80.0f * nextRandom(seed), 5.0f * nextRandom(seed));
+        Vector3D direction(nextRandom(seed) - 0.5f, nextRandom(seed) - 0.5f, 0.5f * (nextRandom(seed) - 0.5f));
+        rays.push_back(Line(origin, direction));
+    }
+
+    // Reference: the Cube path
+    std::vector<Nearest> reference(nRays);
+    auto time1 = std::chrono::steady_clock::now();
+    for (int r = 0; r < nRays; r++)
+    {
+        Nearest nearest = { -1, fDepth, ' ' };
+        for (int i = 0; i < nBoxes; i++)
+        {
+            std::pair<float, Glyph> intersection = cubes[i]->getIntersection(rays[r], fDepth);
+            if (intersection.first > 0 && intersection.first < nearest.fDistance)
+            {
+                nearest.nIndex = i;
+                nearest.fDistance = intersection.first;
+                nearest.wChar = intersection.second;
+            }
+        }
+        reference[r] = nearest;
+    }
+    auto time2 = std::chrono::steady_clock::now();
+    double tests = (double)nRays * nBoxes;
+    printf("%-8s %8.2f ns/test\n", "cube", std::chrono::duration<double>(time2 - time1).count() * 1e9 / tests);
+
+    int result = 0;
+    const BoxKernelType types[] = { BOX_KERNEL_SCALAR, BOX_KERNEL_SSE, BOX_KERNEL_AVX2 };
+    for (BoxKernelType type: types)
+    {
+        BoxKernel kernel = getBoxKernel(type);
+        if (kernel == nullptr)
+        {
+            printf("%-8s unsupported\n", getBoxKernelName(type));
+            continue;
+        }
+
+        std::vector<Nearest> results(nRays);
+        time1 = std::chrono::steady_clock::now();
+        for (int r = 0; r < nRays; r++)
+        {
+            BoxRay ray(rays[r]);
+            float t;
+            int hit = kernel(boxes, 0, nBoxes, ray, fDepth * fDepth, t);
+            Nearest nearest = { -1, fDepth, ' ' };
+            if (hit != -1)
+            {
+                nearest.nIndex = hit;
+                nearest.fDistance = sqrtf(t);
+                nearest.wChar = cubes[hit]->getCharByDistance(fDepth, t);
+            }
+            results[r] = nearest;
+        }
+        time2 = std::chrono::steady_clock::now();
+
+        int mismatches = 0;
+        for (int r = 0; r < nRays; r++)
+        {
+            if (results[r].nIndex != reference[r].nIndex || results[r].fDistance != reference[r].fDistance ||
+                results[r].wChar != reference[r].wChar)
+            {
+                mismatches++;
+            }
+        }
+
+        printf("%-8s %8.2f ns/test  %d mismatches\n", getBoxKernelName(type),
+            std::chrono::duration<double>(time2 - time1).count() * 1e9 / tests, mismatches);
+        if (mismatches > 0)
+        {
+            result = 1;
+        }
+    }
+
+    for (Cube* cube: cubes)
+    {
+        delete cube;
+    }
+    return result;
+}
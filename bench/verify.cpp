@@ -0,0 +1,1008 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <climits>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "geometry.h"
+#include "objects.h"
+#include "world.h"
+#include "framebuffer.h"
+#include "renderer.h"
+#include "threadpool.h"
+#include "collision.h"
+#include "raycast.h"
+#include "pvs.h"
+#include "wallmesh.h"
+#include "input.h"
+
+/*
+    Headless regression check of the renderer.
+    First the geometry edge cases are checked against the values they are known to give, and
+    collision moves against the positions they have to end at. Batched ray queries have to
+    find what testing every object finds, and potentially visible sets have to hold the walls
+    a square sees and leave out those it can't. Input recordings have to load as they were
+    saved and move the player the same way every time they are played back.
+    Then fixed camera poses are rendered in a few worlds by every render path, and each frame
+    has to match the frame of the reference path (linear mode, no box kernel, one thread)
+    cell by cell. Reduced quality and reprojection are left out, they aren't meant to match.
+    Poses on a square boundary looking straight along an axis send rays exactly along wall
+    faces and through the edges where walls meet the floor and ceiling; those have to match too.
+
+    The reference frames are also compared with the golden frames checked in under
+    bench/golden, which guards the reference path itself. Float results can differ with the
+    compiler, the C library and the instructions the compiler may use, so golden files are
+    kept per build (see getBuildKey); a build without one reports that and skips the compare.
+    Every path is timed as the fastest of a few renders of each pose, relative to the reference
+    path, so the numbers carry over between machines. A run fails if a path got slower than in
+    the checked-in perf file of the build by more than the tolerance.
+    --write-golden and --write-perf write the files, e.g. after a change that is meant to change
+    the frames, --golden and --perf compare with other files. Exits with 1 if any check fails.
+
+    Usage: verify [--width W] [--height H] [--write-golden FILE] [--golden FILE] [--no-golden]
+                  [--write-perf FILE] [--perf FILE] [--no-perf] [--tolerance PERCENT]
+*/
+
+struct VerifyOptions
+{
+    int nWidth = 120;
+    int nHeight = 40;
+    const char* writeGoldenPath = nullptr;
+    const char* goldenPath = nullptr;
+    const char* writePerfPath = nullptr;
+    const char* perfPath = nullptr;
+    bool bGolden = true;
+    bool bPerf = true;
+    float fTolerance = 100.0f;  // Percent a path may be slower than in the perf file
+};
+
+struct RenderPath
+{
+    const char* name;
+    RenderMode mode;
+    BoxKernelType boxKernel;
+    bool bPackets;
+    bool bThreads;
+    bool bVisibilityCulling;
+};
+
+struct PathResult
+{
+    std::string name;
+    double fNsPerRay;
+    double fRelativeTime;   // ns/ray over that of the reference path
+    long long nMismatches;
+};
+
+static int nChecks = 0;
+static int nFailedChecks = 0;
+
+static void check(bool condition, const char* name)
+{
+    nChecks++;
+    if (!condition)
+    {
+        nFailedChecks++;
+        printf("FAILED      %s\n", name);
+    }
+}
+
+static bool parseOptions(int argc, char** argv, VerifyOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "--width") == 0)                 { options.nWidth = atoi(argv[++i]); }
+        else if (i + 1 < argc && strcmp(argv[i], "--height") == 0)           { options.nHeight = atoi(argv[++i]); }
+        else if (i + 1 < argc && strcmp(argv[i], "--write-golden") == 0)     { options.writeGoldenPath = argv[++i]; }
+        else if (i + 1 < argc && strcmp(argv[i], "--golden") == 0)           { options.goldenPath = argv[++i]; }
+        else if (i + 1 < argc && strcmp(argv[i], "--write-perf") == 0)       { options.writePerfPath = argv[++i]; }
+        else if (i + 1 < argc && strcmp(argv[i], "--perf") == 0)             { options.perfPath = argv[++i]; }
+        else if (strcmp(argv[i], "--no-golden") == 0)                         { options.bGolden = false; }
+        else if (strcmp(argv[i], "--no-perf") == 0)                           { options.bPerf = false; }
+        else if (i + 1 < argc && strcmp(argv[i], "--tolerance") == 0)        { options.fTolerance = (float)atof(argv[++i]); }
+        else
+        {
+            return false;
+        }
+    }
+    return options.nWidth > 0 && options.nHeight > 0;
+}
+
+// Values the geometry is known to give, including the odd ones the renderer relies on
+static void checkGeometry()
+{
+    const float fDepth = 60.0f;
+    Plane floorPlane(Vector3D(0, 0, 0), Vector3D(0, 0, 1));
+
+    // A line parallel to a plane gives point 0,0,0 and parameter 0, which no caller takes for a hit
+    std::pair<Vector3D, float> parallel = floorPlane.getLineIntersection(Line(Vector3D(1, 2, 3), Vector3D(1, 1, 0)));
+    check(parallel.second == 0.0f && parallel.first == Vector3D(0, 0, 0), "parallel line meets plane at 0,0,0 with t 0");
+
+    std::pair<Vector3D, float> below = floorPlane.getLineIntersection(Line(Vector3D(1, 2, 2), Vector3D(0, 0, -1)));
+    check(below.second == 2.0f && below.first == Vector3D(1, 2, 0), "line meets plane in front");
+
+    // Planes are infinite both ways, the parameter is negative behind the origin
+    std::pair<Vector3D, float> behind = floorPlane.getLineIntersection(Line(Vector3D(1, 2, 2), Vector3D(0, 0, 1)));
+    check(behind.second == -2.0f, "plane behind the origin gives negative t");
+
+    // Directions are normalized, so t is the distance along the line
+    Line diagonal(Vector3D(0, 0, 0), Vector3D(3, 4, 0));
+    check(diagonal.getDirection() == Vector3D(0.6f, 0.8f, 0.0f), "line direction is normalized");
+    check(fabsf(diagonal.getPoint(5.0f)[0] - 3.0f) < 1e-6f && fabsf(diagonal.getPoint(5.0f)[1] - 4.0f) < 1e-6f, "point at t 5");
+
+    // getParameter divides a dot product by itself: 1 for any point off the origin, 0 for the origin
+    //     and for points at a right angle to the line
+    check(diagonal.getParameter(Vector3D(3, 4, 0)) == 1.0f, "getParameter of a point ahead is 1");
+    check(diagonal.getParameter(Vector3D(-6, -8, 0)) == 1.0f, "getParameter of a point behind is 1");
+    check(diagonal.getParameter(Vector3D(0, 0, 0)) == 0.0f, "getParameter of the origin is 0");
+    check(diagonal.getParameter(Vector3D(-4, 3, 0)) == 0.0f, "getParameter at a right angle is 0");
+
+    // Cube distances are square roots of the ray parameter
+    Cube cube(Vector3D(10, 0, 2.5f), '#', COLOR_GREEN, 0.0f);
+    std::pair<float, Glyph> hit = cube.getIntersection(Line(Vector3D(0, 0, 2.5f), Vector3D(1, 0, 0)), fDepth);
+    check(hit.first == sqrtf(7.5f) && hit.second == cube.getCharByDistance(fDepth, 7.5f), "cube hit on its near face");
+
+    std::pair<float, Glyph> inside = cube.getIntersection(Line(Vector3D(10, 0, 2.5f), Vector3D(1, 0, 0)), fDepth);
+    check(inside.first == sqrtf(2.5f), "ray from inside a cube hits its far face");
+
+    std::pair<float, Glyph> miss = cube.getIntersection(Line(Vector3D(0, 0, 2.5f), Vector3D(-1, 0, 0)), fDepth);
+    check(miss.first == sqrtf((float)INT_MAX) && miss.second == ' ', "cube miss gives sqrt(INT_MAX) and a space");
+
+    // Faces are closed: a ray along an edge hits
+    std::pair<float, Glyph> edge = cube.getIntersection(Line(Vector3D(0, 2.5f, 2.5f), Vector3D(1, 0, 0)), fDepth);
+    check(edge.first == sqrtf(7.5f), "ray along a cube edge hits");
+
+    Box box(Vector3D(7.5f, -2.5f, 0.0f), Vector3D(12.5f, 2.5f, 5.0f), '#', COLOR_GREEN);
+    Line slanted(Vector3D(0.5f, -1.0f, 3.0f), Vector3D(1.0f, 0.1f, -0.05f));
+    check(box.getIntersection(slanted, fDepth) == cube.getIntersection(slanted, fDepth), "box of a cube's size hits like the cube");
+
+    // The first tier includes its limit, the others don't
+    const ShadeTiers& tiers = Floor::SHADE_TIERS;
+    check(tiers.shade(tiers.fLimits[0]) == tiers.wChars[0], "first shade tier includes its limit");
+    check(tiers.shade(nextafterf(tiers.fLimits[0], 100.0f)) == tiers.wChars[1], "second shade tier starts past the first limit");
+    check(tiers.shade(tiers.fLimits[1]) == tiers.wChars[2], "second shade tier excludes its limit");
+    check(tiers.shade(tiers.fLimits[3]) == tiers.wFar, "last limit is far");
+
+    ShadeTiers cubeTiers = Cube::getShadeTiers(fDepth);
+    for (int i = 0; i < 4; i++)
+    {
+        check(cube.getCharByDistance(fDepth, cubeTiers.fLimits[i]) == cubeTiers.shade(cubeTiers.fLimits[i]), "cube shades by its tiers");
+    }
+
+    // Packets give what getIntersection gives, ray by ray
+    RayPacket packet;
+    packet.reset(Vector3D(0, 0, 2.0f));
+    for (int i = 0; i < 13; i++)
+    {
+        packet.add(Line(Vector3D(0, 0, 2.0f), Vector3D(1.0f, 0.05f * (i - 6), 0.02f * (i % 5 - 2))));
+    }
+    std::pair<float, Glyph> intersections[N_MAX_PACKET_RAYS];
+    cube.intersectPacket(packet, fDepth, intersections);
+    bool same = true;
+    for (int i = 0; i < packet.nCount; i++)
+    {
+        same = same && intersections[i] == cube.getIntersection(packet.lines[i], fDepth);
+    }
+    check(same, "cube packet matches single rays");
+}
+
+static bool isNear(float value, float expected)
+{
+    return fabsf(value - expected) < 1e-4f;
+}
+
+static CollisionMove makeMove(float x, float y, float dx, float dy)
+{
+    CollisionMove mover = { { x, y }, { dx, dy }, 1.0f, false };
+    return mover;
+}
+
+// 8 x 8 squares: border walls and a pillar at square (4, 4), which spans [17.5, 22.5] on both axes
+static void checkCollision()
+{
+    std::vector<unsigned char> cells(8 * 8, '.');
+    for (int i = 0; i < 8; i++)
+    {
+        cells[i] = cells[7 * 8 + i] = cells[i * 8] = cells[i * 8 + 7] = '#';
+    }
+    cells[4 * 8 + 4] = '#';
+    CollisionMap map(8, 8, cells.data());
+    const float fContact = 2.5f + 1.0f + F_COLLISION_SKIN;     // Center of a mover stopped by the west wall
+
+    CollisionMove straight = makeMove(10.0f, 10.0f, -20.0f, 0.0f);
+    map.move(straight);
+    check(straight.bHit && isNear(straight.fPos[0], fContact) && straight.fPos[1] == 10.0f, "mover stops at the wall it runs into");
+
+    CollisionMove slanted = makeMove(10.0f, 10.0f, -10.0f, 3.0f);
+    map.move(slanted);
+    check(isNear(slanted.fPos[0], fContact) && isNear(slanted.fPos[1], 13.0f), "mover slides along the wall, keeping its movement along it");
+
+    CollisionMove corner = makeMove(10.0f, 10.0f, -20.0f, -20.0f);
+    map.move(corner);
+    check(isNear(corner.fPos[0], fContact) && isNear(corner.fPos[1], fContact), "mover pushed into a corner stops in it");
+
+    CollisionMove fast = makeMove(12.0f, 20.0f, 30.0f, 0.0f);
+    map.move(fast);
+    check(isNear(fast.fPos[0], 17.5f - 1.0f - F_COLLISION_SKIN), "move longer than a square doesn't pass through the pillar");
+
+    CollisionMove rounded = makeMove(14.0f, 14.0f, 10.0f, 10.0f);
+    map.move(rounded);
+    float fCornerContact = 17.5f - (1.0f + F_COLLISION_SKIN) / sqrtf(2.0f);
+    check(isNear(rounded.fPos[0], fCornerContact) && isNear(rounded.fPos[1], fCornerContact), "mover stops at the pillar's corner, the radius away");
+
+    CollisionMove buried = makeMove(3.0f, 10.0f, 0.0f, 0.0f);
+    map.move(buried);
+    check(buried.bHit && !map.overlaps(buried.fPos, 1.0f), "mover that starts in a wall is pushed out of it");
+
+    // Random walks never end in a wall, and give the same moves on the pool as on one thread
+    std::vector<CollisionMove> movers;
+    unsigned int seed = 777u;
+    for (int i = 0; i < 500; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        float x = 3.6f + 28.8f * (seed >> 8) / 16777216.0f;
+        seed = seed * 1664525u + 1013904223u;
+        float y = 3.6f + 28.8f * (seed >> 8) / 16777216.0f;
+        movers.push_back(makeMove(x, y, 0.0f, 0.0f));
+    }
+    std::vector<CollisionMove> pooled = movers;
+    ThreadPool pool(4);
+    bool inside = false;
+    bool same = true;
+    for (int tick = 0; tick < 100; tick++)
+    {
+        for (int i = 0; i < (int)movers.size(); i++)
+        {
+            float angle = 0.37f * tick + i;
+            movers[i].fDelta[0] = pooled[i].fDelta[0] = 3.0f * cosf(angle);
+            movers[i].fDelta[1] = pooled[i].fDelta[1] = 3.0f * sinf(angle);
+        }
+        map.moveAll(movers.data(), (int)movers.size(), nullptr);
+        map.moveAll(pooled.data(), (int)pooled.size(), &pool);
+        for (int i = 0; i < (int)movers.size(); i++)
+        {
+            inside = inside || map.overlaps(movers[i].fPos, movers[i].fRadius);
+            same = same && movers[i].fPos[0] == pooled[i].fPos[0] && movers[i].fPos[1] == pooled[i].fPos[1];
+        }
+    }
+    check(!inside, "random walks never end in a wall");
+    check(same, "moves on the pool match moves on one thread");
+}
+
+// Pillars on a size x size map, or only its border walls
+static std::wstring buildPillarMap(int size, bool pillars = true)
+{
+    std::wstring map(size * size, '.');
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            bool border = x == 0 || y == 0 || x == size - 1 || y == size - 1;
+            if (border || (pillars && x % 5 == 2 && y % 5 == 2))
+            {
+                map[y * size + x] = '#';
+            }
+        }
+    }
+    return map;
+}
+
+// A 16 x 16 map split by a wall at x = 8 with a gap at y = 12, and a pillar at 12, 4 right of it
+static void checkPvs()
+{
+    std::wstring cells = buildPillarMap(16, false);
+    for (int y = 1; y < 15; y++)
+    {
+        cells[y * 16 + 8] = y == 12 ? '.' : '#';
+    }
+    cells[4 * 16 + 12] = '#';
+    MapFile map;
+    map.setCells(16, 16, cells);
+    std::vector<WallRect> boxes = mergeWallSquares(map);
+    int pillar = -1;
+    int split = -1;
+    int east = -1;
+    for (int i = 0; i < (int)boxes.size(); i++)
+    {
+        pillar = boxes[i].nX == 12 && boxes[i].nY == 4 ? i : pillar;
+        split = boxes[i].nX == 8 && boxes[i].nY == 1 ? i : split;
+        east = boxes[i].nX == 15 && boxes[i].nY == 1 ? i : east;
+    }
+
+    PvsTable pvs;
+    check(pvs.build(map, boxes) && pillar >= 0 && split >= 0 && east >= 0, "sets are built");
+    const unsigned long long* left = pvs.getSet(3, 3);
+    const unsigned long long* right = pvs.getSet(11, 3);
+    const unsigned long long* gap = pvs.getSet(8, 12);
+    check(left != nullptr && right != nullptr && gap != nullptr && pvs.getSet(8, 4) == nullptr && pvs.getSet(-1, 3) == nullptr,
+        "open squares have sets, walls and squares off the map don't");
+    check(PvsTable::contains(left, split) && !PvsTable::contains(left, pillar), "a wall behind the split is hidden");
+    check(PvsTable::contains(right, pillar) && PvsTable::contains(right, split) && PvsTable::contains(gap, pillar), "walls in view are in the set");
+    const unsigned long long* row = pvs.getSet(3, 12);
+    check(row != nullptr && PvsTable::contains(row, east) && !PvsTable::contains(left, east), "a wall seen through the gap is in the set");
+}
+
+// Scripted input on a 32 x 32 pillar map, saved and loaded back, is played back twice from the same start
+static void checkInput()
+{
+    std::vector<unsigned char> cells(32 * 32);
+    std::wstring pillars = buildPillarMap(32);
+    for (int i = 0; i < 32 * 32; i++)
+    {
+        cells[i] = (unsigned char)pillars[i];
+    }
+    CollisionMap map(32, 32, cells.data());
+
+    // Held actions change every 1 to 32 ticks, never to quit
+    InputRecording recording;
+    std::vector<InputMask> script;
+    unsigned int seed = 4242u;
+    InputMask held = 0;
+    while (script.size() < 1200)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        held = (seed >> 8) & ((1u << ACTION_QUIT) - 1);
+        for (int i = 0, count = 1 + (seed >> 27); i < count; i++)
+        {
+            recording.add((long long)script.size(), held);
+            script.push_back(held);
+        }
+    }
+
+    const char* path = "verify-input.tmp";
+    InputRecording loaded;
+    bool saved = recording.save(path) && loaded.load(path);
+    remove(path);
+    bool sameEvents = loaded.getEvents().size() == recording.getEvents().size();
+    for (size_t i = 0; sameEvents && i < loaded.getEvents().size(); i++)
+    {
+        sameEvents = loaded.getEvents()[i].nTick == recording.getEvents()[i].nTick && loaded.getEvents()[i].held == recording.getEvents()[i].held;
+    }
+    check(saved && sameEvents && loaded.getTickCount() == (long long)script.size() && loaded.getTickSeconds() == recording.getTickSeconds(),
+        "a recording loads as it was saved");
+    check(recording.getEvents().size() < script.size() / 4, "a recording only holds the ticks its input changes in");
+
+    InputRecording broken;
+    check(!broken.load("verify-missing-input.tmp") && broken.getTickCount() == 0, "a missing recording doesn't load");
+
+    // Fast enough to run into the pillars
+    Player players[2] = { Player(Vector3D(15, 15, 2), 30.0f), Player(Vector3D(15, 15, 2), 30.0f) };
+    bool sameInput = true;
+    bool inside = false;
+    for (int run = 0; run < 2; run++)
+    {
+        InputPlayback playback(loaded);
+        for (long long tick = 0; tick < loaded.getTickCount(); tick++)
+        {
+            InputMask input = playback.poll(tick);
+            sameInput = sameInput && input == script[(size_t)tick];
+            applyPlayerInput(players[run], input, loaded.getTickSeconds(), map, 1.0f);
+            Vector3D pos = players[run].getCenterPos();
+            float center[2] = { pos[0], pos[1] };
+            inside = inside || map.overlaps(center, 1.0f);
+        }
+        sameInput = sameInput && playback.isFinished(loaded.getTickCount()) && playback.poll(loaded.getTickCount()) == 1u << ACTION_QUIT;
+    }
+    check(sameInput, "playback gives the recorded input every tick, then quits");
+    check(!inside, "played back input never walks the player into a wall");
+    check(players[0].getCenterPos() == players[1].getCenterPos() && players[0].getAngle() == players[1].getAngle(),
+        "playing a recording twice moves the player the same way");
+}
+
+// Building a world again, or from a new map, replaces what was built before. A binary map whose header
+//     claims more walls than squares doesn't load
+static void checkRebuild()
+{
+    World world;
+    world.setUpMap();
+    world.buildWorldFromMap();
+    size_t objectCount = world.getObjects().size();
+    Sprite sprite = {};
+    world.addSprite(sprite);
+    world.buildWorldFromMap();
+    check(world.getObjects().size() == objectCount && world.getSprites().empty(), "a second build replaces the first");
+
+    const char* path = "verify-map.tmp";
+    MapFile map;
+    map.setCells(32, 32, buildPillarMap(32));
+    bool saved = map.saveBinary(path);
+    bool loaded = world.loadMap(path);
+    check(saved && loaded && world.getObjects().empty() && world.getGrid().getWidth() == 0, "loading a map empties the world");
+    world.buildWorldFromMap();
+    check(world.getWallBoxCount() > 0 && (int)world.getObjects().size() == world.getWallBoxCount() + 2 &&
+        world.getGrid().getWidth() == 32 && !world.getCollisionMap().isWall(1, 1), "the world is built from the loaded map");
+
+    FILE* file = fopen(path, "r+b");
+    MapFileHeader header;
+    bool patched = file != nullptr && fread(&header, sizeof(header), 1, file) == 1;
+    if (patched)
+    {
+        header.nWallCount = 32 * 32 + 1;
+        patched = fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    }
+    if (file != nullptr)
+    {
+        fclose(file);
+    }
+    MapFile broken;
+    check(patched && !broken.load(path), "a map with more walls than squares doesn't load");
+    remove(path);
+}
+
+// A sprite shows in front of a wall and not behind it, and the nearer of two overlapping sprites wins.
+//     The camera stands in a walled 16 x 16 map and looks at the east wall
+static void checkSprites()
+{
+    World world;
+    world.setMap(16, 16, buildPillarMap(16, false));
+    world.buildWorldFromMap();
+    Renderer renderer;
+    Framebuffer frame(120, 40);
+    Player player(Vector3D(37.5f, 37.5f, 2.0f), 2.0f);
+
+    renderer.render(player, world, frame);
+    int center = 20 * 120 + 60;
+    float wallDistance = frame.depths[center];
+    check(fabsf(wallDistance - 35.0f) < 1e-3f, "wall pass writes the distance of the center cell");
+
+    Sprite front = { { 37.5f + wallDistance * 0.5f, 37.5f, 2.0f }, 1.0f, 1.0f, 'F', COLOR_RED };
+    Sprite farther = { { 37.5f + wallDistance * 0.75f, 37.5f, 2.0f }, 4.0f, 4.0f, 'N', COLOR_RED };
+    Sprite behind = { { 37.5f + wallDistance + 3.0f, 37.5f, 2.0f }, 2.0f, 2.0f, 'B', COLOR_RED };
+    world.addSprite(behind);
+    world.addSprite(farther);
+    world.addSprite(front);
+    renderer.render(player, world, frame);
+    check(frame.chars[center] == 'F' && fabsf(frame.depths[center] - wallDistance * 0.5f) < 1e-3f, "nearest sprite covers the center cell");
+    check(frame.chars[center + 2] == 'N', "farther sprite fills the cells the nearer one leaves");
+    check(std::find(frame.chars.begin(), frame.chars.end(), (Glyph)'B') == frame.chars.end(), "sprite behind a wall is hidden");
+    check(renderer.getSpritesDrawn() == 3, "sprites in view survive culling");
+
+    // Turned away, all of them are culled
+    player.setAngle(3.14159f);
+    renderer.render(player, world, frame);
+    check(renderer.getSpritesDrawn() == 0, "sprites behind the camera are culled");
+}
+
+static void buildWorld(int index, World& world)
+{
+    if (index == 1)
+    {
+        world.setMergeWalls(false);
+    }
+    if (index == 2)
+    {
+        world.setWallObjectLimit(0);
+    }
+
+    if (index == 3)
+    {
+        world.setMap(32, 32, buildPillarMap(32));
+    }
+    else
+    {
+        world.setUpMap();
+    }
+    world.setBuildPvs(true);
+    world.buildWorldFromMap();
+
+    if (index == 3)
+    {
+        std::vector<GameObject*> cubes;
+        unsigned int seed = 777u;
+        for (int i = 0; i < 60; i++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            float x = 10.0f + 140.0f * (seed >> 8) / 16777216.0f;
+            seed = seed * 1664525u + 1013904223u;
+            float y = 10.0f + 140.0f * (seed >> 8) / 16777216.0f;
+            cubes.push_back(new Cube(Vector3D(x, y, 1.0f + (i % 4)), '#', COLOR_GREEN, 0.0f));
+        }
+        world.addObjects(cubes);
+
+        // Sprites are drawn against each path's depths, so they have to come out the same too
+        for (int i = 0; i < 80; i++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            float x = 10.0f + 140.0f * (seed >> 8) / 16777216.0f;
+            seed = seed * 1664525u + 1013904223u;
+            float y = 10.0f + 140.0f * (seed >> 8) / 16777216.0f;
+            Sprite sprite = { { x, y, 1.5f }, 1.5f, 3.0f, (Glyph)('a' + i % 26), COLOR_RED };
+            world.addSprite(sprite);
+        }
+    }
+}
+
+static const char* const WORLD_NAMES[] = { "default map", "unmerged walls", "walls in grid", "pillars, cubes and sprites" };
+const int N_WORLDS = 4;
+
+// Nearest hit by testing every object, what RayCaster has to find
+static RayQueryHit castLinear(const World& world, const RayQuery& query)
+{
+    RayQueryHit hit = { nullptr, -1, query.fMaxDistance, false };
+    Line ray(Vector3D(query.fOrigin[0], query.fOrigin[1], query.fOrigin[2]), Vector3D(query.fDirection[0], query.fDirection[1], query.fDirection[2]));
+    float depth = sqrtf(query.fMaxDistance);
+    float nearest = depth;
+    const std::vector<GameObject*>& objects = world.getObjects();
+    for (int i = 0; i < (int)objects.size(); i++)
+    {
+        std::pair<float, Glyph> intersection = objects[i]->getIntersection(ray, depth);
+        if (intersection.first > 0 && intersection.first < nearest)
+        {
+            nearest = intersection.first;
+            hit = { objects[i], i, intersection.first * intersection.first, true };
+        }
+    }
+
+    std::pair<float, Glyph> intersection;
+    GameObject* wall;
+    if (!world.hasWallObjects() && world.getGrid().findFirstHit(ray, depth, intersection, wall) && intersection.first <= nearest)
+    {
+        hit = { wall, -1, intersection.first * intersection.first, true };
+    }
+    return hit;
+}
+
+// Coincident faces tie, then any of the objects they belong to is a right answer
+static bool isSameHit(const World& world, const RayQuery& query, const RayQueryHit& hit, const RayQueryHit& expected)
+{
+    if (hit.bHit != expected.bHit || hit.fDistance != expected.fDistance)
+    {
+        return false;
+    }
+    if (hit.object == expected.object)
+    {
+        return hit.nObject == expected.nObject;
+    }
+    if (hit.nObject < 0 || hit.object != world.getObjects()[hit.nObject])
+    {
+        return false;
+    }
+    Line ray(Vector3D(query.fOrigin[0], query.fOrigin[1], query.fOrigin[2]), Vector3D(query.fDirection[0], query.fDirection[1], query.fDirection[2]));
+    float distance = hit.object->getIntersection(ray, sqrtf(query.fMaxDistance)).first;
+    return distance * distance == hit.fDistance;
+}
+
+// Random rays in every world, cast in batches on one thread and on the pool, with every box kernel
+static void checkQueries()
+{
+    ThreadPool pool(4);
+    const BoxKernelType kernels[] = { BOX_KERNEL_NONE, BOX_KERNEL_SCALAR, BOX_KERNEL_SSE, BOX_KERNEL_AVX2 };
+    bool same = true;
+    int hits = 0;
+    for (int w = 0; w < N_WORLDS; w++)
+    {
+        World world;
+        buildWorld(w, world);
+        float spanX = world.getMapWidth() * (float)N_MAP_WORLD_RATIO;
+        float spanY = world.getMapHeight() * (float)N_MAP_WORLD_RATIO;
+
+        std::vector<RayQuery> queries(2000);
+        unsigned int seed = 4242u + w;
+        auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) / 16777216.0f; };
+        for (RayQuery& query: queries)
+        {
+            query.fOrigin[0] = spanX * random() - 2.5f;
+            query.fOrigin[1] = spanY * random() - 2.5f;
+            query.fOrigin[2] = 0.5f + 4.0f * random();
+            query.fDirection[0] = random() - 0.5f;
+            query.fDirection[1] = random() - 0.5f;
+            query.fDirection[2] = 0.3f * (random() - 0.5f);
+            query.fMaxDistance = 10.0f + 290.0f * random();
+        }
+
+        std::vector<RayQueryHit> expected(queries.size());
+        for (int i = 0; i < (int)queries.size(); i++)
+        {
+            expected[i] = castLinear(world, queries[i]);
+            hits += expected[i].bHit;
+        }
+
+        for (BoxKernelType kernel: kernels)
+        {
+            for (int threaded = 0; threaded < 2; threaded++)
+            {
+                RayCaster caster;
+                caster.setBoxKernel(kernel);
+                caster.setThreadPool(threaded ? &pool : nullptr);
+                std::vector<RayQueryHit> results(queries.size());
+                caster.castAll(world, queries.data(), (int)queries.size(), results.data());
+                for (int i = 0; i < (int)queries.size(); i++)
+                {
+                    same = same && isSameHit(world, queries[i], results[i], expected[i]);
+                }
+            }
+        }
+    }
+    check(same, "batched ray queries find what testing every object finds");
+    check(hits > 1000, "most random rays hit something");
+
+    // Line of sight along the row of the default map's two wall squares, centered at x = 45 and 50
+    World world;
+    world.setUpMap();
+    world.buildWorldFromMap();
+    RayCaster caster;
+    SightQuery sights[3] = {
+        { { 20.0f, 35.0f, 2.0f }, { 35.0f, 35.0f, 2.0f } },
+        { { 20.0f, 35.0f, 2.0f }, { 60.0f, 35.0f, 2.0f } },
+        { { 37.5f, 35.0f, 2.0f }, { 42.5f, 35.0f, 2.0f } }
+    };
+    bool visible[3];
+    caster.checkAll(world, sights, 3, visible);
+    RayQuery shot = { { 37.5f, 35.0f, 2.0f }, { 1.0f, 0.0f, 0.0f }, 100.0f };
+    RayQueryHit shotHit = caster.cast(world, shot);
+    check(visible[0] && !visible[1], "line of sight is blocked by walls only");
+    check(visible[2] && shotHit.bHit && fabsf(shotHit.fDistance - 5.0f) < 1e-3f, "a point on the wall is visible, a shot at it hits it");
+}
+
+// A loop through the map, off the square boundaries, and views straight along the axes
+static std::vector<Player> buildPoses()
+{
+    std::vector<Player> poses;
+    const int nLoopPoses = 24;
+    for (int i = 0; i < nLoopPoses; i++)
+    {
+        float pathAngle = 2.0f * 3.14159f * i / nLoopPoses;
+        Player player(Vector3D(38.0f + 20.0f * cosf(pathAngle), 38.0f + 20.0f * sinf(pathAngle), 2.0f), 2.0f);
+        player.setAngle(pathAngle + 3.14159f / 2.0f + 0.75f * sinf(4.0f * pathAngle));
+        poses.push_back(player);
+    }
+    for (int i = 0; i < 8; i++)
+    {
+        // Squares span [5 * x - 2.5, 5 * x + 2.5], so 37.5 is on a boundary
+        Player player(Vector3D(i < 4 ? 37.5f : 40.0f, i < 4 ? 37.5f : 40.0f, 2.5f), 2.0f);
+        player.setAngle(i * 3.14159265f / 2.0f);
+        poses.push_back(player);
+    }
+    return poses;
+}
+
+// Frames and timings differ with the compiler, its target and the C library's math functions
+static std::string getBuildKey()
+{
+#if defined(__clang__)
+    std::string key = "clang" + std::to_string(__clang_major__);
+#elif defined(__GNUC__)
+    std::string key = "gcc" + std::to_string(__GNUC__);
+#elif defined(_MSC_VER)
+    std::string key = "msvc" + std::to_string(_MSC_VER);
+#else
+    std::string key = "cc";
+#endif
+#if defined(__x86_64__) || defined(_M_X64)
+    key += "-x86_64";
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    key += "-arm64";
+#endif
+#if defined(__FMA__)
+    key += "-fma";
+#endif
+#if defined(__FAST_MATH__)
+    key += "-fastmath";
+#endif
+#if defined(__GLIBC__)
+    key += "-glibc" + std::to_string(__GLIBC__) + "." + std::to_string(__GLIBC_MINOR__);
+#endif
+    return key;
+}
+
+// Path of a file in bench/golden, found next to this source file
+static std::string getGoldenPath(const std::string& name)
+{
+    std::string path = __FILE__;
+    size_t slash = path.find_last_of("/\\");
+    return (slash == std::string::npos ? std::string() : path.substr(0, slash + 1)) + "golden/" + name;
+}
+
+// Text, one line per row of each frame: runs of equal cells as count*code point:color, code points in hex
+static bool writeGolden(const char* path, int width, int height, const std::vector<Framebuffer>& frames)
+{
+    FILE* file = fopen(path, "w");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    bool ok = fprintf(file, "FPSGOLD2 %d %d %d\n", width, height, (int)frames.size()) > 0;
+    for (const Framebuffer& frame: frames)
+    {
+        for (int y = 0; y < height; y++)
+        {
+            const int row = y * width;
+            for (int x = 0; x < width;)
+            {
+                int count = 1;
+                while (x + count < width && frame.chars[row + x + count] == frame.chars[row + x] &&
+                    frame.colors[row + x + count] == frame.colors[row + x])
+                {
+                    count++;
+                }
+                ok = ok && fprintf(file, x == 0 ? "%d*%x:%d" : " %d*%x:%d", count, (unsigned int)frame.chars[row + x],
+                    (int)frame.colors[row + x]) > 0;
+                x += count;
+            }
+            ok = ok && fputc('\n', file) != EOF;
+        }
+    }
+    return fclose(file) == 0 && ok;
+}
+
+// Returns the number of cells that differ, or -1 if the file can't be read or was written for other frames
+static long long compareGolden(const char* path, int width, int height, const std::vector<Framebuffer>& frames)
+{
+    FILE* file = fopen(path, "r");
+    if (file == nullptr)
+    {
+        return -1;
+    }
+
+    int header[3];
+    bool ok = fscanf(file, "FPSGOLD2 %d %d %d", &header[0], &header[1], &header[2]) == 3 &&
+        header[0] == width && header[1] == height && header[2] == (int)frames.size();
+
+    long long mismatches = 0;
+    for (int i = 0; ok && i < (int)frames.size(); i++)
+    {
+        // Runs don't cross rows, so the cells of a frame are its runs one after another
+        for (int cell = 0; ok && cell < width * height;)
+        {
+            int count, color;
+            unsigned int code;
+            ok = fscanf(file, "%d*%x:%d", &count, &code, &color) == 3 && count > 0 && cell % width + count <= width;
+            for (int end = cell + count; ok && cell < end; cell++)
+            {
+                mismatches += (unsigned int)frames[i].chars[cell] != code || frames[i].colors[cell] != color;
+            }
+        }
+    }
+    fclose(file);
+    return ok ? mismatches : -1;
+}
+
+static bool writePerf(const char* path, const std::vector<PathResult>& results)
+{
+    FILE* file = fopen(path, "w");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    for (const PathResult& result: results)
+    {
+        fprintf(file, "%s %.4f\n", result.name.c_str(), result.fRelativeTime);
+    }
+    return fclose(file) == 0;
+}
+
+// Fails every path that is slower relative to the reference path than in the perf file by more than
+//     tolerance percent. Returns false without checking if the file can't be read
+static bool checkPerf(const char* path, float tolerance, const std::vector<PathResult>& results, bool& ok)
+{
+    FILE* file = fopen(path, "r");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    ok = true;
+    char name[128];
+    double baseline;
+    while (fscanf(file, "%127s %lf", name, &baseline) == 2)
+    {
+        for (const PathResult& result: results)
+        {
+            if (result.name == name && result.fRelativeTime > baseline * (1.0 + tolerance / 100.0))
+            {
+                printf("SLOWER      %s %.4f of reference, %.4f in %s\n", name, result.fRelativeTime, baseline, path);
+                ok = false;
+            }
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    VerifyOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printf("Usage: verify [--width W] [--height H] [--write-golden FILE] [--golden FILE] [--no-golden] [--write-perf FILE] [--perf FILE] "
+            "[--no-perf] [--tolerance PERCENT]\n");
+        return 1;
+    }
+
+    checkGeometry();
+    checkCollision();
+    checkSprites();
+    checkQueries();
+    checkPvs();
+    checkInput();
+    checkRebuild();
+    printf("geometry    %d checks, %d failed\n", nChecks, nFailedChecks);
+    int result = nFailedChecks > 0 ? 1 : 0;
+
+    const RenderPath paths[] = {
+        { "linear", RENDER_LINEAR, BOX_KERNEL_NONE, false, false, false },
+        { "linear-packets", RENDER_LINEAR, BOX_KERNEL_NONE, true, false, false },
+        { "linear-mt", RENDER_LINEAR, BOX_KERNEL_NONE, false, true, false },
+        { "linear-packets-mt", RENDER_LINEAR, BOX_KERNEL_NONE, true, true, false },
+        { "linear-pvs", RENDER_LINEAR, BOX_KERNEL_NONE, false, false, true },
+        { "linear-packets-pvs", RENDER_LINEAR, BOX_KERNEL_NONE, true, false, true },
+        { "linear-pvs-mt", RENDER_LINEAR, BOX_KERNEL_NONE, false, true, true },
+        { "grid", RENDER_GRID, BOX_KERNEL_NONE, false, false, false },
+        { "grid-mt", RENDER_GRID, BOX_KERNEL_NONE, false, true, false },
+        { "bvh", RENDER_BVH, BOX_KERNEL_NONE, false, false, false },
+        { "bvh-mt", RENDER_BVH, BOX_KERNEL_NONE, false, true, false },
+        { "bvh-scalar", RENDER_BVH, BOX_KERNEL_SCALAR, false, false, false },
+        { "bvh-sse", RENDER_BVH, BOX_KERNEL_SSE, false, false, false },
+        { "bvh-avx2", RENDER_BVH, BOX_KERNEL_AVX2, false, false, false },
+        { "bvh-avx2-mt", RENDER_BVH, BOX_KERNEL_AVX2, false, true, false },
+        { "bvh-packets", RENDER_BVH, BOX_KERNEL_NONE, true, false, false },
+        { "bvh-packets-mt", RENDER_BVH, BOX_KERNEL_NONE, true, true, false },
+        { "scene-scalar", RENDER_SCENE, BOX_KERNEL_SCALAR, false, false, false },
+        { "scene-sse", RENDER_SCENE, BOX_KERNEL_SSE, false, false, false },
+        { "scene-avx2", RENDER_SCENE, BOX_KERNEL_AVX2, false, false, false },
+        { "scene-scalar-mt", RENDER_SCENE, BOX_KERNEL_SCALAR, false, true, false },
+        { "column", RENDER_COLUMN, BOX_KERNEL_NONE, false, false, false },
+        { "column-mt", RENDER_COLUMN, BOX_KERNEL_NONE, false, true, false }
+    };
+
+    std::vector<Player> poses = buildPoses();
+    const int nTimedRuns = options.bPerf || options.writePerfPath != nullptr ? 3 : 1;
+    ThreadPool pool(4);
+    std::vector<Framebuffer> referenceFrames;
+    std::vector<PathResult> results;
+    long long cellCount = 0;
+
+    for (int w = 0; w < N_WORLDS; w++)
+    {
+        World world;
+        buildWorld(w, world);
+
+        int firstFrame = (int)referenceFrames.size();
+        for (const RenderPath& path: paths)
+        {
+            if (!isBoxKernelSupported(path.boxKernel))
+            {
+                continue;
+            }
+
+            Renderer renderer;
+            renderer.setMode(path.mode);
+            renderer.setBoxKernel(path.boxKernel);
+            renderer.setPacketTracing(path.bPackets);
+            renderer.setVisibilityCulling(path.bVisibilityCulling);
+            renderer.setThreadPool(path.bThreads ? &pool : nullptr);
+
+            Framebuffer frame(options.nWidth, options.nHeight);
+            long long mismatches = 0;
+            double time = 0.0;
+            for (int i = 0; i < (int)poses.size(); i++)
+            {
+                // The fastest of a few renders, other processes only ever make one slower
+                double poseTime = 0.0;
+                for (int run = 0; run < nTimedRuns; run++)
+                {
+                    auto time1 = std::chrono::steady_clock::now();
+                    renderer.render(poses[i], world, frame);
+                    auto time2 = std::chrono::steady_clock::now();
+                    double runTime = std::chrono::duration<double>(time2 - time1).count();
+                    poseTime = run == 0 ? runTime : std::min(poseTime, runTime);
+                }
+                time += poseTime;
+
+                // The first path is the reference
+                if (&path == &paths[0])
+                {
+                    referenceFrames.push_back(frame);
+                    continue;
+                }
+                const Framebuffer& reference = referenceFrames[firstFrame + i];
+                for (int cell = 0; cell < frame.size(); cell++)
+                {
+                    mismatches += frame.chars[cell] != reference.chars[cell] || frame.colors[cell] != reference.colors[cell];
+                }
+            }
+
+            // Paths are timed over all worlds
+            std::vector<PathResult>::iterator pathResult = results.begin();
+            while (pathResult != results.end() && pathResult->name != path.name)
+            {
+                ++pathResult;
+            }
+            if (pathResult == results.end())
+            {
+                results.push_back({ path.name, 0.0, 0.0, 0 });
+                pathResult = results.end() - 1;
+            }
+            pathResult->fNsPerRay += time * 1e9;
+            pathResult->nMismatches += mismatches;
+            if (mismatches > 0)
+            {
+                printf("MISMATCH    %s: %lld cells differ in %s\n", path.name, mismatches, WORLD_NAMES[w]);
+            }
+        }
+        cellCount += (long long)poses.size() * options.nWidth * options.nHeight;
+    }
+
+    printf("frames      %d worlds x %d poses (%dx%d)\n", N_WORLDS, (int)poses.size(), options.nWidth, options.nHeight);
+    printf("\n%-18s %9s %9s %12s\n", "path", "ns/ray", "relative", "mismatches");
+    for (PathResult& pathResult: results)
+    {
+        pathResult.fNsPerRay /= cellCount;
+        pathResult.fRelativeTime = pathResult.fNsPerRay / results[0].fNsPerRay;
+        printf("%-18s %9.2f %9.4f %12lld\n", pathResult.name.c_str(), pathResult.fNsPerRay, pathResult.fRelativeTime,
+            pathResult.nMismatches);
+        if (pathResult.nMismatches > 0)
+        {
+            result = 1;
+        }
+    }
+    printf("\n");
+
+    // The files checked in for this build are used unless others are given; a build without them only says so
+    std::string buildKey = getBuildKey();
+#if defined(__OPTIMIZE__)
+    std::string perfKey = buildKey + "-O";
+#else
+    std::string perfKey = buildKey + "-O0";
+#endif
+    std::string goldenPath = options.goldenPath != nullptr ? options.goldenPath : getGoldenPath("frames-" + buildKey + ".txt");
+    std::string perfPath = options.perfPath != nullptr ? options.perfPath : getGoldenPath("perf-" + perfKey + ".txt");
+
+    if (options.writeGoldenPath != nullptr)
+    {
+        bool written = writeGolden(options.writeGoldenPath, options.nWidth, options.nHeight, referenceFrames);
+        printf("golden      %s %s\n", written ? "written to" : "can't write", options.writeGoldenPath);
+        result = written ? result : 1;
+    }
+    else if (options.bGolden)
+    {
+        long long mismatches = compareGolden(goldenPath.c_str(), options.nWidth, options.nHeight, referenceFrames);
+        if (mismatches >= 0)
+        {
+            printf("golden      %lld cells differ from %s\n", mismatches, goldenPath.c_str());
+            result = mismatches == 0 ? result : 1;
+        }
+        else if (options.goldenPath != nullptr)
+        {
+            printf("golden      can't read %s or it holds other frames\n", goldenPath.c_str());
+            result = 1;
+        }
+        else
+        {
+            printf("golden      none for build %s at %dx%d, skipped (%s)\n", buildKey.c_str(), options.nWidth, options.nHeight,
+                goldenPath.c_str());
+        }
+    }
+
+    if (options.writePerfPath != nullptr)
+    {
+        bool written = writePerf(options.writePerfPath, results);
+        printf("perf        %s %s\n", written ? "written to" : "can't write", options.writePerfPath);
+        result = written ? result : 1;
+    }
+    else if (options.bPerf)
+    {
+        bool ok;
+        if (checkPerf(perfPath.c_str(), options.fTolerance, results, ok))
+        {
+            printf("perf        %s than %s + %.0f%%\n", ok ? "no path slower" : "some paths slower", perfPath.c_str(), options.fTolerance);
+            result = ok ? result : 1;
+        }
+        else if (options.perfPath != nullptr)
+        {
+            printf("perf        can't read %s\n", perfPath.c_str());
+            result = 1;
+        }
+        else
+        {
+            printf("perf        none for build %s, skipped (%s)\n", perfKey.c_str(), perfPath.c_str());
+        }
+    }
+
+    printf("%s\n", result == 0 ? "OK" : "FAILED");
+    return result;
+}
@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include "boxkernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BOX_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+// Same threshold Plane::getLineIntersection uses to treat a line as parallel
+const double F_PARALLEL_EPSILON = 1e-6;
+
+
+// Lays the six arrays out one after another in memory
+static void assignArrays(BoxArray& boxes, float* memory, int count)
+{
+    const float fInf = std::numeric_limits<float>::infinity();
+    int padded = count + 8;
+    float** arrays[6] = { &boxes.minX, &boxes.minY, &boxes.minZ, &boxes.maxX, &boxes.maxY, &boxes.maxZ };
+
+    boxes.nCount = count;
+    for (int i = 0; i < 6; i++)
+    {
+        *arrays[i] = memory + i * padded;
+        std::fill(*arrays[i], *arrays[i] + padded, i < 3 ? fInf : -fInf);
+    }
+}
+
+void BoxArray::resize(int count)
+{
+    this->storage.resize(6 * (count + 8));
+    assignArrays(*this, this->storage.data(), count);
+}
+
+void BoxArray::resize(int count, Arena& arena)
+{
+    this->storage.clear();
+    assignArrays(*this, arena.allocateArray<float>(6 * (count + 8)), count);
+}
+
+void BoxArray::set(int index, Vector3D minCorner, Vector3D maxCorner)
+{
+    this->minX[index] = minCorner[0];
+    this->minY[index] = minCorner[1];
+    this->minZ[index] = minCorner[2];
+    this->maxX[index] = maxCorner[0];
+    this->maxY[index] = maxCorner[1];
+    this->maxZ[index] = maxCorner[2];
+}
+
+void BoxArray::clear(int index)
+{
+    const float fInf = std::numeric_limits<float>::infinity();
+    this->set(index, Vector3D(fInf, fInf, fInf), Vector3D(-fInf, -fInf, -fInf));
+}
+
+BoxRay::BoxRay(Line line)
+{
+    Vector3D origin = line.getOwnPoint();
+    Vector3D direction = line.getDirection();
+    for (int i = 0; i < 3; i++)
+    {
+        this->fOrigin[i] = origin[i];
+        this->fDirection[i] = direction[i];
+    }
+}
+
+
+bool intersectBox(const float boxMin[3], const float boxMax[3], const BoxRay& ray, float tLimit, float& tHit)
+{
+    const float* o = ray.fOrigin;
+    const float* d = ray.fDirection;
+    float best = tLimit;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (fabsf(d[axis]) < F_PARALLEL_EPSILON)
+        {
+            continue;
+        }
+
+        // Min face, then max face, in Cube's plane order
+        for (int side = 0; side < 2; side++)
+        {
+            float t = ((side == 0 ? boxMin[axis] : boxMax[axis]) - o[axis]) / d[axis];
+            float px = o[0] + d[0] * t;
+            float py = o[1] + d[1] * t;
+            float pz = o[2] + d[2] * t;
+
+            bool outside = px < boxMin[0] || px > boxMax[0] ||
+                py < boxMin[1] || py > boxMax[1] ||
+                pz < boxMin[2] || pz > boxMax[2];
+            if (!outside && t > 0 && t < best)
+            {
+                best = t;
+            }
+        }
+    }
+
+    tHit = best;
+    return best < tLimit;
+}
+
+static int intersectBoxesScalar(const BoxArray& boxes, int first, int count, const BoxRay& ray, float tLimit, float& tHit)
+{
+    int hitIndex = -1;
+    float best = tLimit;
+
+    for (int i = first; i < first + count; i++)
+    {
+        float boxMin[3] = { boxes.minX[i], boxes.minY[i], boxes.minZ[i] };
+        float boxMax[3] = { boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i] };
+
+        float t;
+        if (intersectBox(boxMin, boxMax, ray, best, t))
+        {
+            best = t;
+            hitIndex = i;
+        }
+    }
+
+    tHit = best;
+    return hitIndex;
+}
+
+static void intersectBoxPacketScalar(const float boxMin[3], const float boxMax[3], const RayPacket& packet, float tLimit, float* tHits)
+{
+    for (int i = 0; i < packet.nCount; i++)
+    {
+        intersectBox(boxMin, boxMax, BoxRay(packet.lines[i]), tLimit, tHits[i]);
+    }
+}
+
+#ifdef BOX_KERNEL_X86
+
+// One ray per lane, the box and the origin are the same for all lanes
+__attribute__((target("sse2")))
+static void intersectBoxPacketSse(const float boxMin[3], const float boxMax[3], const RayPacket& packet, float tLimit, float* tHits)
+{
+    const float* o = packet.fOrigin;
+    __m128 origin[3] = { _mm_set1_ps(o[0]), _mm_set1_ps(o[1]), _mm_set1_ps(o[2]) };
+    __m128 lower[3] = { _mm_set1_ps(boxMin[0]), _mm_set1_ps(boxMin[1]), _mm_set1_ps(boxMin[2]) };
+    __m128 upper[3] = { _mm_set1_ps(boxMax[0]), _mm_set1_ps(boxMax[1]), _mm_set1_ps(boxMax[2]) };
+    __m128 zero = _mm_setzero_ps();
+
+    for (int i = 0; i < packet.nCount; i += 4)
+    {
+        __m128 direction[3];
+        __m128 usable[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            direction[axis] = _mm_loadu_ps(&packet.fDirection[axis][i]);
+            usable[axis] = _mm_loadu_ps((const float*)&packet.nAxisMask[axis][i]);
+        }
+
+        __m128 best = _mm_set1_ps(tLimit);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            for (int side = 0; side < 2; side++)
+            {
+                float distance = (side == 0 ? boxMin[axis] : boxMax[axis]) - o[axis];
+                __m128 t = _mm_div_ps(_mm_set1_ps(distance), direction[axis]);
+
+                __m128 valid = _mm_and_ps(usable[axis], _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, best)));
+                for (int k = 0; k < 3; k++)
+                {
+                    __m128 p = _mm_add_ps(origin[k], _mm_mul_ps(direction[k], t));
+                    // not (p < min || p > max), so NaN points pass like in Cube
+                    __m128 outside = _mm_or_ps(_mm_cmplt_ps(p, lower[k]), _mm_cmpgt_ps(p, upper[k]));
+                    valid = _mm_andnot_ps(outside, valid);
+                }
+
+                best = _mm_or_ps(_mm_and_ps(valid, t), _mm_andnot_ps(valid, best));
+            }
+        }
+        _mm_storeu_ps(&tHits[i], best);
+    }
+}
+
+__attribute__((target("sse2")))
+static int intersectBoxesSse(const BoxArray& boxes, int first, int count, const BoxRay& ray, float tLimit, float& tHit)
+{
+    const float* o = ray.fOrigin;
+    const float* d = ray.fDirection;
+    __m128 origin[3] = { _mm_set1_ps(o[0]), _mm_set1_ps(o[1]), _mm_set1_ps(o[2]) };
+    __m128 direction[3] = { _mm_set1_ps(d[0]), _mm_set1_ps(d[1]), _mm_set1_ps(d[2]) };
+    __m128 zero = _mm_setzero_ps();
+
+    __m128 best = _mm_set1_ps(tLimit);
+    __m128i bestIndex = _mm_set1_epi32(-1);
+    __m128i end = _mm_set1_epi32(first + count);
+
+    for (int i = first; i < first + count; i += 4)
+    {
+        __m128 boxMin[3] = { _mm_loadu_ps(&boxes.minX[i]), _mm_loadu_ps(&boxes.minY[i]), _mm_loadu_ps(&boxes.minZ[i]) };
+        __m128 boxMax[3] = { _mm_loadu_ps(&boxes.maxX[i]), _mm_loadu_ps(&boxes.maxY[i]), _mm_loadu_ps(&boxes.maxZ[i]) };
+        __m128i index = _mm_add_epi32(_mm_set1_epi32(i), _mm_set_epi32(3, 2, 1, 0));
+        __m128 inRange = _mm_castsi128_ps(_mm_cmplt_epi32(index, end));
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (fabsf(d[axis]) < F_PARALLEL_EPSILON)
+            {
+                continue;
+            }
+
+            for (int side = 0; side < 2; side++)
+            {
+                __m128 t = _mm_div_ps(_mm_sub_ps(side == 0 ? boxMin[axis] : boxMax[axis], origin[axis]), direction[axis]);
+
+                __m128 valid = _mm_and_ps(inRange, _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, best)));
+                for (int k = 0; k < 3; k++)
+                {
+                    __m128 p = _mm_add_ps(origin[k], _mm_mul_ps(direction[k], t));
+                    // not (p < min || p > max), so NaN points pass like in Cube
+                    __m128 outside = _mm_or_ps(_mm_cmplt_ps(p, boxMin[k]), _mm_cmpgt_ps(p, boxMax[k]));
+                    valid = _mm_andnot_ps(outside, valid);
+                }
+
+                best = _mm_or_ps(_mm_and_ps(valid, t), _mm_andnot_ps(valid, best));
+                __m128i validIndex = _mm_castps_si128(valid);
+                bestIndex = _mm_or_si128(_mm_and_si128(validIndex, index), _mm_andnot_si128(validIndex, bestIndex));
+            }
+        }
+    }
+
+    float lanesBest[4];
+    int lanesIndex[4];
+    _mm_storeu_ps(lanesBest, best);
+    _mm_storeu_si128((__m128i*)lanesIndex, bestIndex);
+
+    int hitIndex = -1;
+    tHit = tLimit;
+    for (int lane = 0; lane < 4; lane++)
+    {
+        if (lanesIndex[lane] != -1 && (lanesBest[lane] < tHit || (lanesBest[lane] == tHit && lanesIndex[lane] < hitIndex)))
+        {
+            tHit = lanesBest[lane];
+            hitIndex = lanesIndex[lane];
+        }
+    }
+    return hitIndex;
+}
+
+__attribute__((target("avx2")))
+static int intersectBoxesAvx2(const BoxArray& boxes, int first, int count, const BoxRay& ray, float tLimit, float& tHit)
+{
+    const float* o = ray.fOrigin;
+    const float* d = ray.fDirection;
+    __m256 origin[3] = { _mm256_set1_ps(o[0]), _mm256_set1_ps(o[1]), _mm256_set1_ps(o[2]) };
+    __m256 direction[3] = { _mm256_set1_ps(d[0]), _mm256_set1_ps(d[1]), _mm256_set1_ps(d[2]) };
+    __m256 zero = _mm256_setzero_ps();
+
+    __m256 best = _mm256_set1_ps(tLimit);
+    __m256i bestIndex = _mm256_set1_epi32(-1);
+    __m256i end = _mm256_set1_epi32(first + count);
+
+    for (int i = first; i < first + count; i += 8)
+    {
+        __m256 boxMin[3] = { _mm256_loadu_ps(&boxes.minX[i]), _mm256_loadu_ps(&boxes.minY[i]), _mm256_loadu_ps(&boxes.minZ[i]) };
+        __m256 boxMax[3] = { _mm256_loadu_ps(&boxes.maxX[i]), _mm256_loadu_ps(&boxes.maxY[i]), _mm256_loadu_ps(&boxes.maxZ[i]) };
+        __m256i index = _mm256_add_epi32(_mm256_set1_epi32(i), _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+        __m256 inRange = _mm256_castsi256_ps(_mm256_cmpgt_epi32(end, index));
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (fabsf(d[axis]) < F_PARALLEL_EPSILON)
+            {
+                continue;
+            }
+
+            for (int side = 0; side < 2; side++)
+            {
+                __m256 t = _mm256_div_ps(_mm256_sub_ps(side == 0 ? boxMin[axis] : boxMax[axis], origin[axis]), direction[axis]);
+
+                __m256 valid = _mm256_and_ps(inRange, _mm256_and_ps(_mm256_cmp_ps(t, zero, _CMP_GT_OQ), _mm256_cmp_ps(t, best, _CMP_LT_OQ)));
+                for (int k = 0; k < 3; k++)
+                {
+                    __m256 p = _mm256_add_ps(origin[k], _mm256_mul_ps(direction[k], t));
+                    // not (p < min || p > max), so NaN points pass like in Cube
+                    __m256 outside = _mm256_or_ps(_mm256_cmp_ps(p, boxMin[k], _CMP_LT_OQ), _mm256_cmp_ps(p, boxMax[k], _CMP_GT_OQ));
+                    valid = _mm256_andnot_ps(outside, valid);
+                }
+
+                best = _mm256_blendv_ps(best, t, valid);
+                bestIndex = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(bestIndex), _mm256_castsi256_ps(index), valid));
+            }
+        }
+    }
+
+    float lanesBest[8];
+    int lanesIndex[8];
+    _mm256_storeu_ps(lanesBest, best);
+    _mm256_storeu_si256((__m256i*)lanesIndex, bestIndex);
+
+    int hitIndex = -1;
+    tHit = tLimit;
+    for (int lane = 0; lane < 8; lane++)
+    {
+        if (lanesIndex[lane] != -1 && (lanesBest[lane] < tHit || (lanesBest[lane] == tHit && lanesIndex[lane] < hitIndex)))
+        {
+            tHit = lanesBest[lane];
+            hitIndex = lanesIndex[lane];
+        }
+    }
+    return hitIndex;
+}
+
+#endif
+
+void intersectBoxPacket(const float boxMin[3], const float boxMax[3], const RayPacket& packet, float tLimit, float* tHits)
+{
+#ifdef BOX_KERNEL_X86
+    static const bool bSse = isBoxKernelSupported(BOX_KERNEL_SSE);
+    if (bSse)
+    {
+        intersectBoxPacketSse(boxMin, boxMax, packet, tLimit, tHits);
+        return;
+    }
+#endif
+    intersectBoxPacketScalar(boxMin, boxMax, packet, tLimit, tHits);
+}
+
+bool isBoxKernelSupported(BoxKernelType type)
+{
+    switch (type)
+    {
+        case BOX_KERNEL_NONE:
+        case BOX_KERNEL_SCALAR:
+            return true;
+#ifdef BOX_KERNEL_X86
+        case BOX_KERNEL_SSE:
+            return __builtin_cpu_supports("sse2");
+        case BOX_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+BoxKernelType getBestBoxKernel()
+{
+    if (isBoxKernelSupported(BOX_KERNEL_AVX2)) { return BOX_KERNEL_AVX2; }
+    if (isBoxKernelSupported(BOX_KERNEL_SSE))  { return BOX_KERNEL_SSE; }
+    return BOX_KERNEL_SCALAR;
+}
+
+BoxKernel getBoxKernel(BoxKernelType type)
+{
+    if (!isBoxKernelSupported(type))
+    {
+        return nullptr;
+    }
+
+    switch (type)
+    {
+        case BOX_KERNEL_SCALAR: return intersectBoxesScalar;
+#ifdef BOX_KERNEL_X86
+        case BOX_KERNEL_SSE:    return intersectBoxesSse;
+        case BOX_KERNEL_AVX2:   return intersectBoxesAvx2;
+#endif
+        default:                return nullptr;
+    }
+}
+
+const char* getBoxKernelName(BoxKernelType type)
+{
+    switch (type)
+    {
+        case BOX_KERNEL_SCALAR: return "scalar";
+        case BOX_KERNEL_SSE:    return "sse";
+        case BOX_KERNEL_AVX2:   return "avx2";
+        default:                return "none";
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef BOXKERNEL_H
+#define BOXKERNEL_H
+
+#include <vector>
+#include "geometry.h"
+#include "arena.h"
+#include "packet.h"
+
+/*
+    Vectorized ray - box test for Cube-like objects.
+
+    It repeats exactly what Cube::getIntersection computes with its six planes:
+    for every face the ray parameter t = (bound - origin) / direction, the point
+    origin + direction * t, and a check that the point lies within the box bounds.
+    Faces the ray is parallel to (|direction| < 1e-6) are skipped, like in Plane.
+    So the nearest t is bit-identical to the one the Cube path finds.
+*/
+
+enum BoxKernelType
+{
+    BOX_KERNEL_NONE,    // Don't use the kernel, call GameObject::getIntersection
+    BOX_KERNEL_SCALAR,
+    BOX_KERNEL_SSE,     // 4 boxes at a time
+    BOX_KERNEL_AVX2     // 8 boxes at a time
+};
+
+// Box bounds as structure of arrays. Arrays are padded with empty boxes,
+// so kernels may read up to 8 boxes past the last one.
+// Storage is either owned by the array or taken from an arena.
+struct BoxArray
+{
+    float* minX = nullptr;
+    float* minY = nullptr;
+    float* minZ = nullptr;
+    float* maxX = nullptr;
+    float* maxY = nullptr;
+    float* maxZ = nullptr;
+    int nCount = 0;
+
+    std::vector<float> storage;
+
+    BoxArray() {}
+
+    // Arrays point into their own storage
+    BoxArray(const BoxArray&) = delete;
+
+    BoxArray& operator=(const BoxArray&) = delete;
+
+    // Resizes to count empty boxes
+    void resize(int count);
+
+    void resize(int count, Arena& arena);
+
+    void set(int index, Vector3D minCorner, Vector3D maxCorner);
+
+    // Marks the box as empty, kernels never report hits on it
+    void clear(int index);
+};
+
+// Ray the way kernels read it
+struct BoxRay
+{
+    float fOrigin[3];
+    float fDirection[3];
+
+    BoxRay(Line line);
+};
+
+// Returns index of the box with the nearest hit among [first, first + count) with 0 < t < tLimit,
+//     writes its ray parameter to tHit. Returns -1 if there is none. Ties go to the lower index.
+typedef int (*BoxKernel)(const BoxArray& boxes, int first, int count, const BoxRay& ray, float tLimit, float& tHit);
+
+// Nearest hit with 0 < t < tLimit on a single box, the same arithmetic as the kernels.
+//     Returns false if there is none
+bool intersectBox(const float boxMin[3], const float boxMax[3], const BoxRay& ray, float tLimit, float& tHit);
+
+// Nearest hit with 0 < t < tLimit on a single box for every ray of the packet, 4 rays at a time where
+//     the CPU has SSE. Writes tLimit for rays that miss. tHits has room for N_MAX_PACKET_RAYS values
+void intersectBoxPacket(const float boxMin[3], const float boxMax[3], const RayPacket& packet, float tLimit, float* tHits);
+
+bool isBoxKernelSupported(BoxKernelType type);
+
+// Widest kernel the CPU supports
+BoxKernelType getBestBoxKernel();
+
+// Returns nullptr for BOX_KERNEL_NONE and kernels the CPU doesn't support
+BoxKernel getBoxKernel(BoxKernelType type);
+
+const char* getBoxKernelName(BoxKernelType type);
+
+#endif
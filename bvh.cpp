@@ -0,0 +1,554 @@
+#include <algorithm>
+#include <limits>
+#include "bvh.h"
+
+// Number of bins used to evaluate split candidates along each axis
+const int N_SAH_BINS = 12;
+const int N_MAX_LEAF_SIZE = 2;
+// Deeper nodes become leaves, which bounds the traversal stack
+const int N_MAX_DEPTH = 60;
+
+
+static void growBounds(float* dstMin, float* dstMax, const float* srcMin, const float* srcMax)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        dstMin[i] = std::min(dstMin[i], srcMin[i]);
+        dstMax[i] = std::max(dstMax[i], srcMax[i]);
+    }
+}
+
+static float surfaceArea(const float* boxMin, const float* boxMax)
+{
+    float dx = boxMax[0] - boxMin[0];
+    float dy = boxMax[1] - boxMin[1];
+    float dz = boxMax[2] - boxMin[2];
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+static void readBounds(GameObject* obj, float* boxMin, float* boxMax)
+{
+    Vector3D minCorner, maxCorner;
+    obj->getBounds(minCorner, maxCorner);
+    for (int i = 0; i < 3; i++)
+    {
+        boxMin[i] = minCorner[i];
+        boxMax[i] = maxCorner[i];
+    }
+}
+
+
+Bvh::Bvh()
+{
+}
+
+void Bvh::build(const std::vector<GameObject*>& objects)
+{
+    this->nodes.clear();
+    this->parents.clear();
+    this->primitives.clear();
+    this->looseObjects.clear();
+    this->primitiveOfObject.clear();
+
+    Vector3D minCorner, maxCorner;
+    for (int i = 0; i < (int)objects.size(); i++)
+    {
+        Primitive prim = { objects[i], i };
+        if (objects[i]->getBounds(minCorner, maxCorner))
+        {
+            this->primitives.push_back(prim);
+        }
+        else
+        {
+            this->looseObjects.push_back(prim);
+        }
+    }
+
+    int count = (int)this->primitives.size();
+    this->leafOfPrimitive.assign(count, -1);
+    if (count == 0)
+    {
+        return;
+    }
+
+    // Bounds and centroids are kept next to the primitives while they are partitioned
+    std::vector<float> bounds(count * 6);
+    std::vector<float> centroids(count * 3);
+    for (int i = 0; i < count; i++)
+    {
+        readBounds(this->primitives[i].obj, &bounds[i * 6], &bounds[i * 6 + 3]);
+        for (int k = 0; k < 3; k++)
+        {
+            centroids[i * 3 + k] = 0.5f * (bounds[i * 6 + k] + bounds[i * 6 + 3 + k]);
+        }
+    }
+
+    this->nodes.reserve(2 * count);
+    this->parents.reserve(2 * count);
+    this->buildNode(0, count, -1, 0, bounds, centroids);
+
+    // Primitives are reordered by the build
+    this->boxes.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        this->primitiveOfObject[this->primitives[i].obj] = i;
+        this->updateBox(i);
+    }
+}
+
+int Bvh::buildNode(int first, int count, int parent, int depth, std::vector<float>& bounds, std::vector<float>& centroids)
+{
+    const float fInf = std::numeric_limits<float>::infinity();
+
+    int index = (int)this->nodes.size();
+    BvhNode node = { { fInf, fInf, fInf }, { -fInf, -fInf, -fInf }, first, count };
+    float centroidMin[3] = { fInf, fInf, fInf };
+    float centroidMax[3] = { -fInf, -fInf, -fInf };
+    for (int i = first; i < first + count; i++)
+    {
+        growBounds(node.fMin, node.fMax, &bounds[i * 6], &bounds[i * 6 + 3]);
+        growBounds(centroidMin, centroidMax, &centroids[i * 3], &centroids[i * 3]);
+    }
+    this->nodes.push_back(node);
+    this->parents.push_back(parent);
+
+    // Find the cheapest binned split
+    int bestAxis = -1;
+    int bestSplit = 0;
+    float bestCost = count * surfaceArea(node.fMin, node.fMax);   // Cost of keeping a leaf
+    if (count > N_MAX_LEAF_SIZE && depth < N_MAX_DEPTH)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float extent = centroidMax[axis] - centroidMin[axis];
+            if (extent <= 0.0f)
+            {
+                continue;
+            }
+
+            int binCount[N_SAH_BINS] = {};
+            float binMin[N_SAH_BINS][3], binMax[N_SAH_BINS][3];
+            for (int b = 0; b < N_SAH_BINS; b++)
+            {
+                binMin[b][0] = binMin[b][1] = binMin[b][2] = fInf;
+                binMax[b][0] = binMax[b][1] = binMax[b][2] = -fInf;
+            }
+
+            float scale = N_SAH_BINS / extent;
+            for (int i = first; i < first + count; i++)
+            {
+                int b = std::min(N_SAH_BINS - 1, (int)((centroids[i * 3 + axis] - centroidMin[axis]) * scale));
+                binCount[b]++;
+                growBounds(binMin[b], binMax[b], &bounds[i * 6], &bounds[i * 6 + 3]);
+            }
+
+            // Sweep from the right to get area and count of every right side
+            float rightArea[N_SAH_BINS];
+            int rightCount[N_SAH_BINS];
+            float sweepMin[3] = { fInf, fInf, fInf };
+            float sweepMax[3] = { -fInf, -fInf, -fInf };
+            int sweepCount = 0;
+            for (int b = N_SAH_BINS - 1; b > 0; b--)
+            {
+                growBounds(sweepMin, sweepMax, binMin[b], binMax[b]);
+                sweepCount += binCount[b];
+                rightArea[b] = sweepCount > 0 ? surfaceArea(sweepMin, sweepMax) : 0.0f;
+                rightCount[b] = sweepCount;
+            }
+
+            float leftMin[3] = { fInf, fInf, fInf };
+            float leftMax[3] = { -fInf, -fInf, -fInf };
+            int leftCount = 0;
+            for (int b = 0; b < N_SAH_BINS - 1; b++)
+            {
+                growBounds(leftMin, leftMax, binMin[b], binMax[b]);
+                leftCount += binCount[b];
+                if (leftCount == 0 || rightCount[b + 1] == 0)
+                {
+                    continue;
+                }
+
+                float cost = leftCount * surfaceArea(leftMin, leftMax) + rightCount[b + 1] * rightArea[b + 1];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b;
+                }
+            }
+        }
+    }
+
+    if (bestAxis == -1)
+    {
+        for (int i = first; i < first + count; i++)
+        {
+            this->leafOfPrimitive[i] = index;
+        }
+        return index;
+    }
+
+    // Partition primitives (with their bounds and centroids) around the chosen bin
+    float scale = N_SAH_BINS / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+    int mid = first;
+    for (int i = first; i < first + count; i++)
+    {
+        int b = std::min(N_SAH_BINS - 1, (int)((centroids[i * 3 + bestAxis] - centroidMin[bestAxis]) * scale));
+        if (b <= bestSplit)
+        {
+            std::swap(this->primitives[i], this->primitives[mid]);
+            std::swap_ranges(bounds.begin() + i * 6, bounds.begin() + i * 6 + 6, bounds.begin() + mid * 6);
+            std::swap_ranges(centroids.begin() + i * 3, centroids.begin() + i * 3 + 3, centroids.begin() + mid * 3);
+            mid++;
+        }
+    }
+
+    this->buildNode(first, mid - first, index, depth + 1, bounds, centroids);
+    int right = this->buildNode(mid, first + count - mid, index, depth + 1, bounds, centroids);
+    this->nodes[index].nOffset = right;
+    this->nodes[index].nCount = 0;
+    return index;
+}
+
+void Bvh::updateBox(int primitive)
+{
+    GameObject* obj = this->primitives[primitive].obj;
+    Vector3D minCorner, maxCorner;
+    if (obj->isBox() && obj->getBounds(minCorner, maxCorner))
+    {
+        this->boxes.set(primitive, minCorner, maxCorner);
+    }
+    else
+    {
+        this->boxes.clear(primitive);
+    }
+}
+
+void Bvh::refitNode(int index)
+{
+    const float fInf = std::numeric_limits<float>::infinity();
+    BvhNode& node = this->nodes[index];
+    float boxMin[3], boxMax[3];
+
+    for (int i = 0; i < 3; i++)
+    {
+        node.fMin[i] = fInf;
+        node.fMax[i] = -fInf;
+    }
+
+    if (node.nCount > 0)
+    {
+        for (int i = node.nOffset; i < node.nOffset + node.nCount; i++)
+        {
+            readBounds(this->primitives[i].obj, boxMin, boxMax);
+            growBounds(node.fMin, node.fMax, boxMin, boxMax);
+            this->updateBox(i);
+        }
+    }
+    else
+    {
+        const BvhNode& left = this->nodes[index + 1];
+        const BvhNode& right = this->nodes[node.nOffset];
+        growBounds(node.fMin, node.fMax, left.fMin, left.fMax);
+        growBounds(node.fMin, node.fMax, right.fMin, right.fMax);
+    }
+}
+
+void Bvh::refit()
+{
+    // Children always come after their parent
+    for (int i = (int)this->nodes.size() - 1; i >= 0; i--)
+    {
+        this->refitNode(i);
+    }
+}
+
+void Bvh::refit(GameObject* obj)
+{
+    std::unordered_map<GameObject*, int>::const_iterator it = this->primitiveOfObject.find(obj);
+    if (it == this->primitiveOfObject.end())
+    {
+        return;
+    }
+
+    for (int node = this->leafOfPrimitive[it->second]; node != -1; node = this->parents[node])
+    {
+        this->refitNode(node);
+    }
+}
+
+// Returns entry parameter of the ray into the node box, or infinity if it misses
+static float intersectNode(const BvhNode& node, const float* origin, const float* invDirection, float tMax)
+{
+    float tEnter = 0.0f;
+    float tExit = tMax;
+    for (int i = 0; i < 3; i++)
+    {
+        float t1 = (node.fMin[i] - origin[i]) * invDirection[i];
+        float t2 = (node.fMax[i] - origin[i]) * invDirection[i];
+        // NaN (0 * inf) happens when the ray lies in a slab face: it touches the box along the
+        //     whole slab, which counts as a hit the same as a face touched by Cube::getIntersection
+        if (t1 != t1 || t2 != t2)
+        {
+            continue;
+        }
+        tEnter = std::max(tEnter, std::min(t1, t2));
+        tExit = std::min(tExit, std::max(t1, t2));
+    }
+    // A ray through an edge of the box enters and leaves it at the same parameter, which rounding
+    //     can put either way; keep those, the leaf test decides whether the edge is hit
+    return tEnter <= tExit * 1.00001f + 1e-6f ? tEnter : std::numeric_limits<float>::infinity();
+}
+
+GameObject* Bvh::findNearestHit(Line ray, float depth, BoxKernel boxKernel, std::pair<float, Glyph>& intersection,
+    int* objectIndex) const
+{
+    const float fInf = std::numeric_limits<float>::infinity();
+
+    GameObject* bestObj = nullptr;
+    int bestIndex = -1;
+    float bestDistance = depth;
+    if (objectIndex != nullptr)
+    {
+        *objectIndex = -1;
+    }
+
+    // Keeps a candidate if it is closer, or as close and earlier in the object list
+    auto offer = [&](const Primitive& prim, const std::pair<float, Glyph>& localRes)
+    {
+        if (localRes.first > 0 &&
+            (localRes.first < bestDistance || (localRes.first == bestDistance && bestObj != nullptr && prim.nObjectIndex < bestIndex)))
+        {
+            bestDistance = localRes.first;
+            bestIndex = prim.nObjectIndex;
+            bestObj = prim.obj;
+            intersection = localRes;
+            if (objectIndex != nullptr)
+            {
+                *objectIndex = bestIndex;
+            }
+        }
+    };
+
+    auto consider = [&](const Primitive& prim)
+    {
+        offer(prim, prim.obj->getIntersection(ray, depth));
+    };
+
+    for (const Primitive& prim: this->looseObjects)
+    {
+        consider(prim);
+    }
+
+    if (this->nodes.empty())
+    {
+        return bestObj;
+    }
+
+    Vector3D rayOrigin = ray.getOwnPoint();
+    Vector3D rayDirection = ray.getDirection();
+    float origin[3] = { rayOrigin[0], rayOrigin[1], rayOrigin[2] };
+    float invDirection[3] = { 1.0f / rayDirection[0], 1.0f / rayDirection[1], 1.0f / rayDirection[2] };
+    BoxRay boxRay(ray);
+
+    // Objects report sqrt of the ray parameter as their distance; the slack keeps
+    // boxes that start exactly at the current best hit, so ties are resolved by index
+    auto parameterLimit = [&]() { return bestDistance * bestDistance * 1.0001f + 1e-4f; };
+
+    int stack[N_MAX_DEPTH + 1];
+    int stackSize = 0;
+    int current = 0;
+    if (intersectNode(this->nodes[0], origin, invDirection, parameterLimit()) == fInf)
+    {
+        return bestObj;
+    }
+
+    while (true)
+    {
+        const BvhNode& node = this->nodes[current];
+        if (node.nCount > 0 && boxKernel != nullptr)
+        {
+            // Same distance and shade as Cube::getIntersection would give
+            float t;
+            int hit = boxKernel(this->boxes, node.nOffset, node.nCount, boxRay, parameterLimit(), t);
+            if (hit != -1)
+            {
+                GameObject* obj = this->primitives[hit].obj;
+                offer(this->primitives[hit], std::make_pair(sqrtf(t), obj->getCharByDistance(depth, t)));
+            }
+
+            for (int i = node.nOffset; i < node.nOffset + node.nCount; i++)
+            {
+                if (!this->primitives[i].obj->isBox())
+                {
+                    consider(this->primitives[i]);
+                }
+            }
+        }
+        else if (node.nCount > 0)
+        {
+            for (int i = node.nOffset; i < node.nOffset + node.nCount; i++)
+            {
+                consider(this->primitives[i]);
+            }
+        }
+        else
+        {
+            // Visit the nearer child first, push the farther one
+            int left = current + 1;
+            int right = node.nOffset;
+            float tLeft = intersectNode(this->nodes[left], origin, invDirection, parameterLimit());
+            float tRight = intersectNode(this->nodes[right], origin, invDirection, parameterLimit());
+            if (tRight < tLeft)
+            {
+                std::swap(left, right);
+                std::swap(tLeft, tRight);
+            }
+
+            if (tLeft != fInf)
+            {
+                if (tRight != fInf)
+                {
+                    stack[stackSize++] = right;
+                }
+                current = left;
+                continue;
+            }
+        }
+
+        // Pop the next node that can still hold a closer hit
+        bool found = false;
+        while (stackSize > 0)
+        {
+            current = stack[--stackSize];
+            if (intersectNode(this->nodes[current], origin, invDirection, parameterLimit()) != fInf)
+            {
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+        {
+            break;
+        }
+    }
+
+    return bestObj;
+}
+
+void Bvh::findNearestHits(const RayPacket& packet, float depth, GameObject** objects, std::pair<float, Glyph>* intersections) const
+{
+    const float fInf = std::numeric_limits<float>::infinity();
+
+    int bestIndex[N_MAX_PACKET_RAYS];
+    for (int i = 0; i < packet.nCount; i++)
+    {
+        objects[i] = nullptr;
+        bestIndex[i] = -1;
+        intersections[i] = std::make_pair(depth, (Glyph)' ');
+    }
+
+    // Same rule as findNearestHit, ray by ray, so the order objects are tested in doesn't matter
+    std::pair<float, Glyph> localRes[N_MAX_PACKET_RAYS];
+    float tLimit = depth * depth * 1.0001f + 1e-4f;
+    auto consider = [&](const Primitive& prim)
+    {
+        prim.obj->intersectPacket(packet, depth, localRes);
+
+        bool changed = false;
+        for (int i = 0; i < packet.nCount; i++)
+        {
+            if (localRes[i].first > 0 && (localRes[i].first < intersections[i].first ||
+                (localRes[i].first == intersections[i].first && objects[i] != nullptr && prim.nObjectIndex < bestIndex[i])))
+            {
+                bestIndex[i] = prim.nObjectIndex;
+                objects[i] = prim.obj;
+                intersections[i] = localRes[i];
+                changed = true;
+            }
+        }
+
+        // Nodes farther than every ray's hit can't hold a closer one, the slack keeps ties
+        if (changed)
+        {
+            float farthest = 0.0f;
+            for (int i = 0; i < packet.nCount; i++)
+            {
+                farthest = std::max(farthest, intersections[i].first);
+            }
+            tLimit = farthest * farthest * 1.0001f + 1e-4f;
+        }
+    };
+
+    for (const Primitive& prim: this->looseObjects)
+    {
+        consider(prim);
+    }
+
+    if (this->nodes.empty())
+    {
+        return;
+    }
+
+    // Stack of nodes with their packet entry parameter, nearer child visited first
+    int stack[N_MAX_DEPTH + 1];
+    float stackEntry[N_MAX_DEPTH + 1];
+    int stackSize = 0;
+    int current = 0;
+    if (packet.intersectBounds(this->nodes[0].fMin, this->nodes[0].fMax, tLimit) == fInf)
+    {
+        return;
+    }
+
+    while (true)
+    {
+        const BvhNode& node = this->nodes[current];
+        if (node.nCount > 0)
+        {
+            for (int i = node.nOffset; i < node.nOffset + node.nCount; i++)
+            {
+                consider(this->primitives[i]);
+            }
+        }
+        else
+        {
+            int left = current + 1;
+            int right = node.nOffset;
+            float tLeft = packet.intersectBounds(this->nodes[left].fMin, this->nodes[left].fMax, tLimit);
+            float tRight = packet.intersectBounds(this->nodes[right].fMin, this->nodes[right].fMax, tLimit);
+            if (tRight < tLeft)
+            {
+                std::swap(left, right);
+                std::swap(tLeft, tRight);
+            }
+
+            if (tLeft != fInf)
+            {
+                if (tRight != fInf)
+                {
+                    stack[stackSize] = right;
+                    stackEntry[stackSize++] = tRight;
+                }
+                current = left;
+                continue;
+            }
+        }
+
+        // Pop the next node some ray can still hit closer
+        bool found = false;
+        while (stackSize > 0)
+        {
+            stackSize--;
+            if (stackEntry[stackSize] < tLimit)
+            {
+                current = stack[stackSize];
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+        {
+            break;
+        }
+    }
+}
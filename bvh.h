@@ -0,0 +1,75 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <unordered_map>
+#include <vector>
+#include "geometry.h"
+#include "objects.h"
+#include "boxkernel.h"
+
+/*
+    Bounding volume hierarchy over the bounds of scene objects.
+    Built top-down with a binned surface area heuristic and stored as a flat array of nodes
+    in depth-first order: the left child of an inner node follows it, the right child is at nOffset.
+    Objects without bounds (floor, ceiling) are kept aside and tested for every ray.
+    Bounds of box primitives are also kept as structure of arrays, so leaves can be tested with a box kernel.
+*/
+
+struct BvhNode
+{
+    float fMin[3];
+    float fMax[3];
+    int nOffset;    // Leaf: first primitive, inner node: right child
+    int nCount;     // Number of primitives, 0 for inner nodes
+};
+
+class Bvh
+{
+private:
+    struct Primitive
+    {
+        GameObject* obj;
+        int nObjectIndex;   // Index in the list the tree was built from, used to break distance ties
+    };
+
+    std::vector<BvhNode> nodes;
+    std::vector<int> parents;           // Parent of each node, -1 for the root
+    std::vector<Primitive> primitives;  // Leaves reference ranges of this array
+    std::vector<int> leafOfPrimitive;
+    std::unordered_map<GameObject*, int> primitiveOfObject;
+    BoxArray boxes;                     // Bounds of box primitives, in primitive order
+    std::vector<Primitive> looseObjects;
+
+    int buildNode(int first, int count, int parent, int depth, std::vector<float>& bounds, std::vector<float>& centroids);
+
+    void refitNode(int index);
+
+    void updateBox(int primitive);
+
+public:
+    Bvh();
+
+    void build(const std::vector<GameObject*>& objects);
+
+    // Recomputes bounds of the whole tree after any number of objects moved
+    void refit();
+
+    // Recomputes bounds from the leaf holding obj up to the root, call after obj moved
+    void refit(GameObject* obj);
+
+    int getNodeCount() const { return (int)this->nodes.size(); }
+
+    // Returns the nearest object hit closer than depth, including objects without bounds,
+    //     returns nullptr if there is none. Ties go to the object earlier in the build list.
+    //     Box primitives are tested with boxKernel unless it is nullptr. Writes the hit object's index in the build
+    //     list to objectIndex if it isn't nullptr, -1 if there is no hit
+    GameObject* findNearestHit(Line ray, float depth, BoxKernel boxKernel, std::pair<float, Glyph>& intersection,
+        int* objectIndex = nullptr) const;
+
+    // findNearestHit for every ray of the packet. Nodes are culled for the whole packet against the farthest
+    //     hit found so far and objects are tested with GameObject::intersectPacket. objects[i] is nullptr
+    //     if ray i hits nothing
+    void findNearestHits(const RayPacket& packet, float depth, GameObject** objects, std::pair<float, Glyph>* intersections) const;
+};
+
+#endif
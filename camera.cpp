@@ -0,0 +1,115 @@
+#include "camera.h"
+
+
+Camera::Camera()
+{
+}
+
+void Camera::setProjection(int width, int height, float fov)
+{
+    if (width == this->nWidth && height == this->nHeight && fov == this->fFov)
+    {
+        return;
+    }
+
+    this->nWidth = width;
+    this->nHeight = height;
+    this->fFov = fov;
+    this->rebuildTables();
+    this->rotateColumns();
+}
+
+void Camera::setPose(Vector3D position, float yaw)
+{
+    this->v3Position = position;
+    if (yaw != this->fYaw || this->worldDirX.empty())
+    {
+        this->fYaw = yaw;
+        this->rotateColumns();
+    }
+}
+
+void Camera::rebuildTables()
+{
+    float aspectRatio = (float)this->nWidth / (float)this->nHeight;
+    float tanHalfFov = tanf(this->fFov / 2.0f);
+    this->fAspectRatio = aspectRatio;
+    this->fTanHalfFov = tanHalfFov;
+
+    this->columnDirY.resize(this->nWidth);
+    for (int x = 0; x < this->nWidth; x++)
+    {
+        // Normalized device coordinates
+        float ndcX = (2.0f * x / (float)this->nWidth - 1.0f) * aspectRatio;
+        this->columnDirY[x] = ndcX * tanHalfFov;
+    }
+
+    this->rowDirZ.resize(this->nHeight);
+    for (int y = 0; y < this->nHeight; y++)
+    {
+        float ndcY = 1.0f - 2.0f * y / (float)this->nHeight;
+        this->rowDirZ[y] = ndcY * tanHalfFov;
+    }
+
+    this->worldDirX.resize(this->nWidth);
+    this->worldDirY.resize(this->nWidth);
+}
+
+void Camera::rotateColumns()
+{
+    float cosYaw = cosf(this->fYaw);
+    float sinYaw = sinf(this->fYaw);
+    this->fCosYaw = cosYaw;
+    this->fSinYaw = sinYaw;
+
+    // Plain arrays so the compiler can vectorize the loop
+    const float* dirY = this->columnDirY.data();
+    float* outX = this->worldDirX.data();
+    float* outY = this->worldDirY.data();
+    for (int x = 0; x < this->nWidth; x++)
+    {
+        // Camera space x is 1, the camera looks along the x-axis initially
+        outX[x] = cosYaw * 1.0f - sinYaw * dirY[x];
+        outY[x] = sinYaw * 1.0f + cosYaw * dirY[x];
+    }
+}
+
+bool Camera::project(Vector3D point, float& x, float& y) const
+{
+    float dx = point[0] - this->v3Position[0];
+    float dy = point[1] - this->v3Position[1];
+    float dz = point[2] - this->v3Position[2];
+
+    // Back to camera space, where every ray has x = 1
+    float forward = this->fCosYaw * dx + this->fSinYaw * dy;
+    if (forward <= 1e-4f)
+    {
+        return false;
+    }
+    float side = (this->fCosYaw * dy - this->fSinYaw * dx) / forward;
+    float up = dz / forward;
+
+    // Inverse of the column and row tables
+    x = (side / (this->fAspectRatio * this->fTanHalfFov) + 1.0f) * this->nWidth / 2.0f;
+    y = (1.0f - up / this->fTanHalfFov) * this->nHeight / 2.0f;
+    return true;
+}
+
+bool Camera::projectBillboard(Vector3D center, float width, float height, float& left, float& right, float& top, float& bottom) const
+{
+    float x, y;
+    if (!this->project(center, x, y))
+    {
+        return false;
+    }
+
+    // The rectangle lies at the center's distance along the view axis, so its size scales with 1 / forward
+    float forward = this->fCosYaw * (center[0] - this->v3Position[0]) + this->fSinYaw * (center[1] - this->v3Position[1]);
+    float halfWidth = width / (2.0f * forward * this->fAspectRatio * this->fTanHalfFov) * this->nWidth / 2.0f;
+    float halfHeight = height / (2.0f * forward * this->fTanHalfFov) * this->nHeight / 2.0f;
+    left = x - halfWidth;
+    right = x + halfWidth;
+    top = y - halfHeight;
+    bottom = y + halfHeight;
+    return true;
+}
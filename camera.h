@@ -0,0 +1,77 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <vector>
+#include "geometry.h"
+
+/*
+    Pinhole camera that caches ray directions.
+    The camera looks along +x before rotation, with y to the right and z up on the screen.
+    Camera-space directions depend only on resolution and FOV and are rebuilt when those change.
+    Yaw only rotates around z, so the rotated x and y depend on the screen column alone and
+    z on the row alone: a frame costs one rotation per column.
+*/
+
+class Camera
+{
+private:
+    int nWidth = 0;
+    int nHeight = 0;
+    float fFov = 0.0f;
+
+    Vector3D v3Position;
+    float fYaw = 0.0f;
+    float fCosYaw = 1.0f;
+    float fSinYaw = 0.0f;
+    float fTanHalfFov = 0.0f;
+    float fAspectRatio = 0.0f;
+
+    std::vector<float> columnDirY;   // Camera space y of the ray through each column
+    std::vector<float> rowDirZ;      // Camera space z of the ray through each row
+    std::vector<float> worldDirX;    // World x of each column's rays for the current yaw
+    std::vector<float> worldDirY;    // World y of each column's rays for the current yaw
+
+    void rebuildTables();
+
+    void rotateColumns();
+
+public:
+    Camera();
+
+    int getWidth() const { return this->nWidth; }
+
+    int getHeight() const { return this->nHeight; }
+
+    float getFov() const { return this->fFov; }
+
+    Vector3D getPosition() const { return this->v3Position; }
+
+    float getYaw() const { return this->fYaw; }
+
+    // Rebuilds the ray tables only if something changed
+    void setProjection(int width, int height, float fov);
+
+    void setPose(Vector3D position, float yaw);
+
+    // Direction of the ray through screen cell (x, y), not normalized
+    Vector3D getRayDirection(int x, int y) const
+    {
+        return Vector3D(this->worldDirX[x], this->worldDirY[x], this->rowDirZ[y]);
+    }
+
+    Line getRay(int x, int y) const { return Line(this->v3Position, this->getRayDirection(x, y)); }
+
+    // Horizontal direction of the rays through column x, not normalized; all of them lie in its vertical plane
+    Vector3D getColumnDirection(int x) const { return Vector3D(this->worldDirX[x], this->worldDirY[x], 0.0f); }
+
+    // Screen position of a world point, column x and row y land on the cell centers.
+    //     Returns false if the point is not in front of the camera
+    bool project(Vector3D point, float& x, float& y) const;
+
+    // Screen extent of a camera-facing width x height rectangle centered on point: the rays of columns
+    //     left to right and rows top to bottom pass through it (fractional, not clipped to the screen).
+    //     Returns false if the center is not in front of the camera
+    bool projectBillboard(Vector3D center, float width, float height, float& left, float& right, float& top, float& bottom) const;
+};
+
+#endif
@@ -0,0 +1,341 @@
+#include <algorithm>
+#include <math.h>
+#include "collision.h"
+
+const int N_MAX_SLIDES = 4;             // Walls a move may slide along before it stops
+const int N_MAX_PUSH_OUTS = 4;
+const int N_MOVERS_PER_JOB = 64;
+const float F_HALF_SQUARE = N_MAP_WORLD_RATIO / 2.0f;
+const float F_NO_CONTACT = 2.0f;
+
+
+// Map square the world coordinate lies in
+static int getSquare(float v)
+{
+    return (int)floorf((v + F_HALF_SQUARE) / N_MAP_WORLD_RATIO);
+}
+
+static void getSquareBox(int x, int y, float boxMin[2], float boxMax[2])
+{
+    boxMin[0] = x * N_MAP_WORLD_RATIO - F_HALF_SQUARE;
+    boxMin[1] = y * N_MAP_WORLD_RATIO - F_HALF_SQUARE;
+    boxMax[0] = x * N_MAP_WORLD_RATIO + F_HALF_SQUARE;
+    boxMax[1] = y * N_MAP_WORLD_RATIO + F_HALF_SQUARE;
+}
+
+// Fraction of delta at which a circle moving from pos touches the box, F_NO_CONTACT if it doesn't
+//     or moves away from it. The circle touches the box where its center enters the box grown by
+//     radius, whose corners are rounded
+static float sweepCircleBox(const float pos[2], const float delta[2], float radius, const float boxMin[2], const float boxMax[2], float normal[2])
+{
+    float tEnter = -INFINITY;
+    float tExit = INFINITY;
+    int axis = -1;
+    for (int i = 0; i < 2; i++)
+    {
+        float low = boxMin[i] - radius;
+        float high = boxMax[i] + radius;
+        if (delta[i] == 0.0f)
+        {
+            if (pos[i] <= low || pos[i] >= high)
+            {
+                return F_NO_CONTACT;
+            }
+            continue;
+        }
+        float t1 = (low - pos[i]) / delta[i];
+        float t2 = (high - pos[i]) / delta[i];
+        if (std::min(t1, t2) > tEnter)
+        {
+            tEnter = std::min(t1, t2);
+            axis = i;
+        }
+        tExit = std::min(tExit, std::max(t1, t2));
+    }
+    if (axis < 0 || tEnter > tExit || tExit <= 0.0f || tEnter > 1.0f)
+    {
+        return F_NO_CONTACT;
+    }
+
+    // Entering the grown box beside a corner of the box: the circle has to reach the corner itself
+    float t = std::max(tEnter, 0.0f);
+    float hit[2] = { pos[0] + delta[0] * t, pos[1] + delta[1] * t };
+    bool besideX = hit[0] < boxMin[0] || hit[0] > boxMax[0];
+    bool besideY = hit[1] < boxMin[1] || hit[1] > boxMax[1];
+    if (besideX && besideY)
+    {
+        float corner[2] = { hit[0] < boxMin[0] ? boxMin[0] : boxMax[0], hit[1] < boxMin[1] ? boxMin[1] : boxMax[1] };
+        float offset[2] = { pos[0] - corner[0], pos[1] - corner[1] };
+        float a = delta[0] * delta[0] + delta[1] * delta[1];
+        float b = offset[0] * delta[0] + offset[1] * delta[1];
+        float c = offset[0] * offset[0] + offset[1] * offset[1] - radius * radius;
+        float discriminant = b * b - a * c;
+        if (b >= 0.0f || discriminant < 0.0f)
+        {
+            return F_NO_CONTACT;
+        }
+        float tCorner = std::max((-b - sqrtf(discriminant)) / a, 0.0f);
+        if (tCorner > 1.0f)
+        {
+            return F_NO_CONTACT;
+        }
+        float length = sqrtf(std::max(c + radius * radius, 1e-12f));
+        normal[0] = offset[0] / length;
+        normal[1] = offset[1] / length;
+        if (tCorner > 0.0f)
+        {
+            normal[0] = (pos[0] + delta[0] * tCorner - corner[0]) / radius;
+            normal[1] = (pos[1] + delta[1] * tCorner - corner[1]) / radius;
+        }
+        return tCorner;
+    }
+
+    normal[0] = 0.0f;
+    normal[1] = 0.0f;
+    normal[axis] = delta[axis] > 0.0f ? -1.0f : 1.0f;
+    return t;
+}
+
+CollisionMap::CollisionMap()
+{
+    this->nWidth = 0;
+    this->nHeight = 0;
+    this->cells = nullptr;
+    this->chunks = nullptr;
+    this->nChunkShift = 0;
+    this->nChunksX = 0;
+    this->chunkLock = nullptr;
+}
+
+CollisionMap::CollisionMap(int width, int height, const unsigned char* mapCells)
+{
+    this->nWidth = width;
+    this->nHeight = height;
+    this->cells = mapCells;
+    this->chunks = nullptr;
+    this->nChunkShift = 0;
+    this->nChunksX = 0;
+    this->chunkLock = nullptr;
+}
+
+void CollisionMap::setChunks(const unsigned char* const* table, int chunkShift, int chunksX, ChunkTableLock* tableLock)
+{
+    this->chunks = table;
+    this->nChunkShift = chunkShift;
+    this->nChunksX = chunksX;
+    this->chunkLock = table != nullptr ? tableLock : nullptr;
+}
+
+float CollisionMap::findFirstContact(const float pos[2], const float delta[2], float radius, float normal[2]) const
+{
+    // Squares the swept circle's bounds cover
+    float reach = radius + F_COLLISION_SKIN;
+    int minX = getSquare(std::min(pos[0], pos[0] + delta[0]) - reach);
+    int maxX = getSquare(std::max(pos[0], pos[0] + delta[0]) + reach);
+    int minY = getSquare(std::min(pos[1], pos[1] + delta[1]) - reach);
+    int maxY = getSquare(std::max(pos[1], pos[1] + delta[1]) + reach);
+
+    float tFirst = F_NO_CONTACT;
+    for (int y = minY; y <= maxY; y++)
+    {
+        for (int x = minX; x <= maxX; x++)
+        {
+            if (!this->isWallSquare(x, y))
+            {
+                continue;
+            }
+            float boxMin[2], boxMax[2], boxNormal[2];
+            getSquareBox(x, y, boxMin, boxMax);
+            float t = sweepCircleBox(pos, delta, radius, boxMin, boxMax, boxNormal);
+            if (t < tFirst)
+            {
+                tFirst = t;
+                normal[0] = boxNormal[0];
+                normal[1] = boxNormal[1];
+            }
+        }
+    }
+    return tFirst;
+}
+
+bool CollisionMap::pushOut(float pos[2], float radius) const
+{
+    for (int i = 0; i < N_MAX_PUSH_OUTS; i++)
+    {
+        int minX = getSquare(pos[0] - radius);
+        int maxX = getSquare(pos[0] + radius);
+        int minY = getSquare(pos[1] - radius);
+        int maxY = getSquare(pos[1] + radius);
+
+        // Deepest overlap first
+        float fDepth = 0.0f;
+        float push[2] = { 0.0f, 0.0f };
+        for (int y = minY; y <= maxY; y++)
+        {
+            for (int x = minX; x <= maxX; x++)
+            {
+                if (!this->isWallSquare(x, y))
+                {
+                    continue;
+                }
+                float boxMin[2], boxMax[2];
+                getSquareBox(x, y, boxMin, boxMax);
+                float closest[2] = { std::min(std::max(pos[0], boxMin[0]), boxMax[0]), std::min(std::max(pos[1], boxMin[1]), boxMax[1]) };
+                float offset[2] = { pos[0] - closest[0], pos[1] - closest[1] };
+                float distance = sqrtf(offset[0] * offset[0] + offset[1] * offset[1]);
+                if (distance >= radius)
+                {
+                    continue;
+                }
+
+                float depth, direction[2];
+                if (distance > 0.0f)
+                {
+                    depth = radius - distance;
+                    direction[0] = offset[0] / distance;
+                    direction[1] = offset[1] / distance;
+                }
+                else
+                {
+                    // Center inside the square: out through the nearest side that isn't against another wall
+                    float sides[4] = { pos[0] - boxMin[0], boxMax[0] - pos[0], pos[1] - boxMin[1], boxMax[1] - pos[1] };
+                    const int neighbours[4][2] = { { x - 1, y }, { x + 1, y }, { x, y - 1 }, { x, y + 1 } };
+                    for (int side = 0; side < 4; side++)
+                    {
+                        if (this->isWallSquare(neighbours[side][0], neighbours[side][1]))
+                        {
+                            sides[side] = INFINITY;
+                        }
+                    }
+                    int side = (int)(std::min_element(sides, sides + 4) - sides);
+                    if (sides[side] == INFINITY)
+                    {
+                        return false;   // Buried in solid wall
+                    }
+                    depth = sides[side] + radius;
+                    direction[0] = side == 0 ? -1.0f : side == 1 ? 1.0f : 0.0f;
+                    direction[1] = side == 2 ? -1.0f : side == 3 ? 1.0f : 0.0f;
+                }
+                if (depth > fDepth)
+                {
+                    fDepth = depth;
+                    push[0] = direction[0];
+                    push[1] = direction[1];
+                }
+            }
+        }
+
+        if (fDepth == 0.0f)
+        {
+            return true;
+        }
+        pos[0] += push[0] * (fDepth + F_COLLISION_SKIN);
+        pos[1] += push[1] * (fDepth + F_COLLISION_SKIN);
+    }
+    return !this->overlapsWalls(pos, radius);
+}
+
+bool CollisionMap::overlaps(const float pos[2], float radius) const
+{
+    SharedChunkLock lock(this->chunkLock);
+    return this->overlapsWalls(pos, radius);
+}
+
+bool CollisionMap::overlapsWalls(const float pos[2], float radius) const
+{
+    for (int y = getSquare(pos[1] - radius); y <= getSquare(pos[1] + radius); y++)
+    {
+        for (int x = getSquare(pos[0] - radius); x <= getSquare(pos[0] + radius); x++)
+        {
+            if (!this->isWallSquare(x, y))
+            {
+                continue;
+            }
+            float boxMin[2], boxMax[2];
+            getSquareBox(x, y, boxMin, boxMax);
+            float dx = pos[0] - std::min(std::max(pos[0], boxMin[0]), boxMax[0]);
+            float dy = pos[1] - std::min(std::max(pos[1], boxMin[1]), boxMax[1]);
+            if (dx * dx + dy * dy < radius * radius)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void CollisionMap::move(CollisionMove& mover) const
+{
+    SharedChunkLock lock(this->chunkLock);
+    this->moveUnlocked(mover);
+}
+
+void CollisionMap::moveUnlocked(CollisionMove& mover) const
+{
+    // A mover that starts in a wall (spawned there, or the map changed) is put next to it first
+    float start[2] = { mover.fPos[0], mover.fPos[1] };
+    bool outside = this->pushOut(mover.fPos, mover.fRadius);
+    mover.bHit = !outside || mover.fPos[0] != start[0] || mover.fPos[1] != start[1];
+    if (!outside)
+    {
+        return;
+    }
+
+    for (int i = 0; i < N_MAX_SLIDES; i++)
+    {
+        if (mover.fDelta[0] == 0.0f && mover.fDelta[1] == 0.0f)
+        {
+            return;
+        }
+
+        float normal[2];
+        float t = this->findFirstContact(mover.fPos, mover.fDelta, mover.fRadius, normal);
+        if (t > 1.0f)
+        {
+            mover.fPos[0] += mover.fDelta[0];
+            mover.fPos[1] += mover.fDelta[1];
+            mover.fDelta[0] = 0.0f;
+            mover.fDelta[1] = 0.0f;
+            return;
+        }
+
+        // Stop at the wall, then slide: what is left of the move loses its part into the wall
+        mover.bHit = true;
+        mover.fPos[0] += mover.fDelta[0] * t + normal[0] * F_COLLISION_SKIN;
+        mover.fPos[1] += mover.fDelta[1] * t + normal[1] * F_COLLISION_SKIN;
+        float rest[2] = { mover.fDelta[0] * (1.0f - t), mover.fDelta[1] * (1.0f - t) };
+        float into = rest[0] * normal[0] + rest[1] * normal[1];
+        if (into < 0.0f)
+        {
+            rest[0] -= normal[0] * into;
+            rest[1] -= normal[1] * into;
+        }
+        mover.fDelta[0] = rest[0];
+        mover.fDelta[1] = rest[1];
+    }
+}
+
+void CollisionMap::moveAll(CollisionMove* movers, int count, ThreadPool* pool) const
+{
+    // Movers only read the map, so they can be moved in any order on any thread
+    int jobCount = (count + N_MOVERS_PER_JOB - 1) / N_MOVERS_PER_JOB;
+    auto job = [&](int index)
+    {
+        int end = std::min(count, (index + 1) * N_MOVERS_PER_JOB);
+        SharedChunkLock lock(this->chunkLock);
+        for (int i = index * N_MOVERS_PER_JOB; i < end; i++)
+        {
+            this->moveUnlocked(movers[i]);
+        }
+    };
+
+    if (pool == nullptr)
+    {
+        for (int i = 0; i < jobCount; i++)
+        {
+            job(i);
+        }
+        return;
+    }
+    pool->run(jobCount, job);
+}
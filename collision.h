@@ -0,0 +1,95 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include "objects.h"
+#include "streamer.h"
+#include "threadpool.h"
+
+/*
+    Collision of moving circles against the map walls.
+    Walls fill whole map squares and the full height of the map, so movers are circles in the
+    map plane and z is ignored. A move is swept: the circle's path is tested against the wall
+    squares whose boxes, grown by the radius with rounded corners, it can reach, and it stops at
+    the first one it touches. The rest of the move then slides along that wall; this repeats a
+    few times, so a mover pushed into a corner stops there. Only the squares around the path are
+    read, so a move costs the same on any map size and thousands of movers can be resolved per tick.
+    The map cells are read in place, so moves may run on any thread. A map whose cells are only
+    in its file is read through the resident chunks of the streamer instead (see streamer.h),
+    under the chunk table's lock; squares of chunks that are not resident are solid then, so
+    movers stop at the edge of what is loaded. Squares outside the map are solid.
+*/
+
+const float F_COLLISION_SKIN = 1e-3f;   // Movers stop this far from walls, so rounding never puts them inside
+
+struct CollisionMove
+{
+    float fPos[2];      // Center in world coordinates, moved to where the mover stops
+    float fDelta[2];    // Movement wanted, what is left of it after sliding on return
+    float fRadius;
+    bool bHit;          // Set if a wall stopped or deflected the movement
+};
+
+class CollisionMap
+{
+private:
+    int nWidth;
+    int nHeight;
+    const unsigned char* cells;     // Map cells, not owned
+
+    // Streamed cells: chunk (x >> shift, y >> shift) has 2^shift x 2^shift cells or is nullptr
+    const unsigned char* const* chunks;
+    int nChunkShift;
+    int nChunksX;
+    ChunkTableLock* chunkLock;
+
+    bool isWallSquare(int x, int y) const
+    {
+        if (x < 0 || x >= this->nWidth || y < 0 || y >= this->nHeight)
+        {
+            return true;
+        }
+        if (this->chunks != nullptr)
+        {
+            const unsigned char* chunk = this->chunks[(y >> this->nChunkShift) * this->nChunksX + (x >> this->nChunkShift)];
+            int mask = (1 << this->nChunkShift) - 1;
+            return chunk == nullptr || chunk[((y & mask) << this->nChunkShift) + (x & mask)] == '#';
+        }
+        return this->cells[(long long)y * this->nWidth + x] == '#';
+    }
+
+    bool overlapsWalls(const float pos[2], float radius) const;
+
+    void moveUnlocked(CollisionMove& mover) const;
+
+    // Earliest fraction of the move at which the circle touches a wall, 2 if it doesn't.
+    //     Writes the wall's normal at the contact
+    float findFirstContact(const float pos[2], const float delta[2], float radius, float normal[2]) const;
+
+    // Pushes a circle that overlaps walls out of them, returns false if it is still inside one
+    bool pushOut(float pos[2], float radius) const;
+
+public:
+    CollisionMap();
+
+    CollisionMap(int width, int height, const unsigned char* mapCells);
+
+    // Reads cells from a streamer's chunk table instead of the map cells, nullptr to go back to them
+    void setChunks(const unsigned char* const* table, int chunkShift, int chunksX, ChunkTableLock* tableLock);
+
+    bool isWall(int x, int y) const
+    {
+        SharedChunkLock lock(this->chunkLock);
+        return this->isWallSquare(x, y);
+    }
+
+    // True if a circle at pos overlaps a wall square
+    bool overlaps(const float pos[2], float radius) const;
+
+    // Moves the circle by its delta, sliding along the walls it runs into
+    void move(CollisionMove& mover) const;
+
+    // Moves every mover of the list; on the pool's threads if pool isn't nullptr. Movers don't collide with each other
+    void moveAll(CollisionMove* movers, int count, ThreadPool* pool) const;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include "objects.h"
+
+/*
+    Plain character/color framebuffer the renderer draws into.
+    Cells are stored row by row: index = y * nWidth + x.
+    The renderer also keeps the world distance of what each cell shows, so sprites drawn
+    after the walls are hidden behind nearer walls.
+*/
+
+struct Framebuffer
+{
+    int nWidth;
+    int nHeight;
+    std::vector<Glyph> chars;
+    std::vector<Color> colors;
+    std::vector<float> depths;      // Infinity where nothing was drawn
+
+    Framebuffer(int width, int height)
+        : nWidth(width), nHeight(height), chars(width * height, ' '), colors(width * height, 0),
+          depths(width * height, std::numeric_limits<float>::infinity()) {}
+
+    int size() const { return this->nWidth * this->nHeight; }
+
+    void set(int x, int y, Glyph ch, Color color)
+    {
+        this->chars[y * this->nWidth + x] = ch;
+        this->colors[y * this->nWidth + x] = color;
+    }
+
+    void set(int x, int y, Glyph ch, Color color, float depth)
+    {
+        this->set(x, y, ch, color);
+        this->depths[y * this->nWidth + x] = depth;
+    }
+
+    void clear()
+    {
+        std::fill(this->chars.begin(), this->chars.end(), ' ');
+        std::fill(this->colors.begin(), this->colors.end(), 0);
+        std::fill(this->depths.begin(), this->depths.end(), std::numeric_limits<float>::infinity());
+    }
+};
+
+#endif
@@ -3,79 +3,137 @@
 
 #include <vector>
 #include <math.h>
+#include <utility>
+#include "vecmath.h"
 
 /*
     Representation of a line in 3d space using parameter t:
         (x0, y0, z0) + a * t
+
+    Vector3D, Line and Plane are thin inline wrappers over vecmath.h.
 */
 
 class Vector3D 
 {
 private:
-    float fX;
-    float fY;
-    float fZ;
-    float fLength;
+    vecmath::Vec3 v;
+    mutable float fLength;  // Computed on first use, negative until then
+
 public:
-    Vector3D();
+    Vector3D(): fLength(0.0f) {}
+
+    Vector3D(float x, float y, float z): v(x, y, z), fLength(-1.0f) {}
+
+    Vector3D(vecmath::Vec3 vec): v(vec), fLength(-1.0f) {}
+
+    const vecmath::Vec3& vec() const { return this->v; }
 
-    Vector3D(float x, float y, float z);
+    void normalize()
+    {
+        float length = this->getLength();
+        if (length != 0)
+        {
+            this->v = this->v / length;
+            this->fLength = 1.0;
+        }
+    }
 
-    void normalize();
+    float getLength() const
+    {
+        if (this->fLength < 0.0f)
+        {
+            this->fLength = vecmath::length(this->v);
+        }
+        return this->fLength;
+    }
 
-    float getLength() const;
+    float dotProduct(const Vector3D& v3fVector) const { return vecmath::dot(this->v, v3fVector.v); }
 
-    float dotProduct(const Vector3D& v3fVector);
+    Vector3D operator+(const Vector3D& v3fVector) const { return Vector3D(this->v + v3fVector.v); }
 
-    Vector3D operator+(const Vector3D& v3fVector);
+    Vector3D operator-(const Vector3D& v3fVector) const { return Vector3D(this->v - v3fVector.v); }
 
-    Vector3D operator-(const Vector3D& v3fVector);
-    Vector3D operator*(const float& fScalar);
+    Vector3D operator*(const float& fScalar) const { return Vector3D(this->v * fScalar); }
 
-    Vector3D operator/(const float& fScalar);
+    Vector3D operator/(const float& fScalar) const { return Vector3D(this->v / fScalar); }
 
-    float& operator[](int index);
+    float operator[](int index) const { return this->v[index]; }
 
-    bool operator==(const Vector3D& v3fVector);
+    // Writing through the reference invalidates the cached length
+    float& operator[](int index)
+    {
+        this->fLength = -1.0f;
+        return this->v[index];
+    }
+
+    bool operator==(const Vector3D& v3fVector) const { return this->v == v3fVector.v; }
 };
 
 class Line
 {
 private:
-    Vector3D v3Point;
-    Vector3D v3Direction;
+    vecmath::Ray ray;
 
 public:
-    Line();
+    Line() {}
+
+    Line(Vector3D point, Vector3D direction)
+    {
+        direction.normalize();
+        this->ray = vecmath::Ray(point.vec(), direction.vec());
+    }
 
-    Line(Vector3D point, Vector3D direction);
+    const vecmath::Ray& getRay() const { return this->ray; }
 
-    Vector3D getOwnPoint() const;
+    Vector3D getOwnPoint() const { return Vector3D(this->ray.origin); }
 
-    Vector3D getDirection() const;
+    Vector3D getDirection() const { return Vector3D(this->ray.direction); }
 
     // Returns point for given parameter t
-    Vector3D getPoint(float t);
+    Vector3D getPoint(float t = 0) const { return Vector3D(this->ray.at(t)); }
 
     // Returns parameter t for given Point, returns 0 if doesn't lie on the line
-    float getParameter(Vector3D point);
+    float getParameter(Vector3D point) const
+    {
+        Vector3D v3fDifference = point - this->getOwnPoint();
+        float fDotProduct = v3fDifference.dotProduct(this->getDirection());
+
+        if (fDotProduct == 0)
+        {
+            return 0;
+        }
+        else
+        {
+            return fabsf(fDotProduct / this->getDirection().dotProduct(v3fDifference));
+        }
+    }
 };
 
 // ax + by + cz + d = 0
 class Plane
 {
 private:
-    float a, b, c, d;
-    Vector3D normal;
+    vecmath::Plane plane;
+
 public:
-    Plane();
+    Plane() {}
 
-    Plane(Vector3D point, Vector3D normal);
+    Plane(Vector3D point, Vector3D normal): plane(vecmath::Plane::fromPointNormal(point.vec(), normal.vec())) {}
 
-    // Returns point of intersection and parameter t. If doesn't intersect returns 0,0,0 0
-    std::pair<Vector3D, float> getLineIntersection(Line line) const;
+    const vecmath::Plane& getEquation() const { return this->plane; }
 
+    // Returns point of intersection and parameter t. If doesn't intersect returns 0,0,0 0
+    std::pair<Vector3D, float> getLineIntersection(const Line& line) const
+    {
+        float parameter;
+        if (!this->plane.intersect(line.getRay(), parameter))
+        {
+            // Line lies on plane or is parallel to plane
+            return { Vector3D(0, 0, 0), 0 };
+        }
+        return { line.getPoint(parameter), parameter };
+    }
 };
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <climits>
+#include <limits>
+#include <math.h>
+#include "grid.h"
+#include "boxkernel.h"
+
+
+MapGrid::MapGrid()
+{
+    this->nWidth = 0;
+    this->nHeight = 0;
+    this->nLayers = 0;
+    this->fCellSize = N_MAP_WORLD_RATIO;
+    this->fOriginX = 0;
+    this->fOriginY = 0;
+    this->fOriginZ = 0;
+    this->cells = nullptr;
+    this->wallColor = 0;
+    this->chunks = nullptr;
+    this->nChunkShift = 0;
+    this->nChunksX = 0;
+}
+
+MapGrid::MapGrid(int width, int height, const unsigned char* mapCells, Color color)
+{
+    this->nWidth = width;
+    this->nHeight = height;
+    this->nLayers = 1;
+    this->fCellSize = N_MAP_WORLD_RATIO;
+    this->fOriginX = -N_MAP_WORLD_RATIO / 2.0f;
+    this->fOriginY = -N_MAP_WORLD_RATIO / 2.0f;
+    this->fOriginZ = 0;
+    this->cells = mapCells;
+    this->wallColor = color;
+    this->chunks = nullptr;
+    this->nChunkShift = 0;
+    this->nChunksX = 0;
+}
+
+void MapGrid::setChunks(const unsigned char* const* table, int chunkShift, int chunksX)
+{
+    this->chunks = table;
+    this->nChunkShift = chunkShift;
+    this->nChunksX = chunksX;
+}
+
+bool MapGrid::isWall(int x, int y) const
+{
+    if (x < 0 || x >= this->nWidth || y < 0 || y >= this->nHeight)
+    {
+        return false;
+    }
+    return this->getCellByte(x, y) == '#';
+}
+
+GameObject* MapGrid::getWallObject(int x, int y) const
+{
+    long long cell = (long long)y * this->nWidth + x;
+    auto it = std::lower_bound(this->wallCells.begin(), this->wallCells.end(), cell);
+    if (it == this->wallCells.end() || *it != cell)
+    {
+        return nullptr;
+    }
+    return this->wallObjects[it - this->wallCells.begin()];
+}
+
+void MapGrid::addWallObject(int x, int y, GameObject* obj)
+{
+    this->wallCells.push_back((long long)y * this->nWidth + x);
+    this->wallObjects.push_back(obj);
+}
+
+GameObject* MapGrid::getWallBox(int x, int y, float boxMin[3], float boxMax[3]) const
+{
+    // Merged walls are tested as their whole box, like the other render modes see them
+    GameObject* wall = this->wallObjects.empty() ? nullptr : this->getWallObject(x, y);
+    Vector3D minCorner, maxCorner;
+    if (wall != nullptr && wall->getBounds(minCorner, maxCorner))
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            boxMin[i] = minCorner[i];
+            boxMax[i] = maxCorner[i];
+        }
+        return wall;
+    }
+
+    // The box a wall Cube at this square would have, so hits are the same as its getIntersection
+    const float fHalfSize = 2.5f;   // Same as Cube::size
+    float centerX = (float)(x * N_MAP_WORLD_RATIO);
+    float centerY = (float)(y * N_MAP_WORLD_RATIO);
+    boxMin[0] = centerX - fHalfSize;
+    boxMin[1] = centerY - fHalfSize;
+    boxMin[2] = 2.5f - fHalfSize;
+    boxMax[0] = centerX + fHalfSize;
+    boxMax[1] = centerY + fHalfSize;
+    boxMax[2] = 2.5f + fHalfSize;
+    return wall;
+}
+
+// A ray that runs along a square boundary, parallel to it within the threshold Cube::getIntersection
+//     treats as parallel, touches the walls on both sides of it. Returns the step to the square on the
+//     other side, or 0 if the ray is not on a boundary
+static int getBoundarySide(float entry, float direction, float cellMin, float cellSize)
+{
+    const float fTolerance = 1e-4f;
+    if (fabsf(direction) >= 1e-6f)
+    {
+        return 0;
+    }
+    float offset = entry - cellMin;
+    if (offset < fTolerance)
+    {
+        return -1;
+    }
+    return cellSize - offset < fTolerance ? 1 : 0;
+}
+
+bool MapGrid::findFirstWall(Line ray, float tMax, int& x, int& y, float& tEntry) const
+{
+    if (this->cells == nullptr && this->chunks == nullptr)
+    {
+        return false;
+    }
+
+    Vector3D origin = ray.getOwnPoint();
+    Vector3D direction = ray.getDirection();
+
+    const float fInf = std::numeric_limits<float>::infinity();
+    int dims[2] = { this->nWidth, this->nHeight };
+    float gridMin[2] = { this->fOriginX, this->fOriginY };
+
+    // Clip the ray against the grid bounds in x and y
+    float tEnter = 0.0f;
+    float tExit = tMax;
+    for (int i = 0; i < 2; i++)
+    {
+        float gridMax = gridMin[i] + dims[i] * this->fCellSize;
+        if (direction[i] == 0.0f)
+        {
+            if (origin[i] < gridMin[i] || origin[i] > gridMax)
+            {
+                return false;
+            }
+            continue;
+        }
+
+        float t1 = (gridMin[i] - origin[i]) / direction[i];
+        float t2 = (gridMax - origin[i]) / direction[i];
+        tEnter = std::max(tEnter, std::min(t1, t2));
+        tExit = std::min(tExit, std::max(t1, t2));
+    }
+    if (tEnter > tExit)
+    {
+        return false;
+    }
+
+    int cell[2];
+    int side[2];
+    int step[2];
+    float tNext[2];
+    float tDelta[2];
+    for (int i = 0; i < 2; i++)
+    {
+        float entry = origin[i] + direction[i] * tEnter;
+        cell[i] = (int)floorf((entry - gridMin[i]) / this->fCellSize);
+        cell[i] = std::min(std::max(cell[i], 0), dims[i] - 1);
+        side[i] = i < 2 ? getBoundarySide(entry, direction[i], gridMin[i] + cell[i] * this->fCellSize, this->fCellSize) : 0;
+
+        if (direction[i] > 0)
+        {
+            step[i] = 1;
+            tNext[i] = (gridMin[i] + (cell[i] + 1) * this->fCellSize - origin[i]) / direction[i];
+            tDelta[i] = this->fCellSize / direction[i];
+        }
+        else if (direction[i] < 0)
+        {
+            step[i] = -1;
+            tNext[i] = (gridMin[i] + cell[i] * this->fCellSize - origin[i]) / direction[i];
+            tDelta[i] = -this->fCellSize / direction[i];
+        }
+        else
+        {
+            step[i] = 0;
+            tNext[i] = fInf;
+            tDelta[i] = fInf;
+        }
+    }
+
+    float t = tEnter;
+    while (t <= tExit)
+    {
+        // Along a boundary the squares on both sides of it are reached together
+        for (int dy = 0; dy <= (side[1] != 0 ? 1 : 0); dy++)
+        {
+            for (int dx = 0; dx <= (side[0] != 0 ? 1 : 0); dx++)
+            {
+                int cellX = cell[0] + dx * side[0];
+                int cellY = cell[1] + dy * side[1];
+                if (cellX >= 0 && cellX < dims[0] && cellY >= 0 && cellY < dims[1] && this->getCellByte(cellX, cellY) == '#')
+                {
+                    x = cellX;
+                    y = cellY;
+                    tEntry = t;
+                    return true;
+                }
+            }
+        }
+
+        int axis = tNext[1] < tNext[0] ? 1 : 0;
+        t = tNext[axis];
+        cell[axis] += step[axis];
+        if (cell[axis] < 0 || cell[axis] >= dims[axis])
+        {
+            break;
+        }
+        tNext[axis] += tDelta[axis];
+    }
+    return false;
+}
+
+bool MapGrid::findFirstHit(Line ray, float depth, std::pair<float, Glyph>& intersection, GameObject*& obj) const
+{
+    if (this->cells == nullptr && this->chunks == nullptr)
+    {
+        return false;
+    }
+
+    Vector3D origin = ray.getOwnPoint();
+    Vector3D direction = ray.getDirection();
+
+    const float fInf = std::numeric_limits<float>::infinity();
+    int dims[3] = { this->nWidth, this->nHeight, this->nLayers };
+    float gridMin[3] = { this->fOriginX, this->fOriginY, this->fOriginZ };
+
+    // Clip the ray against the grid bounds (slab test)
+    float tEnter = 0.0f;
+    float tExit = fInf;
+    for (int i = 0; i < 3; i++)
+    {
+        float gridMax = gridMin[i] + dims[i] * this->fCellSize;
+        if (direction[i] == 0.0f)
+        {
+            if (origin[i] < gridMin[i] || origin[i] > gridMax)
+            {
+                return false;
+            }
+            continue;
+        }
+
+        float t1 = (gridMin[i] - origin[i]) / direction[i];
+        float t2 = (gridMax - origin[i]) / direction[i];
+        tEnter = std::max(tEnter, std::min(t1, t2));
+        tExit = std::min(tExit, std::max(t1, t2));
+    }
+
+    // Objects report sqrt of the ray parameter as their distance
+    tExit = std::min(tExit, depth * depth);
+    if (tEnter > tExit)
+    {
+        return false;
+    }
+
+    // Walls are hit on their top and bottom faces too, which lie on the grid bounds. Walk a bit past
+    //     the exit, so a ray leaving the grid there still reaches the square whose face it hits
+    tExit += tExit * 1e-5f + 1e-4f;
+
+    BoxRay boxRay(ray);
+    const ShadeTiers tiers = Cube::getShadeTiers(depth);
+
+    // Set up the walk from the entry cell
+    int cell[3];
+    int side[3];
+    int step[3];
+    float tNext[3];
+    float tDelta[3];
+    for (int i = 0; i < 3; i++)
+    {
+        float entry = origin[i] + direction[i] * tEnter;
+        cell[i] = (int)floorf((entry - gridMin[i]) / this->fCellSize);
+        cell[i] = std::min(std::max(cell[i], 0), dims[i] - 1);
+        side[i] = i < 2 ? getBoundarySide(entry, direction[i], gridMin[i] + cell[i] * this->fCellSize, this->fCellSize) : 0;
+
+        if (direction[i] > 0)
+        {
+            step[i] = 1;
+            tNext[i] = (gridMin[i] + (cell[i] + 1) * this->fCellSize - origin[i]) / direction[i];
+            tDelta[i] = this->fCellSize / direction[i];
+        }
+        else if (direction[i] < 0)
+        {
+            step[i] = -1;
+            tNext[i] = (gridMin[i] + cell[i] * this->fCellSize - origin[i]) / direction[i];
+            tDelta[i] = -this->fCellSize / direction[i];
+        }
+        else
+        {
+            step[i] = 0;
+            tNext[i] = fInf;
+            tDelta[i] = fInf;
+        }
+    }
+
+    GameObject* missedWall = nullptr;
+    float t = tEnter;
+    while (t <= tExit)
+    {
+        // Along a boundary the squares on both sides of it are reached together, the nearest hit wins
+        bool bHit = false;
+        for (int dy = 0; dy <= (side[1] != 0 ? 1 : 0); dy++)
+        {
+            for (int dx = 0; dx <= (side[0] != 0 ? 1 : 0); dx++)
+            {
+                int cellX = cell[0] + dx * side[0];
+                int cellY = cell[1] + dy * side[1];
+                if (cellX < 0 || cellX >= dims[0] || cellY < 0 || cellY >= dims[1] || this->getCellByte(cellX, cellY) != '#')
+                {
+                    continue;
+                }
+
+                float boxMin[3], boxMax[3];
+                GameObject* wall = this->getWallBox(cellX, cellY, boxMin, boxMax);
+
+                float tHit;
+                if (wall == nullptr || wall != missedWall)
+                {
+                    intersectBox(boxMin, boxMax, boxRay, (float)INT_MAX, tHit);
+                    float distance = sqrtf(tHit);
+                    if (!(distance > 0 && distance < depth))
+                    {
+                        // Squares further along the same merged wall would miss it again
+                        missedWall = wall;
+                    }
+                    else if (!bHit || distance < intersection.first)
+                    {
+                        intersection = std::make_pair(distance, tiers.shade(tHit));
+                        obj = wall;
+                        bHit = true;
+                    }
+                }
+            }
+        }
+        if (bHit)
+        {
+            return true;
+        }
+
+        // Step into the neighbour across the nearest cell boundary
+        int axis = 0;
+        if (tNext[1] < tNext[axis]) { axis = 1; }
+        if (tNext[2] < tNext[axis]) { axis = 2; }
+
+        t = tNext[axis];
+        if (axis == 2 && (cell[2] + step[2] < 0 || cell[2] + step[2] >= dims[2]))
+        {
+            // Leaving through the top or bottom at a wall's edge can come out of rounding a bit before
+            //     the square is entered whose edge it is; walls are full height, so walk on in x and y
+            tNext[2] = fInf;
+            continue;
+        }
+        cell[axis] += step[axis];
+        if (cell[axis] < 0 || cell[axis] >= dims[axis])
+        {
+            break;
+        }
+        tNext[axis] += tDelta[axis];
+    }
+
+    return false;
+}
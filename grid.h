@@ -0,0 +1,97 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <vector>
+#include "geometry.h"
+#include "objects.h"
+
+/*
+    Uniform grid over the map: map square (x, y) is the world box
+        [x * N_MAP_WORLD_RATIO - N_MAP_WORLD_RATIO / 2, (x + 1) * N_MAP_WORLD_RATIO - N_MAP_WORLD_RATIO / 2]
+    and so on for y. The grid is one map square high (z from 0 to N_MAP_WORLD_RATIO).
+    Walls are read from the map cells ('#') in place and intersected as boxes of the size of a
+    wall Cube, so the grid needs no memory per square. Wall objects, if the world built them,
+    are looked up for the wall squares the ray reaches and tested as their whole bounds, so a
+    merged wall box is hit the same as in the other render modes; they are kept sorted by square.
+    Objects that are not bound to a map square (floor, ceiling) are kept aside and tested for every ray.
+    With a chunk table set (see streamer.h) cells are read from the resident chunks instead, and
+    squares of chunks that are not resident are empty.
+*/
+
+class MapGrid
+{
+private:
+    int nWidth;
+    int nHeight;
+    int nLayers;
+    float fCellSize;
+    float fOriginX, fOriginY, fOriginZ;    // Min corner of cell (0, 0, 0)
+
+    const unsigned char* cells;            // Map cells, not owned
+    Color wallColor;
+
+    // Streamed cells: chunk (x >> shift, y >> shift) has 2^shift x 2^shift cells or is nullptr
+    const unsigned char* const* chunks;
+    int nChunkShift;
+    int nChunksX;
+
+    unsigned char getCellByte(int x, int y) const
+    {
+        if (this->chunks == nullptr)
+        {
+            return this->cells[(long long)y * this->nWidth + x];
+        }
+        const unsigned char* chunk = this->chunks[(y >> this->nChunkShift) * this->nChunksX + (x >> this->nChunkShift)];
+        if (chunk == nullptr)
+        {
+            return '.';
+        }
+        int mask = (1 << this->nChunkShift) - 1;
+        return chunk[((y & mask) << this->nChunkShift) + (x & mask)];
+    }
+
+    std::vector<long long> wallCells;      // Squares of wall objects, y * width + x, ascending
+    std::vector<GameObject*> wallObjects;
+    std::vector<GameObject*> looseObjects; // Objects not bound to a cell
+
+public:
+    MapGrid();
+
+    MapGrid(int width, int height, const unsigned char* mapCells, Color color);
+
+    int getWidth() const { return this->nWidth; }
+
+    int getHeight() const { return this->nHeight; }
+
+    Color getWallColor() const { return this->wallColor; }
+
+    bool isWall(int x, int y) const;
+
+    // Reads cells from a chunk table instead of the map cells, nullptr to go back to them
+    void setChunks(const unsigned char* const* table, int chunkShift, int chunksX);
+
+    // Object built for the wall at square (x, y), nullptr if there is none
+    GameObject* getWallObject(int x, int y) const;
+
+    // Squares must be added in row-major order
+    void addWallObject(int x, int y, GameObject* obj);
+
+    void addLooseObject(GameObject* obj) { this->looseObjects.push_back(obj); }
+
+    const std::vector<GameObject*>& getLooseObjects() const { return this->looseObjects; }
+
+    // Bounds a ray is tested against at wall square (x, y): its wall object's if it has one, otherwise
+    //     those of a wall Cube at the square. Returns the wall object or nullptr
+    GameObject* getWallBox(int x, int y, float boxMin[3], float boxMax[3]) const;
+
+    // Walks the squares the ray passes over (2D DDA, z is ignored) and finds the first wall square
+    //     entered before ray parameter tMax. Writes the square and the ray parameter it is entered at
+    bool findFirstWall(Line ray, float tMax, int& x, int& y, float& tEntry) const;
+
+    // Walks cells pierced by the ray (3D DDA) and finds the first wall hit closer than depth,
+    //     returns false if there is none. obj is the wall's object or nullptr if it has none.
+    //     Loose objects are not tested.
+    bool findFirstHit(Line ray, float depth, std::pair<float, Glyph>& intersection, GameObject*& obj) const;
+};
+
+#endif
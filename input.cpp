@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "input.h"
+
+#ifndef _WIN32
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+static const char INPUT_FILE_MAGIC[8] = { 'F', 'P', 'S', 'I', 'N', 'P', 'T', '1' };
+
+
+static void appendVarint(std::vector<unsigned char>& bytes, unsigned long long value)
+{
+    while (value >= 0x80)
+    {
+        bytes.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back((unsigned char)value);
+}
+
+// Returns false if the varint runs past end
+static bool readVarint(const unsigned char*& data, const unsigned char* end, unsigned long long& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && data < end; shift += 7)
+    {
+        unsigned char byte = *data++;
+        value |= (unsigned long long)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+TerminalInput::TerminalInput(int fd)
+{
+    this->fd = fd;
+    for (int i = 0; i < ACTION_COUNT; i++)
+    {
+        this->nLastPress[i] = -N_TERMINAL_HOLD_TICKS - 1;
+    }
+}
+
+TerminalInput::~TerminalInput()
+{
+    this->end();
+}
+
+void TerminalInput::begin()
+{
+#ifndef _WIN32
+    termios* saved = new termios;
+    if (tcgetattr(this->fd, saved) == 0)
+    {
+        // No line buffering and no echo, reads return at once
+        termios raw = *saved;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 0;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(this->fd, TCSANOW, &raw);
+        this->savedMode = saved;
+    }
+    else
+    {
+        // Not a terminal, e.g. a pipe; it is read as it is
+        delete saved;
+    }
+#endif
+}
+
+void TerminalInput::end()
+{
+#ifndef _WIN32
+    if (this->savedMode != nullptr)
+    {
+        termios* saved = (termios*)this->savedMode;
+        tcsetattr(this->fd, TCSANOW, saved);
+        delete saved;
+        this->savedMode = nullptr;
+    }
+#endif
+}
+
+InputMask TerminalInput::poll(long long tick)
+{
+#ifndef _WIN32
+    const int nReadSize = 64;
+    char bytes[nReadSize + 2];
+    int total = this->nCarried;
+    memcpy(bytes, this->carried, total);
+    // The file stays blocking, it is shared with stdout on a terminal. Only read what is there
+    pollfd ready = { this->fd, POLLIN, 0 };
+    long count;
+    while (::poll(&ready, 1, 0) > 0 && (ready.revents & POLLIN) && (count = (long)read(this->fd, bytes + total, nReadSize)) > 0)
+    {
+        total += (int)count;
+        int i = 0;
+        for (; i < total; i++)
+        {
+            // Arrow keys come as Esc [ A..D. Esc [ at the end of the read is finished by the next one,
+            //     any other Esc is a key of its own that does nothing
+            if (bytes[i] == 0x1b)
+            {
+                if (i + 2 == total && bytes[i + 1] == '[')
+                {
+                    break;
+                }
+                if (i + 2 < total && bytes[i + 1] == '[')
+                {
+                    switch (bytes[i + 2])
+                    {
+                        case 'A': this->press(ACTION_FORWARD, tick); break;
+                        case 'B': this->press(ACTION_BACK, tick); break;
+                        case 'C': this->press(ACTION_TURN_RIGHT, tick); break;
+                        case 'D': this->press(ACTION_TURN_LEFT, tick); break;
+                    }
+                    i += 2;
+                }
+                continue;
+            }
+
+            switch (tolower((unsigned char)bytes[i]))
+            {
+                case 'w': this->press(ACTION_FORWARD, tick); break;
+                case 's': this->press(ACTION_BACK, tick); break;
+                case 'a': this->press(ACTION_TURN_LEFT, tick); break;
+                case 'd': this->press(ACTION_TURN_RIGHT, tick); break;
+                case 'u': this->press(ACTION_UP, tick); break;
+                case 'j': this->press(ACTION_DOWN, tick); break;
+                case ' ': this->press(ACTION_FIRE, tick); break;
+                case 'p': this->press(ACTION_PROFILER, tick); break;
+                case 'r': this->press(ACTION_REPROJECTION, tick); break;
+                case 'q': this->press(ACTION_QUIT, tick); break;
+            }
+        }
+        total -= i;
+        memmove(bytes, bytes + i, total);
+    }
+    this->nCarried = total;
+    memcpy(this->carried, bytes, total);
+#endif
+
+    InputMask held = 0;
+    for (int i = 0; i < ACTION_COUNT; i++)
+    {
+        if (tick - this->nLastPress[i] < N_TERMINAL_HOLD_TICKS)
+        {
+            held |= 1u << i;
+        }
+    }
+    return held;
+}
+
+void InputRecording::add(long long tick, InputMask held)
+{
+    InputMask current = this->events.empty() ? 0 : this->events.back().held;
+    if (held != current)
+    {
+        this->events.push_back({ tick, held });
+    }
+    this->nTickCount = tick + 1;
+}
+
+bool InputRecording::save(const std::string& path) const
+{
+    std::vector<unsigned char> bytes(INPUT_FILE_MAGIC, INPUT_FILE_MAGIC + 8);
+    unsigned char tickBytes[4];
+    memcpy(tickBytes, &this->fTickSeconds, 4);
+    bytes.insert(bytes.end(), tickBytes, tickBytes + 4);
+
+    appendVarint(bytes, (unsigned long long)this->nTickCount);
+    appendVarint(bytes, this->events.size());
+    long long lastTick = 0;
+    for (const InputEvent& event: this->events)
+    {
+        appendVarint(bytes, (unsigned long long)(event.nTick - lastTick));
+        appendVarint(bytes, event.held);
+        lastTick = event.nTick;
+    }
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return fclose(file) == 0 && ok;
+}
+
+bool InputRecording::load(const std::string& path)
+{
+    this->events.clear();
+    this->nTickCount = 0;
+
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    std::vector<unsigned char> bytes;
+    unsigned char chunk[4096];
+    size_t count;
+    while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        bytes.insert(bytes.end(), chunk, chunk + count);
+    }
+    fclose(file);
+
+    if (bytes.size() < 12 || memcmp(bytes.data(), INPUT_FILE_MAGIC, 8) != 0)
+    {
+        return false;
+    }
+    float tickSeconds;
+    memcpy(&tickSeconds, bytes.data() + 8, 4);
+
+    const unsigned char* data = bytes.data() + 12;
+    const unsigned char* end = bytes.data() + bytes.size();
+    unsigned long long tickCount, eventCount;
+    if (!(tickSeconds > 0.0f) || !readVarint(data, end, tickCount) || !readVarint(data, end, eventCount) ||
+        eventCount > (unsigned long long)(end - data))
+    {
+        return false;
+    }
+
+    std::vector<InputEvent> loaded;
+    loaded.reserve((size_t)eventCount);
+    unsigned long long tick = 0;
+    for (unsigned long long i = 0; i < eventCount; i++)
+    {
+        unsigned long long delta, held;
+        if (!readVarint(data, end, delta) || !readVarint(data, end, held))
+        {
+            return false;
+        }
+        tick += delta;
+        loaded.push_back({ (long long)tick, (InputMask)held });
+    }
+    if (data != end || (eventCount > 0 && tick >= tickCount))
+    {
+        return false;
+    }
+
+    this->fTickSeconds = tickSeconds;
+    this->nTickCount = (long long)tickCount;
+    this->events.swap(loaded);
+    return true;
+}
+
+InputMask InputPlayback::poll(long long tick)
+{
+    if (this->isFinished(tick))
+    {
+        return 1u << ACTION_QUIT;
+    }
+
+    const std::vector<InputEvent>& events = this->recording.getEvents();
+    while (this->nNextEvent < events.size() && events[this->nNextEvent].nTick <= tick)
+    {
+        this->held = events[this->nNextEvent].held;
+        this->nNextEvent++;
+    }
+    return this->held;
+}
+
+void applyPlayerInput(Player& player, InputMask held, float dt, const CollisionMap& collisionMap, float radius)
+{
+    if (isActionHeld(held, ACTION_TURN_LEFT))
+    {
+        player.rotateAngle(-1, dt);
+    }
+    if (isActionHeld(held, ACTION_TURN_RIGHT))
+    {
+        player.rotateAngle(1, dt);
+    }
+
+    // Forward and back cancel out
+    int walk = isActionHeld(held, ACTION_FORWARD) - isActionHeld(held, ACTION_BACK);
+    if (walk != 0)
+    {
+        Vector3D pos = player.getCenterPos();
+        float distance = player.getSpeed() * dt * walk;
+        CollisionMove mover = { { pos[0], pos[1] }, { cosf(player.getAngle()) * distance, sinf(player.getAngle()) * distance }, radius, false };
+        collisionMap.move(mover);
+        player.setCenterPos(Vector3D(mover.fPos[0], mover.fPos[1], pos[2]));
+    }
+
+    if (isActionHeld(held, ACTION_UP))
+    {
+        player.move(Vector3D(0, 0, 1), dt);
+    }
+    if (isActionHeld(held, ACTION_DOWN))
+    {
+        player.move(Vector3D(0, 0, -1), dt);
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <string>
+#include <vector>
+#include "objects.h"
+#include "collision.h"
+
+/*
+    Player input as a set of held actions per simulation tick.
+    The game reads its actions from an InputSource once per tick: the Win32 console keys,
+    a terminal (TerminalInput) or a recording (InputPlayback). What was held is recorded as
+    events at the tick the set changed, so a session is a few bytes per key press. Ticks have
+    a fixed length and applyPlayerInput only depends on the held actions and the tick length,
+    so playing a recording back moves the player exactly as in the recorded session, on any
+    machine and at any frame rate.
+
+    Recording file: "FPSINPT1", the tick length as a 32 bit float, then LEB128 varints: the
+    number of ticks, the number of events and per event its tick (as the distance from the
+    previous event's tick) and the held actions.
+*/
+
+enum InputAction
+{
+    ACTION_TURN_LEFT,
+    ACTION_TURN_RIGHT,
+    ACTION_FORWARD,
+    ACTION_BACK,
+    ACTION_UP,
+    ACTION_DOWN,
+    ACTION_FIRE,
+    ACTION_PROFILER,
+    ACTION_REPROJECTION,
+    ACTION_QUIT,
+    ACTION_COUNT
+};
+
+typedef unsigned int InputMask;     // Bit 1 << action is set while the action is held
+
+inline bool isActionHeld(InputMask held, InputAction action) { return (held >> action) & 1; }
+
+class InputSource
+{
+public:
+    virtual ~InputSource() {}
+
+    // Actions held during the tick, called once per tick with increasing ticks
+    virtual InputMask poll(long long tick) = 0;
+};
+
+// Keys read from stdin of an ANSI/VT terminal. Terminals only report key presses, so a key counts as
+//     held for N_TERMINAL_HOLD_TICKS after its last press or autorepeat. Reads nothing on Windows
+class TerminalInput: public InputSource
+{
+private:
+    static const int N_TERMINAL_HOLD_TICKS = 12;
+
+    int fd;
+    long long nLastPress[ACTION_COUNT];
+    void* savedMode = nullptr;  // termios of the terminal before begin(), restored by end()
+    char carried[2];            // Esc [ if the last read ended in it
+    int nCarried = 0;
+
+    void press(InputAction action, long long tick) { this->nLastPress[action] = tick; }
+
+public:
+    // fd is usually 0 (stdin)
+    explicit TerminalInput(int fd = 0);
+
+    ~TerminalInput();
+
+    // Puts the terminal into raw mode, without line buffering and echo
+    void begin();
+
+    // Restores the terminal mode
+    void end();
+
+    // W/A/S/D or arrow keys walk and turn, U/J fly, Space fires, P/R toggle, Q quits
+    InputMask poll(long long tick);
+};
+
+struct InputEvent
+{
+    long long nTick;
+    InputMask held;     // From nTick until the next event
+};
+
+class InputRecording
+{
+private:
+    float fTickSeconds;
+    long long nTickCount = 0;
+    std::vector<InputEvent> events;
+
+public:
+    explicit InputRecording(float tickSeconds = 1.0f / 60.0f): fTickSeconds(tickSeconds) {}
+
+    float getTickSeconds() const { return this->fTickSeconds; }
+
+    // Ticks recorded, playback ends after them
+    long long getTickCount() const { return this->nTickCount; }
+
+    const std::vector<InputEvent>& getEvents() const { return this->events; }
+
+    // Records the actions held in tick, ticks have to come in order
+    void add(long long tick, InputMask held);
+
+    bool save(const std::string& path) const;
+
+    // Replaces the recording with the one in the file, returns false and leaves it empty if it can't be read
+    bool load(const std::string& path);
+};
+
+class InputPlayback: public InputSource
+{
+private:
+    const InputRecording& recording;
+    size_t nNextEvent = 0;
+    InputMask held = 0;
+
+public:
+    explicit InputPlayback(const InputRecording& inputRecording): recording(inputRecording) {}
+
+    // Nothing is held after the recording ends but ACTION_QUIT
+    InputMask poll(long long tick);
+
+    bool isFinished(long long tick) const { return tick >= this->recording.getTickCount(); }
+};
+
+// Moves the player one tick of dt seconds: turns, walks along the floor sliding along the walls it
+//     runs into as a circle of radius, and flies up and down
+void applyPlayerInput(Player& player, InputMask held, float dt, const CollisionMap& collisionMap, float radius);
+
+#endif
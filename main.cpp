@@ -1,240 +1,54 @@
 #include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 #include <string>
 #include <vector>
 #include <math.h>
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <fstream>
 #include "geometry.h"
-
-
-// 1 map square is MAP_WORLD_RATION worlds' "squares"
-const int N_MAP_WORLD_RATIO = 5;
-const int N_SCREEN_WORLD_RATIO = 10;
+#include "objects.h"
+#include "world.h"
+#include "framebuffer.h"
+#include "renderer.h"
+#include "threadpool.h"
+#include "profiler.h"
+#include "simulation.h"
+#include "allocations.h"
+#include "raycast.h"
+#include "input.h"
+#include "terminal.h"
 
 
 // Dev
 std::ofstream logFile("log.txt");
 
-class GameObject 
+#ifdef _WIN32
+// Keys held on the Windows console
+class ConsoleInput: public InputSource
 {
-protected:
-    Vector3D v3CenterWorldPos;           // Center of the object 
-    std::vector<float> fMapPos;          // Position in map coordinates
-    WORD wChar;
-    WORD wPixelColor;
-    float fSpeed;
-
 public:
-    GameObject()
-    {
-        v3CenterWorldPos = Vector3D();
-        fMapPos = {-1, -1};
-        wChar = ' ';
-        wPixelColor = 0; // BLACK;
-        this->fSpeed = 0;
-    }
-
-    GameObject(Vector3D centerPos, WORD objectChar, WORD color, float speed)
+    InputMask poll(long long tick)
     {
-        v3CenterWorldPos = centerPos;
-        fMapPos = {centerPos[0] / N_MAP_WORLD_RATIO, centerPos[1] / N_MAP_WORLD_RATIO};
-        wChar = objectChar;
-        wPixelColor = color;
-        this->fSpeed = speed;
-    }
-
-    Vector3D getCenterPos() const { return this->v3CenterWorldPos; }
-
-    WORD getChar() const { return this->wChar; }
-
-    WORD getPixelColor() const { return this->wPixelColor; }
-
-    void move(Vector3D direction, float dt)
-    {
-        direction.normalize();
-
-        this->v3CenterWorldPos = this->v3CenterWorldPos + direction * this->fSpeed * dt;
-        fMapPos = {this->v3CenterWorldPos[0] / N_MAP_WORLD_RATIO, this->v3CenterWorldPos[1] / N_MAP_WORLD_RATIO};
-    }
-
-
-    // Returns distance to the closest point that belongs to object and lies on the line, 
-    //     returns -1 if there is not points on the line
-    virtual std::pair<float, WORD> getIntersection(Line line, float depth) = 0;
-
-    virtual WORD getCharByDistance(float depth, float distance) = 0;
-};
-
-class Cube: public GameObject
-{
-private:
-    float size;
-    std::vector<Plane*> planes;  // Planes define cube
-    float fMinX, fMaxX;
-    float fMinY, fMaxY;
-    float fMinZ, fMaxZ;
-
-public:
-    Cube(Vector3D centerPos, WORD objectChar, WORD color, float speed): GameObject(centerPos, objectChar, color, speed) 
-    {
-        this->size = 2.5f;
-
-        this->fMinX = centerPos[0] - size < centerPos[0] + size ? centerPos[0] - size : centerPos[0] + size;
-        this->fMaxX = centerPos[0] - size > centerPos[0] + size ? centerPos[0] - size : centerPos[0] + size;
-        this->fMinY = centerPos[1] - size < centerPos[1] + size ? centerPos[1] - size : centerPos[1] + size;
-        this->fMaxY = centerPos[1] - size > centerPos[1] + size ? centerPos[1] - size : centerPos[1] + size;
-        this->fMinZ = centerPos[2] - size < centerPos[2] + size ? centerPos[2] - size : centerPos[2] + size;
-        this->fMaxZ = centerPos[2] - size > centerPos[2] + size ? centerPos[2] - size : centerPos[2] + size;
-
-        planes.push_back(new Plane(Vector3D(centerPos[0] - size, centerPos[1], centerPos[2]), Vector3D(-1, 0, 0))); // Left
-        planes.push_back(new Plane(Vector3D(centerPos[0] + size, centerPos[1], centerPos[2]), Vector3D(1, 0, 0)));  // Right
-        planes.push_back(new Plane(Vector3D(centerPos[0], centerPos[1] - size, centerPos[2]), Vector3D(0, -1, 0))); // Bottom
-        planes.push_back(new Plane(Vector3D(centerPos[0], centerPos[1] + size, centerPos[2]), Vector3D(0, 1, 0)));  // Top
-        planes.push_back(new Plane(Vector3D(centerPos[0], centerPos[1], centerPos[2] - size), Vector3D(0, 0, -1))); // Front
-        planes.push_back(new Plane(Vector3D(centerPos[0], centerPos[1], centerPos[2] + size), Vector3D(0, 0, 1)));  // Back
-    };
-
-    WORD getCharByDistance(float depth, float distance)
-    {
-        if (distance <= depth / 2.0f)	    { return 0x2588; }	// Close	
-        else if (distance < depth / 1.75f)	{ return 0x2593; }
-        else if (distance < depth / 1.5f)	{ return 0x2592; }
-        else if (distance < depth)	{ return 0x2591; }
-        return ' ';
-    }
-
-    std::pair<float, WORD> getIntersection(Line line, float depth = 16.0f)
-    {
-        float result = INT_MAX;
-        WORD resChar = ' ';
-        for(const Plane* plane: this->planes)
+        // In the order of InputAction
+        const int keys[ACTION_COUNT] = { 'A', 'D', 'W', 'S', 'U', 'J', VK_SPACE, 'P', 'R', VK_ESCAPE };
+        InputMask held = 0;
+        for (int i = 0; i < ACTION_COUNT; i++)
         {
-            std::pair<Vector3D, float> localRes = plane->getLineIntersection(line);
-            Vector3D point = localRes.first;
-            float localDistance = localRes.second;
-
-            // Check bounds
-            if (point[0] < this->fMinX || point[0] > this->fMaxX)
+            if (GetAsyncKeyState(keys[i]) & 0x8000)
             {
-                continue;
-            }
-
-            if (point[1] < this->fMinY || point[1] > this->fMaxY)
-            {
-                continue;
-            }
-
-            if (point[2] < this->fMinZ || point[2] > this->fMaxZ)
-            {
-                continue;
-            }
-            
-            if (localDistance > 0 && localDistance < result)
-            {       
-                resChar = this->getCharByDistance(depth, localDistance);
-                result = localDistance;
+                held |= 1u << i;
             }
         }
-        return { sqrtf(result), resChar };
-    }
-    
-};
-
-class Floor: public GameObject
-{
-private:
-    Plane plane;
-
-public:
-    Floor(WORD color): GameObject(Vector3D(0, 0, 0), 'x', color, 0.0f) 
-    {
-        this->plane = Plane(Vector3D(0, 0, 0.0f), Vector3D(0, 0, 1.0f));
-    };
-
-    WORD getCharByDistance(float depth, float distance)
-    {
-        if (distance <= 4.0f)      { return '#'; }
-        else if (distance < 8.0f)  { return 'x'; }
-        else if (distance < 12.0f) { return '-'; }
-        else if (distance < 16.0f)  { return '.'; }
-        
-        return '.';
-    }
-
-    std::pair<float, WORD> getIntersection(Line line, float depth = 16.0f)
-    {
-        WORD resChar = ' ';
-        std::pair<Vector3D, float> localRes = this->plane.getLineIntersection(line);
-        resChar = this->getCharByDistance(16.0f, localRes.second);
-        return { sqrtf(localRes.second), resChar };
-    }
-};
-
-class Ceiling: public GameObject
-{
-private:
-    Plane plane;
-
-public:
-    Ceiling(WORD color): GameObject(Vector3D(0, 0, 0), 'x', color, 0.0f) 
-    {
-        this->plane = Plane(Vector3D(0, 0, 5.0f), Vector3D(0, 0, 1.0f));
-    };
-
-    WORD getCharByDistance(float depth, float distance)
-    {
-        if (distance <= 2.0f)      { return '#'; }
-        else if (distance < 4.0f)  { return 'x'; }
-        else if (distance < 6.0f) { return '-'; }
-        else if (distance < 8.0f)  { return '.'; }
-        
-        return '.';
-    }
-
-    std::pair<float, WORD> getIntersection(Line line, float depth = 16.0f)
-    {
-        WORD resChar = ' ';
-        std::pair<Vector3D, float> localRes = this->plane.getLineIntersection(line);
-        resChar = this->getCharByDistance(16.0f, localRes.second);
-        return { sqrtf(localRes.second), resChar };
-    }
-};
-
-class Player: public GameObject
-{
-private:
-    float fAngle;
-    float fRotationSpeed;
-
-public:
-    Player(): GameObject()
-    {
-        this->fAngle = 0.0;
-        this->fRotationSpeed = 0.0f;
-    }
-
-    Player(Vector3D centerPos, float speed): GameObject(centerPos, ' ', 0, speed)
-    {
-        this->fAngle = 0.0;
-        this->fRotationSpeed = 0.5f;
-    }
-
-    float getAngle() { return this->fAngle; }
-
-    void rotateAngle(int dir, float dt) { this->fAngle += dir * this->fRotationSpeed * dt; }
-
-    std::pair<float, WORD> getIntersection(Line line, float depth = 16.0f)
-    {
-        return { -1, ' ' };
-    }
-
-    WORD getCharByDistance(float depth, float distance)
-    {
-        return ' ';
+        return held;
     }
 };
+#endif
 
 class Game
 {
@@ -246,28 +60,45 @@ private:
     int nScreenWorldHeight = 4;
     float fFocalLength = 1.0f;  // Distance from player to console screen in world
 
-    int nMapWidth = 16;
-    int nMapHeight = 16;
-
     float fDepth = 60.0f;
+    float fTargetRenderTime = 1.0f / 60.0f;   // The renderer lowers its resolution when frames take longer
+    float fPlayerRadius = 1.0f;     // The player collides with walls as a circle of this radius
 
     Player player;
-    std::vector<GameObject*> objects;
-
-    std::wstring map;
-    float fElapsedTime = 0.0f;
+    World world;
+    Renderer renderer;
+    ThreadPool pool;
+    Profiler profiler;
+    Simulation simulation;
+    RayCaster caster;
+
+    // Input, polled once per simulation tick
+    InputSource* input;
+    InputRecording* recording;  // Gets every tick's input if it isn't nullptr
+    long long nInputTick = 0;
+    InputMask lastHeld = 0;
+    // Key presses counted on the simulation thread, acted on by the render thread
+    std::atomic<int> nProfilerPresses;
+    std::atomic<int> nReprojectionPresses;
+    std::atomic<int> nShotPresses;
+    int nShotsFired = 0;
+
+    float fElapsedTime = 0.0f;  // Render frame time, only used for the FPS counter
+    long long nLastAllocations = 0;
+    bool bShowProfiler = false;
+    RayQueryHit lastShot = { nullptr, -1, 0.0f, false };
 
     // Screen
-    wchar_t* screen;
-    WORD* attributes;
+    Framebuffer frame;
+#ifdef _WIN32
     HANDLE hConsole;
-    WORD floorColor = FOREGROUND_RED;
-    WORD wallColor = FOREGROUND_INTENSITY;
+#else
+    TerminalOutput output;
+#endif
 
     void setUpConsole()
     {
-        this->screen = new wchar_t[nScreenWidth * nScreenHeight];
-        this->attributes = new WORD[nScreenWidth * nScreenHeight];
+#ifdef _WIN32
         this->hConsole = CreateConsoleScreenBuffer(GENERIC_READ | GENERIC_WRITE, 0, NULL, CONSOLE_TEXTMODE_BUFFER, NULL);
         SetConsoleActiveScreenBuffer(this->hConsole);
 
@@ -276,219 +107,280 @@ private:
         GetConsoleCursorInfo(this->hConsole, &cursorInfo);
         cursorInfo.bVisible = FALSE;
         SetConsoleCursorInfo(this->hConsole, &cursorInfo);
+#else
+        this->output.begin();
+#endif
     }
 
-    void setUpMap()
+    void restoreConsole()
     {
-        this->map += L"################";
-        this->map += L"#..............#";
-        this->map += L"#..............#";
-        this->map += L"#..............#";
-        this->map += L"#..............#";
-        this->map += L"#..............#";
-        this->map += L"#..............#";
-        this->map += L"#........##....#";
-        this->map += L"#..............#";
-        this->map += L"#..............#";
-        this->map += L"#..............#";
-        this->map += L"#..............#";
-        this->map += L"#..............#";
-        this->map += L"#..............#";
-        this->map += L"#..............#";
-        this->map += L"################";
+#ifndef _WIN32
+        this->output.end();
+#endif
     }
 
-    void buildWorldFromMap()
-    {   
-        for (int y = 0; y < this->nMapHeight; y++)
-        {
-            for (int x = 0; x < this->nMapWidth; x++)
-            {
-                wchar_t currChar = map[y * nMapWidth + x];
-                if (currChar == '#')
-                {
-                    Vector3D centerPos(x * N_MAP_WORLD_RATIO, y * N_MAP_WORLD_RATIO, 2.5f);
-                    Cube* newCube = new Cube(centerPos, '#', FOREGROUND_BLUE, 0.0f);
-                    this->objects.push_back(newCube);
-                }
-            }
-        }
-        this->objects.push_back(new Floor(FOREGROUND_RED));     // Floor
-        this->objects.push_back(new Ceiling(FOREGROUND_RED | FOREGROUND_GREEN));
+    void present()
+    {
+#ifdef _WIN32
+        DWORD dwBytesWritten;
+        this->frame.chars[nScreenWidth * nScreenHeight - 1] = '\0';
+        WriteConsoleOutputCharacterW(this->hConsole, this->frame.chars.data(), nScreenWidth * nScreenHeight, {0, 0}, &dwBytesWritten);
+        WriteConsoleOutputAttribute(this->hConsole, this->frame.colors.data(), nScreenWidth * nScreenHeight, {0, 0}, &dwBytesWritten);
+#else
+        this->output.present(this->frame);
+#endif
     }
 
     void displayMap()
     {
-        for (int x = 0; x < this->nMapWidth; x++) 
+        // Large maps are cut to the screen
+        int nMapWidth = this->world.getMapWidth() < this->nScreenWidth ? this->world.getMapWidth() : this->nScreenWidth;
+        int nMapHeight = this->world.getMapHeight() < this->nScreenHeight - 1 ? this->world.getMapHeight() : this->nScreenHeight - 1;
+
+        for (int x = 0; x < nMapWidth; x++) 
         {
-            for (int y = 0; y < this->nMapHeight; y++)
+            for (int y = 0; y < nMapHeight; y++)
             {
-                this->screen[(y + 1) * this->nScreenWidth + x] = this->map[y * this->nMapWidth + x]; 
-                this->attributes[(y + 1) * this->nScreenWidth + x] = FOREGROUND_GREEN;
+                this->frame.set(x, y + 1, this->world.getMapCell(x, y), COLOR_GREEN);
             }
         }
 
         Vector3D playerPos = this->player.getCenterPos();
         Vector3D playerPosOnMap(playerPos[0] / 5, playerPos[1] / 5, 0);
-        this->screen[(int)playerPosOnMap[1] * this->nScreenWidth + (int)playerPosOnMap[0]] = 'P';
-        this->attributes[(int)playerPosOnMap[1] * this->nScreenWidth + (int)playerPosOnMap[0]] = FOREGROUND_GREEN | FOREGROUND_INTENSITY;
-    }
-
-    void displayStats() 
-    {
-        std::wstring stats = L"X=%3.2f, Y=%3.2f, Z=%3.2f A=%3.2f FPS=%3.2f";
-        Vector3D playerPos = this->player.getCenterPos();
-        swprintf_s(screen, stats.size(), L"X=%3.2f, Y=%3.2f, Z=%3.2f, A=%3.2f FPS=%3.2f", playerPos[0], playerPos[1], playerPos[2], 
-            player.getAngle(), 1.0 / this->fElapsedTime);
-
-        for (int i = 0; i < stats.size(); i++) {
-            this->attributes[i] = FOREGROUND_GREEN;
+        if (playerPosOnMap[0] >= 0 && playerPosOnMap[0] < nMapWidth && playerPosOnMap[1] >= 0 && playerPosOnMap[1] < nMapHeight)
+        {
+            this->frame.set((int)playerPosOnMap[0], (int)playerPosOnMap[1], 'P', COLOR_GREEN | COLOR_INTENSITY);
         }
     }
 
-    void handleInput()
+    void displayStats()
     {
-        if (GetAsyncKeyState((unsigned short)'A') & 0x8000) 
-        {
-            player.rotateAngle(-1, this->fElapsedTime);
-        }
+        // Heap allocations on all threads since the last frame, expected to stay 0
+        long long allocations = getAllocationCount();
+        long long frameAllocations = allocations - this->nLastAllocations;
+        this->nLastAllocations = allocations;
 
-        if (GetAsyncKeyState((unsigned short)'D') & 0x8000)
+        // Formatted on the stack, the overlay shouldn't allocate either
+        wchar_t stats[128];
+        Vector3D playerPos = this->player.getCenterPos();
+        int length = swprintf(stats, 128, L"X=%3.2f, Y=%3.2f, Z=%3.2f, A=%3.2f FPS=%3.2f ALLOC=%lld", playerPos[0], playerPos[1],
+            playerPos[2], player.getAngle(), 1.0 / this->fElapsedTime, frameAllocations);
+        if (this->lastShot.bHit)
         {
-            player.rotateAngle(1, this->fElapsedTime);
+            length += swprintf(stats + length, 128 - length, L" HIT=%d D=%3.2f", this->lastShot.nObject, this->lastShot.fDistance);
         }
 
-        if (GetAsyncKeyState((unsigned short)'W') & 0x8000)
+        for (int i = 0; i < length && i < this->nScreenWidth; i++)
         {
-            Vector3D direction(cosf(player.getAngle()), sinf(player.getAngle()), 0.0f);
-            player.move(direction, this->fElapsedTime);
+            this->frame.set(i, 0, stats[i], COLOR_GREEN);
         }
+    }
 
-        if (GetAsyncKeyState((unsigned short)'S') & 0x8000)
+    // Runs on the simulation thread, returns false when the game should quit
+    bool handleInput(Player& player, float dt)
+    {
+        InputMask held = this->input->poll(this->nInputTick);
+        bool quit = isActionHeld(held, ACTION_QUIT);
+        if (this->recording != nullptr && !quit)
         {
-            Vector3D direction(cosf(player.getAngle()), sinf(player.getAngle()), 0.0f);
-            player.move(direction * -1, this->fElapsedTime);
+            this->recording->add(this->nInputTick, held);
         }
+        this->nInputTick++;
 
-        if (GetAsyncKeyState((unsigned short)'U') & 0x8000)
-        {
-            Vector3D direction(0, 0, 1);
-            player.move(direction, this->fElapsedTime);
-        }
+        InputMask pressed = held & ~this->lastHeld;
+        this->lastHeld = held;
+        this->nProfilerPresses += isActionHeld(pressed, ACTION_PROFILER);
+        this->nReprojectionPresses += isActionHeld(pressed, ACTION_REPROJECTION);
+        this->nShotPresses += isActionHeld(pressed, ACTION_FIRE);
 
-        if (GetAsyncKeyState((unsigned short)'J') & 0x8000)
-        {
-            Vector3D direction(0, 0, -1);
-            player.move(direction, this->fElapsedTime);
-        }
+        applyPlayerInput(player, held, dt, this->world.getCollisionMap(), this->fPlayerRadius);
+        return !quit;
     }
 
-    void update()
+    // Game logic beyond moving the player goes here, timed as STAGE_UPDATE
+    void update(Player& /*player*/, float /*dt*/)
     {
         return;
     }
 
-    void render()
+    // Fixed tick on the simulation thread
+    bool step(Player& player, float dt)
     {
-        Vector3D playerPos = this->player.getCenterPos();
-        float playerAngle = this->player.getAngle();
+        ProfileTime time1 = getProfileTime();
+        bool running = this->handleInput(player, dt);
+        ProfileTime time2 = getProfileTime();
+        this->update(player, dt);
+        ProfileTime time3 = getProfileTime();
+
+        this->profiler.addTime(STAGE_INPUT, time2 - time1);
+        this->profiler.addTime(STAGE_UPDATE, time3 - time2);
+        return running;
+    }
 
-        // Aspect ratio and FOV
-        float aspectRatio = (float)this->nScreenWidth / (float)this->nScreenHeight;
-        float fov = 3.14159 / 4.0; // 45 degree field of view
+    // Acts on the key presses of the last ticks on the render thread
+    void handleViewInput()
+    {
+        // Every press toggles the profiler overlay and reusing the last frame's hits
+        this->bShowProfiler = (this->nProfilerPresses.load() & 1) != 0;
+        bool reprojection = (this->nReprojectionPresses.load() & 1) != 0;
+        if (reprojection != this->renderer.getReprojection())
+        {
+            this->renderer.setReprojection(reprojection);
+        }
 
-        for (int y = 0; y < this->nScreenHeight; y++) 
+        // Hitscan shot along the view direction. Cast here, where the world only changes between frames
+        int shots = this->nShotPresses.load();
+        if (shots != this->nShotsFired)
         {
-            for (int x = 0; x < this->nScreenWidth; x++)
-            {
-                // Calculate normalized device coordinates
-                float ndcX = (2.0f * x / (float)this->nScreenWidth - 1.0f) * aspectRatio;
-                float ndcY = 1.0f - 2.0f * y / (float)this->nScreenHeight;
-
-                // Calculate the direction of the ray in camera space
-                float rayDirX = 1.0f; // Looking along the x-axis initially
-                float rayDirY = ndcX * tanf(fov / 2.0f);
-                float rayDirZ = ndcY * tanf(fov / 2.0f);
-
-                // Rotate the ray direction to align with the player's view direction
-                Vector3D rayDirection = Vector3D(
-                    cosf(playerAngle) * rayDirX - sinf(playerAngle) * rayDirY,
-                    sinf(playerAngle) * rayDirX + cosf(playerAngle) * rayDirY,
-                    rayDirZ
-                );
-                Line lRay(playerPos, rayDirection);
-
-                // Find nearest seen object
-                float fDistance = this->fDepth; // Init with depth limit
-                WORD wCharToUse = ' ';
-                WORD wColorToUse = 0;
-                for(GameObject* obj: this->objects)
-                {
-                    std::pair<float, WORD> intersection = obj->getIntersection(lRay, this->fDepth);
-                    
-                    if (intersection.first > 0 && intersection.first < fDistance) 
-                    {
-                        fDistance = intersection.first;
-                        wColorToUse = obj->getPixelColor();
-                        wCharToUse = intersection.second;
-                    }
-                }
-
-                this->screen[y * this->nScreenWidth + x] = wCharToUse;
-                this->attributes[y * this->nScreenWidth + x] = wColorToUse;
-            }            
+            this->nShotsFired = shots;
+            Vector3D pos = this->player.getCenterPos();
+            float angle = this->player.getAngle();
+            RayQuery shot = { { pos[0], pos[1], pos[2] }, { cosf(angle), sinf(angle), 0.0f }, this->fDepth * this->fDepth };
+            this->lastShot = this->caster.cast(this->world, shot);
         }
+    }
 
+    void render()
+    {
+        this->renderer.render(this->player, this->world, this->frame);
+
+        ScopedTimer timer(&this->profiler, STAGE_OVERLAY);
         this->displayMap();
         this->displayStats();
-        //exit(1);
+        if (this->bShowProfiler)
+        {
+            this->profiler.drawOverlay(this->frame, this->nScreenWidth - 40, 1);
+        }
     }
 
-public:
-    Game()
+    void saveProfile()
     {
-        this->setUpConsole();
-        this->setUpMap();
-        this->buildWorldFromMap();
-        this->player = Player(Vector3D(40, 40, this->nScreenHeight / (2 * (float)N_SCREEN_WORLD_RATIO)), 2.0f);
+        this->profiler.exportCsv("profile.csv");
+        this->profiler.exportChromeTrace("profile.json");
+
+        logFile << "Stage mean / p99 (ms) over the last frames:" << std::endl;
+        for (int i = 0; i < STAGE_COUNT; i++)
+        {
+            ProfileStage stage = (ProfileStage)i;
+            logFile << Profiler::getStageName(stage) << ": " << this->profiler.getMean(stage) / 1e6 << " / "
+                << this->profiler.getPercentile(stage, 99) / 1e6 << std::endl;
+        }
     }
 
-    ~Game()
+public:
+    // Loads the map from mapPath (text or binary map file), the built-in map if it is nullptr.
+    //     With streamingCap > 0 the map is streamed around the player, keeping at most that many bytes.
+    //     The player is moved by inputSource in ticks of tickSeconds, which are added to inputRecording if it isn't nullptr
+    Game(const char* mapPath, size_t streamingCap, InputSource* inputSource, InputRecording* inputRecording, float tickSeconds)
+        : renderer(3.14159f / 4.0f, fDepth), simulation(tickSeconds), input(inputSource), recording(inputRecording),
+          nProfilerPresses(0), nReprojectionPresses(0), nShotPresses(0), frame(nScreenWidth, nScreenHeight)
     {
-        delete this->screen;
-        delete this->attributes;
+        this->setUpConsole();
+        if (streamingCap > 0)
+        {
+            // Distances are the square root of the ray parameter, so walls are seen up to fDepth^2 away
+            float chunkSize = (float)(N_MAP_WORLD_RATIO << N_STREAMING_CHUNK_SHIFT);
+            this->world.enableStreaming(streamingCap, (int)ceilf(this->fDepth * this->fDepth / chunkSize));
+        }
+        if (mapPath == nullptr || !this->world.loadMap(mapPath))
+        {
+            if (mapPath != nullptr)
+            {
+                logFile << "Can't load map " << mapPath << ", using the built-in one" << std::endl;
+            }
+            this->world.setUpMap();
+        }
+        this->world.buildWorldFromMap();
+        this->renderer.setMode(RENDER_COLUMN);
+        this->renderer.setThreadPool(&this->pool);
+        this->renderer.setProfiler(&this->profiler);
+        this->renderer.setAdaptiveQuality(this->fTargetRenderTime);
+        this->player = Player(Vector3D(40, 40, this->nScreenHeight / (2 * (float)N_SCREEN_WORLD_RATIO)), 2.0f);
     }
 
     void start()
     {
-        auto time1 = std::chrono::system_clock::now();
-        auto time2 = std::chrono::system_clock::now();
+        this->simulation.start(this->player, [this](Player& player, float dt) { return this->step(player, dt); });
+
+        auto time1 = std::chrono::steady_clock::now();
+        auto time2 = std::chrono::steady_clock::now();
 
-        while (true)
+        while (this->simulation.isRunning())
         {
-            time2 = std::chrono::system_clock::now();
+            ProfileTime frameStart = getProfileTime();
+            time2 = std::chrono::steady_clock::now();
             std::chrono::duration<float> elapsedTime = time2 - time1;
             time1 = time2;
             this->fElapsedTime = elapsedTime.count();
 
-            handleInput();
-            update();
+            handleViewInput();
+            this->simulation.getInterpolatedPlayer(this->player, time2);
+            this->world.updateStreaming(this->player.getCenterPos());
             render();
 
             // Draw
-            DWORD dwBytesWritten;
-            screen[nScreenWidth * nScreenHeight - 1] = '\0';
-            WriteConsoleOutputCharacterW(this->hConsole, screen, nScreenWidth * nScreenHeight, {0, 0}, &dwBytesWritten);
-            WriteConsoleOutputAttribute(this->hConsole, attributes, nScreenWidth * nScreenHeight, {0, 0}, &dwBytesWritten);
+            {
+                ScopedTimer timer(&this->profiler, STAGE_PRESENT);
+                this->present();
+            }
+
+            this->profiler.endFrame(frameStart);
         }
 
+        this->simulation.stop();
+        this->restoreConsole();
+        this->saveProfile();
     }
 };
 
-int main() 
+int main(int argc, char** argv) 
 {
-    Game myGame;
-    myGame.start();
+    // fps [--record FILE] [--replay FILE] [map file] [streaming cap in MB]
+    const char* recordPath = nullptr;
+    const char* replayPath = nullptr;
+    std::vector<const char*> args;
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "--record") == 0)      { recordPath = argv[++i]; }
+        else if (i + 1 < argc && strcmp(argv[i], "--replay") == 0) { replayPath = argv[++i]; }
+        else                                                       { args.push_back(argv[i]); }
+    }
+    size_t streamingCap = args.size() > 1 ? (size_t)(atof(args[1]) * 1024 * 1024) : 0;
+
+    // A replay runs at the tick length it was recorded with
+    InputRecording replay;
+    if (replayPath != nullptr && !replay.load(replayPath))
+    {
+        fprintf(stderr, "Can't load input recording %s\n", replayPath);
+        return 1;
+    }
+    InputPlayback playback(replay);
+#ifdef _WIN32
+    ConsoleInput keys;
+#else
+    // A replay leaves the terminal as it is and doesn't read it
+    TerminalInput keys;
+    if (replayPath == nullptr)
+    {
+        keys.begin();
+    }
+#endif
+    InputSource* input = replayPath != nullptr ? (InputSource*)&playback : (InputSource*)&keys;
+    InputRecording recording(replay.getTickSeconds());
 
+    {
+        Game myGame(args.size() > 0 ? args[0] : nullptr, streamingCap, input, recordPath != nullptr ? &recording : nullptr,
+            replay.getTickSeconds());
+        myGame.start();
+    }
+#ifndef _WIN32
+    keys.end();
+#endif
+
+    if (recordPath != nullptr && !recording.save(recordPath))
+    {
+        fprintf(stderr, "Can't save input recording %s\n", recordPath);
+        return 1;
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,413 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include "mapfile.h"
+#include "objects.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char MAP_FILE_MAGIC[8] = { 'F', 'P', 'S', 'M', 'A', 'P', 0, 0 };
+
+#ifdef _WIN32
+typedef HANDLE FileHandle;
+#else
+typedef int FileHandle;
+#endif
+
+
+// Reads size bytes at offset without moving a shared file position, so threads can read at once
+static bool readFileAt(FileHandle file, unsigned long long offset, void* buffer, size_t size)
+{
+    unsigned char* out = (unsigned char*)buffer;
+    while (size > 0)
+    {
+#ifdef _WIN32
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)offset;
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD count = 0;
+        if (!ReadFile(file, out, (DWORD)std::min(size, (size_t)1 << 30), &count, &overlapped) || count == 0)
+        {
+            return false;
+        }
+#else
+        ssize_t count = pread(file, out, size, (off_t)offset);
+        if (count <= 0)
+        {
+            return false;
+        }
+#endif
+        out += count;
+        offset += count;
+        size -= count;
+    }
+    return true;
+}
+
+// Checks that everything the header points to lies within a file of size bytes
+static bool isValidHeader(const MapFileHeader* header, unsigned long long size)
+{
+    bool valid = size >= sizeof(MapFileHeader) && memcmp(header->magic, MAP_FILE_MAGIC, sizeof(MAP_FILE_MAGIC)) == 0 &&
+        header->nVersion == N_MAP_FILE_VERSION && header->nWidth > 0 && header->nHeight > 0 &&
+        header->nWidth <= 65536 && header->nHeight <= 65536 && header->nObjectsOffset % 4 == 0;
+    if (!valid)
+    {
+        return false;
+    }
+
+    unsigned long long cellBytes = (unsigned long long)header->nWidth * header->nHeight;
+    unsigned long long objectBytes = (unsigned long long)header->nObjectCount * sizeof(MapObjectRecord);
+    // The wall count sizes the world without a scan of the cells, it can't be more than there are squares
+    return header->nCellsOffset <= size && cellBytes <= size - header->nCellsOffset &&
+        header->nObjectsOffset <= size && objectBytes <= size - header->nObjectsOffset &&
+        header->nWallCount <= cellBytes && header->nWallCount <= (unsigned int)INT_MAX && header->nObjectCount <= (unsigned int)INT_MAX;
+}
+
+void MapFile::closeFile()
+{
+#ifdef _WIN32
+    if (this->mapping != nullptr)
+    {
+        UnmapViewOfFile(this->mapping);
+        CloseHandle((HANDLE)this->hMapping);
+    }
+    if (this->hFile != nullptr)
+    {
+        CloseHandle((HANDLE)this->hFile);
+    }
+    this->hMapping = nullptr;
+    this->hFile = nullptr;
+#else
+    if (this->mapping != nullptr)
+    {
+        munmap(this->mapping, this->nMappingSize);
+    }
+    if (this->nFile >= 0)
+    {
+        close(this->nFile);
+    }
+    this->nFile = -1;
+#endif
+    this->mapping = nullptr;
+    this->nMappingSize = 0;
+}
+
+void MapFile::useStorage()
+{
+    this->closeFile();
+    this->cells = this->cellStorage.data();
+    this->objects = this->objectStorage.data();
+    this->nObjectCount = (int)this->objectStorage.size();
+
+    this->nWallCount = 0;
+    for (unsigned char cell: this->cellStorage)
+    {
+        this->nWallCount += cell == '#';
+    }
+}
+
+void MapFile::setCells(int width, int height, const std::wstring& cells)
+{
+    this->nWidth = width;
+    this->nHeight = height;
+    this->cellStorage.assign(cells.begin(), cells.begin() + width * height);
+    this->objectStorage.clear();
+    this->useStorage();
+}
+
+bool MapFile::load(const std::string& path, bool stream)
+{
+    char magic[8] = {};
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    size_t read = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+
+    if (read == sizeof(magic) && memcmp(magic, MAP_FILE_MAGIC, sizeof(magic)) == 0)
+    {
+        return stream ? this->openBinary(path) : this->loadBinary(path);
+    }
+    return this->loadText(path);
+}
+
+bool MapFile::loadText(const std::string& path)
+{
+    std::ifstream file(path.c_str());
+    if (!file)
+    {
+        return false;
+    }
+
+    std::vector<unsigned char> cells;
+    std::vector<MapObjectRecord> objects;
+    int width = 0;
+    int height = 0;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (!line.empty() && line[line.size() - 1] == '\r')
+        {
+            line.erase(line.size() - 1);
+        }
+        if (line.empty() || line[0] == ';')
+        {
+            continue;
+        }
+
+        MapObjectRecord record = {};
+        if (sscanf(line.c_str(), "cube %f %f %f", &record.fPos[0], &record.fPos[1], &record.fPos[2]) == 3)
+        {
+            record.nType = MAP_OBJECT_CUBE;
+            record.nGlyph = '#';
+            record.nColor = COLOR_GREEN;
+            objects.push_back(record);
+            continue;
+        }
+
+        if (height > 0 && (int)line.size() != width)
+        {
+            return false;
+        }
+        width = (int)line.size();
+        cells.insert(cells.end(), line.begin(), line.end());
+        height++;
+    }
+
+    if (width == 0 || height == 0)
+    {
+        return false;
+    }
+
+    this->nWidth = width;
+    this->nHeight = height;
+    this->cellStorage.swap(cells);
+    this->objectStorage.swap(objects);
+    this->useStorage();
+    return true;
+}
+
+bool MapFile::loadBinary(const std::string& path)
+{
+    void* mapping = nullptr;
+    size_t size = 0;
+
+#ifdef _WIN32
+    HANDLE hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    HANDLE hMapping = NULL;
+    if (GetFileSizeEx(hFile, &fileSize) && fileSize.QuadPart > 0)
+    {
+        size = (size_t)fileSize.QuadPart;
+        hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+    if (hMapping != NULL)
+    {
+        mapping = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (mapping == nullptr)
+    {
+        if (hMapping != NULL)
+        {
+            CloseHandle(hMapping);
+        }
+        CloseHandle(hFile);
+        return false;
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        size = (size_t)info.st_size;
+        mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            mapping = nullptr;
+        }
+    }
+    // The mapping keeps the file alive
+    close(fd);
+    if (mapping == nullptr)
+    {
+        return false;
+    }
+#endif
+
+    const unsigned char* data = (const unsigned char*)mapping;
+    const MapFileHeader* header = (const MapFileHeader*)data;
+    if (!isValidHeader(header, size))
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+        CloseHandle(hMapping);
+        CloseHandle(hFile);
+#else
+        munmap(mapping, size);
+#endif
+        return false;
+    }
+
+    this->closeFile();
+    this->cellStorage.clear();
+    this->objectStorage.clear();
+
+    this->mapping = mapping;
+    this->nMappingSize = size;
+#ifdef _WIN32
+    this->hFile = hFile;
+    this->hMapping = hMapping;
+#endif
+
+    this->nWidth = (int)header->nWidth;
+    this->nHeight = (int)header->nHeight;
+    this->nWallCount = (int)header->nWallCount;
+    this->nObjectCount = (int)header->nObjectCount;
+    this->nCellsOffset = header->nCellsOffset;
+    this->cells = data + header->nCellsOffset;
+    this->objects = (const MapObjectRecord*)(data + header->nObjectsOffset);
+    return true;
+}
+
+bool MapFile::openBinary(const std::string& path)
+{
+    MapFileHeader header;
+    std::vector<MapObjectRecord> objects;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    bool valid = GetFileSizeEx(file, &fileSize) && readFileAt(file, 0, &header, sizeof(header)) &&
+        isValidHeader(&header, (unsigned long long)fileSize.QuadPart);
+#else
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+    struct stat info;
+    bool valid = fstat(file, &info) == 0 && readFileAt(file, 0, &header, sizeof(header)) &&
+        isValidHeader(&header, (unsigned long long)info.st_size);
+#endif
+
+    // Objects are few, they are read in full
+    if (valid)
+    {
+        objects.resize(header.nObjectCount);
+        valid = readFileAt(file, header.nObjectsOffset, objects.data(), objects.size() * sizeof(MapObjectRecord));
+    }
+    if (!valid)
+    {
+#ifdef _WIN32
+        CloseHandle(file);
+#else
+        close(file);
+#endif
+        return false;
+    }
+
+    this->closeFile();
+    this->cellStorage.clear();
+    this->objectStorage.swap(objects);
+#ifdef _WIN32
+    this->hFile = file;
+#else
+    this->nFile = file;
+#endif
+
+    this->nWidth = (int)header.nWidth;
+    this->nHeight = (int)header.nHeight;
+    this->nWallCount = (int)header.nWallCount;
+    this->nObjectCount = (int)header.nObjectCount;
+    this->nCellsOffset = header.nCellsOffset;
+    this->cells = nullptr;
+    this->objects = this->objectStorage.data();
+    return true;
+}
+
+bool MapFile::readCells(int firstX, int firstY, int width, int height, unsigned char* out, int stride) const
+{
+    for (int y = 0; y < height; y++)
+    {
+        unsigned long long offset = (unsigned long long)(firstY + y) * this->nWidth + firstX;
+        if (this->cells != nullptr)
+        {
+            memcpy(out + (long long)y * stride, this->cells + offset, width);
+            continue;
+        }
+#ifdef _WIN32
+        if (!readFileAt((HANDLE)this->hFile, this->nCellsOffset + offset, out + (long long)y * stride, width))
+#else
+        if (!readFileAt(this->nFile, this->nCellsOffset + offset, out + (long long)y * stride, width))
+#endif
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MapFile::saveBinary(const std::string& path) const
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    unsigned long long cellBytes = (unsigned long long)this->nWidth * this->nHeight;
+    unsigned long long padding = (4 - (sizeof(MapFileHeader) + cellBytes) % 4) % 4;
+
+    MapFileHeader header = {};
+    memcpy(header.magic, MAP_FILE_MAGIC, sizeof(MAP_FILE_MAGIC));
+    header.nVersion = N_MAP_FILE_VERSION;
+    header.nWidth = this->nWidth;
+    header.nHeight = this->nHeight;
+    header.nWallCount = this->nWallCount;
+    header.nObjectCount = this->nObjectCount;
+    header.nCellsOffset = sizeof(MapFileHeader);
+    header.nObjectsOffset = sizeof(MapFileHeader) + cellBytes + padding;
+
+    const char zeros[4] = {};
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (this->cells != nullptr)
+    {
+        ok = ok && fwrite(this->cells, 1, cellBytes, file) == cellBytes;
+    }
+    else
+    {
+        // Streamed maps are copied row by row
+        std::vector<unsigned char> row(this->nWidth);
+        for (int y = 0; ok && y < this->nHeight; y++)
+        {
+            ok = this->readCells(0, y, this->nWidth, 1, row.data(), this->nWidth) && fwrite(row.data(), 1, row.size(), file) == row.size();
+        }
+    }
+    ok = ok && fwrite(zeros, 1, padding, file) == padding &&
+        fwrite(this->objects, sizeof(MapObjectRecord), this->nObjectCount, file) == (size_t)this->nObjectCount;
+    return fclose(file) == 0 && ok;
+}
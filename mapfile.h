@@ -0,0 +1,139 @@
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <string>
+#include <vector>
+
+/*
+    Map data: a grid of one byte per map square ('#' - wall, anything else - empty)
+    and a table of objects that are not bound to squares.
+
+    Text format, for writing maps by hand:
+        ; comment
+        ################
+        #..............#
+        ...
+        cube X Y Z              free-standing cube centered at world position X Y Z
+    All grid rows have the same length.
+
+    Binary format, used in place: the file is memory-mapped and the cell grid and object
+    table are read straight from the mapping, nothing is parsed or copied. Little-endian:
+        MapFileHeader
+        cells           nWidth * nHeight bytes, row by row
+        objects         nObjectCount MapObjectRecord, 4-byte aligned
+    Only the pages that are touched are read from disk, so large maps load in about the
+    time it takes to open the file.
+    A binary map can also be opened for streaming: only the header and the object table are
+    read, the cells stay in the file and are read a block at a time with readCells, so the
+    map takes no memory for its cells at all.
+*/
+
+const unsigned int N_MAP_FILE_VERSION = 1;
+
+enum MapObjectType
+{
+    MAP_OBJECT_CUBE = 1
+};
+
+struct MapFileHeader
+{
+    char magic[8];                  // "FPSMAP\0\0"
+    unsigned int nVersion;
+    unsigned int nWidth;
+    unsigned int nHeight;
+    unsigned int nWallCount;        // Squares with '#', so the world can size itself without a scan
+    unsigned int nObjectCount;
+    unsigned int nReserved;
+    unsigned long long nCellsOffset;
+    unsigned long long nObjectsOffset;
+};
+
+struct MapObjectRecord
+{
+    unsigned int nType;
+    float fPos[3];
+    unsigned int nGlyph;
+    unsigned short nColor;
+    unsigned short nReserved;
+};
+
+class MapFile
+{
+private:
+    int nWidth = 0;
+    int nHeight = 0;
+    int nWallCount = 0;
+    int nObjectCount = 0;
+    const unsigned char* cells = nullptr;
+    const MapObjectRecord* objects = nullptr;
+
+    // Cells and objects of maps that were not mapped from a binary file
+    std::vector<unsigned char> cellStorage;
+    std::vector<MapObjectRecord> objectStorage;
+
+    // Mapped binary file, or the one opened for streaming
+    void* mapping = nullptr;
+    size_t nMappingSize = 0;
+    unsigned long long nCellsOffset = 0;
+#ifdef _WIN32
+    void* hFile = nullptr;
+    void* hMapping = nullptr;
+#else
+    int nFile = -1;
+#endif
+
+    // Unmaps or closes the binary file
+    void closeFile();
+
+    void useStorage();
+
+public:
+    MapFile() {}
+
+    ~MapFile() { this->closeFile(); }
+
+    MapFile(const MapFile&) = delete;
+
+    MapFile& operator=(const MapFile&) = delete;
+
+    int getWidth() const { return this->nWidth; }
+
+    int getHeight() const { return this->nHeight; }
+
+    int getWallCount() const { return this->nWallCount; }
+
+    // Cells row by row, nullptr if the map was opened for streaming
+    const unsigned char* getCells() const { return this->cells; }
+
+    // Only for maps whose cells are in memory
+    unsigned char getCell(int x, int y) const { return this->cells[(long long)y * this->nWidth + x]; }
+
+    // Copies the cells of squares [firstX, firstX + width) x [firstY, firstY + height) to rows of
+    //     stride bytes, from the file if the map was opened for streaming. Safe to call from any thread
+    bool readCells(int firstX, int firstY, int width, int height, unsigned char* out, int stride) const;
+
+    int getObjectCount() const { return this->nObjectCount; }
+
+    const MapObjectRecord* getObjects() const { return this->objects; }
+
+    bool isMapped() const { return this->mapping != nullptr; }
+
+    bool isStreamed() const { return this->cells == nullptr && this->nWidth > 0; }
+
+    // Replaces the map with a width x height grid, rows are stored one after another
+    void setCells(int width, int height, const std::wstring& cells);
+
+    // Text or binary, told apart by the header. With stream a binary map is opened for streaming
+    bool load(const std::string& path, bool stream = false);
+
+    bool loadText(const std::string& path);
+
+    bool loadBinary(const std::string& path);
+
+    // Reads the header and object table of a binary map and keeps the file open for readCells
+    bool openBinary(const std::string& path);
+
+    bool saveBinary(const std::string& path) const;
+};
+
+#endif
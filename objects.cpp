@@ -0,0 +1,338 @@
+#include <climits>
+#include "objects.h"
+#include "boxkernel.h"
+
+
+GameObject::GameObject()
+{
+    v3CenterWorldPos = Vector3D();
+    fMapPos[0] = -1;
+    fMapPos[1] = -1;
+    wChar = ' ';
+    wPixelColor = 0; // BLACK;
+    this->fSpeed = 0;
+}
+
+GameObject::GameObject(Vector3D centerPos, Glyph objectChar, Color color, float speed)
+{
+    v3CenterWorldPos = centerPos;
+    fMapPos[0] = centerPos[0] / N_MAP_WORLD_RATIO;
+    fMapPos[1] = centerPos[1] / N_MAP_WORLD_RATIO;
+    wChar = objectChar;
+    wPixelColor = color;
+    this->fSpeed = speed;
+}
+
+void GameObject::setCenterPos(Vector3D centerPos)
+{
+    this->v3CenterWorldPos = centerPos;
+    fMapPos[0] = centerPos[0] / N_MAP_WORLD_RATIO;
+    fMapPos[1] = centerPos[1] / N_MAP_WORLD_RATIO;
+}
+
+void GameObject::move(Vector3D direction, float dt)
+{
+    direction.normalize();
+
+    this->v3CenterWorldPos = this->v3CenterWorldPos + direction * this->fSpeed * dt;
+    fMapPos[0] = this->v3CenterWorldPos[0] / N_MAP_WORLD_RATIO;
+    fMapPos[1] = this->v3CenterWorldPos[1] / N_MAP_WORLD_RATIO;
+}
+
+void GameObject::intersectPacket(const RayPacket& packet, float depth, std::pair<float, Glyph>* intersections)
+{
+    for (int i = 0; i < packet.nCount; i++)
+    {
+        intersections[i] = this->getIntersection(packet.lines[i], depth);
+    }
+}
+
+// Results of a box kernel in the form Cube::getIntersection returns them
+static void shadeBoxPacket(const float* tHits, int count, float depth, std::pair<float, Glyph>* intersections)
+{
+    ShadeTiers tiers = Cube::getShadeTiers(depth);
+    for (int i = 0; i < count; i++)
+    {
+        intersections[i] = { sqrtf(tHits[i]), tHits[i] < (float)INT_MAX ? tiers.shade(tHits[i]) : ' ' };
+    }
+}
+
+
+Cube::Cube(Vector3D centerPos, Glyph objectChar, Color color, float speed): GameObject(centerPos, objectChar, color, speed)
+{
+    this->size = 2.5f;
+
+    this->updateBounds();
+}
+
+void Cube::updateBounds()
+{
+    Vector3D centerPos = this->v3CenterWorldPos;
+
+    this->fMinX = centerPos[0] - size < centerPos[0] + size ? centerPos[0] - size : centerPos[0] + size;
+    this->fMaxX = centerPos[0] - size > centerPos[0] + size ? centerPos[0] - size : centerPos[0] + size;
+    this->fMinY = centerPos[1] - size < centerPos[1] + size ? centerPos[1] - size : centerPos[1] + size;
+    this->fMaxY = centerPos[1] - size > centerPos[1] + size ? centerPos[1] - size : centerPos[1] + size;
+    this->fMinZ = centerPos[2] - size < centerPos[2] + size ? centerPos[2] - size : centerPos[2] + size;
+    this->fMaxZ = centerPos[2] - size > centerPos[2] + size ? centerPos[2] - size : centerPos[2] + size;
+
+    planes[0] = Plane(Vector3D(centerPos[0] - size, centerPos[1], centerPos[2]), Vector3D(-1, 0, 0)); // Left
+    planes[1] = Plane(Vector3D(centerPos[0] + size, centerPos[1], centerPos[2]), Vector3D(1, 0, 0));  // Right
+    planes[2] = Plane(Vector3D(centerPos[0], centerPos[1] - size, centerPos[2]), Vector3D(0, -1, 0)); // Bottom
+    planes[3] = Plane(Vector3D(centerPos[0], centerPos[1] + size, centerPos[2]), Vector3D(0, 1, 0));  // Top
+    planes[4] = Plane(Vector3D(centerPos[0], centerPos[1], centerPos[2] - size), Vector3D(0, 0, -1)); // Front
+    planes[5] = Plane(Vector3D(centerPos[0], centerPos[1], centerPos[2] + size), Vector3D(0, 0, 1));  // Back
+}
+
+void Cube::setCenterPos(Vector3D centerPos)
+{
+    GameObject::setCenterPos(centerPos);
+    this->updateBounds();
+}
+
+void Cube::move(Vector3D direction, float dt)
+{
+    GameObject::move(direction, dt);
+    this->updateBounds();
+}
+
+bool Cube::getBounds(Vector3D& minCorner, Vector3D& maxCorner) const
+{
+    minCorner = Vector3D(this->fMinX, this->fMinY, this->fMinZ);
+    maxCorner = Vector3D(this->fMaxX, this->fMaxY, this->fMaxZ);
+    return true;
+}
+
+ShadeTiers Cube::getShadeTiers(float depth)
+{
+    ShadeTiers tiers = { { depth / 2.0f, depth / 1.75f, depth / 1.5f, depth }, { 0x2588, 0x2593, 0x2592, 0x2591 }, ' ' }; // Close to far
+    return tiers;
+}
+
+Glyph Cube::getCharByDistance(float depth, float distance)
+{
+    return getShadeTiers(depth).shade(distance);
+}
+
+std::pair<float, Glyph> Cube::getIntersection(Line line, float depth)
+{
+    float result = INT_MAX;
+    Glyph resChar = ' ';
+    for(const Plane& plane: this->planes)
+    {
+        std::pair<Vector3D, float> localRes = plane.getLineIntersection(line);
+        Vector3D point = localRes.first;
+        float localDistance = localRes.second;
+
+        // Check bounds
+        if (point[0] < this->fMinX || point[0] > this->fMaxX)
+        {
+            continue;
+        }
+
+        if (point[1] < this->fMinY || point[1] > this->fMaxY)
+        {
+            continue;
+        }
+
+        if (point[2] < this->fMinZ || point[2] > this->fMaxZ)
+        {
+            continue;
+        }
+
+        if (localDistance > 0 && localDistance < result)
+        {
+            resChar = this->getCharByDistance(depth, localDistance);
+            result = localDistance;
+        }
+    }
+    return { sqrtf(result), resChar };
+}
+
+void Cube::intersectPacket(const RayPacket& packet, float depth, std::pair<float, Glyph>* intersections)
+{
+    float boxMin[3] = { this->fMinX, this->fMinY, this->fMinZ };
+    float boxMax[3] = { this->fMaxX, this->fMaxY, this->fMaxZ };
+    float tHits[N_MAX_PACKET_RAYS];
+    intersectBoxPacket(boxMin, boxMax, packet, (float)INT_MAX, tHits);
+    shadeBoxPacket(tHits, packet.nCount, depth, intersections);
+}
+
+
+Box::Box(Vector3D minCorner, Vector3D maxCorner, Glyph objectChar, Color color):
+    GameObject((minCorner + maxCorner) * 0.5f, objectChar, color, 0.0f)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        this->fMin[i] = minCorner[i];
+        this->fMax[i] = maxCorner[i];
+    }
+    this->updatePlanes();
+}
+
+void Box::updatePlanes()
+{
+    // Face planes pass through the box center, like Cube's; only the coordinate along the normal matters
+    Vector3D center = this->v3CenterWorldPos;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        for (int side = 0; side < 2; side++)
+        {
+            float point[3] = { center[0], center[1], center[2] };
+            float normal[3] = { 0, 0, 0 };
+            point[axis] = side == 0 ? this->fMin[axis] : this->fMax[axis];
+            normal[axis] = side == 0 ? -1.0f : 1.0f;
+            this->planes[axis * 2 + side] = Plane(Vector3D(point[0], point[1], point[2]), Vector3D(normal[0], normal[1], normal[2]));
+        }
+    }
+}
+
+void Box::setCenterPos(Vector3D centerPos)
+{
+    Vector3D offset = centerPos - this->v3CenterWorldPos;
+    for (int i = 0; i < 3; i++)
+    {
+        this->fMin[i] += offset[i];
+        this->fMax[i] += offset[i];
+    }
+    GameObject::setCenterPos(centerPos);
+    this->updatePlanes();
+}
+
+void Box::move(Vector3D direction, float dt)
+{
+    Vector3D oldCenter = this->v3CenterWorldPos;
+    GameObject::move(direction, dt);
+    Vector3D offset = this->v3CenterWorldPos - oldCenter;
+    for (int i = 0; i < 3; i++)
+    {
+        this->fMin[i] += offset[i];
+        this->fMax[i] += offset[i];
+    }
+    this->updatePlanes();
+}
+
+bool Box::getBounds(Vector3D& minCorner, Vector3D& maxCorner) const
+{
+    minCorner = Vector3D(this->fMin[0], this->fMin[1], this->fMin[2]);
+    maxCorner = Vector3D(this->fMax[0], this->fMax[1], this->fMax[2]);
+    return true;
+}
+
+Glyph Box::getCharByDistance(float depth, float distance)
+{
+    return Cube::getShadeTiers(depth).shade(distance);
+}
+
+std::pair<float, Glyph> Box::getIntersection(Line line, float depth)
+{
+    // Same arithmetic as Cube::getIntersection
+    float result = INT_MAX;
+    Glyph resChar = ' ';
+    for (const Plane& plane: this->planes)
+    {
+        std::pair<Vector3D, float> localRes = plane.getLineIntersection(line);
+        Vector3D point = localRes.first;
+        float localDistance = localRes.second;
+
+        if (point[0] < this->fMin[0] || point[0] > this->fMax[0] ||
+            point[1] < this->fMin[1] || point[1] > this->fMax[1] ||
+            point[2] < this->fMin[2] || point[2] > this->fMax[2])
+        {
+            continue;
+        }
+
+        if (localDistance > 0 && localDistance < result)
+        {
+            resChar = this->getCharByDistance(depth, localDistance);
+            result = localDistance;
+        }
+    }
+    return { sqrtf(result), resChar };
+}
+
+void Box::intersectPacket(const RayPacket& packet, float depth, std::pair<float, Glyph>* intersections)
+{
+    float tHits[N_MAX_PACKET_RAYS];
+    intersectBoxPacket(this->fMin, this->fMax, packet, (float)INT_MAX, tHits);
+    shadeBoxPacket(tHits, packet.nCount, depth, intersections);
+}
+
+
+Floor::Floor(Color color): GameObject(Vector3D(0, 0, 0), 'x', color, 0.0f)
+{
+    this->plane = Plane(Vector3D(0, 0, 0.0f), Vector3D(0, 0, 1.0f));
+}
+
+const ShadeTiers Floor::SHADE_TIERS = { { 4.0f, 8.0f, 12.0f, 16.0f }, { '#', 'x', '-', '.' }, '.' };
+
+bool Floor::getPlaneShape(Plane& plane, ShadeTiers& tiers) const
+{
+    plane = this->plane;
+    tiers = SHADE_TIERS;
+    return true;
+}
+
+Glyph Floor::getCharByDistance(float depth, float distance)
+{
+    return SHADE_TIERS.shade(distance);
+}
+
+std::pair<float, Glyph> Floor::getIntersection(Line line, float depth)
+{
+    Glyph resChar = ' ';
+    std::pair<Vector3D, float> localRes = this->plane.getLineIntersection(line);
+    resChar = this->getCharByDistance(16.0f, localRes.second);
+    return { sqrtf(localRes.second), resChar };
+}
+
+
+Ceiling::Ceiling(Color color): GameObject(Vector3D(0, 0, 0), 'x', color, 0.0f)
+{
+    this->plane = Plane(Vector3D(0, 0, 5.0f), Vector3D(0, 0, 1.0f));
+}
+
+const ShadeTiers Ceiling::SHADE_TIERS = { { 2.0f, 4.0f, 6.0f, 8.0f }, { '#', 'x', '-', '.' }, '.' };
+
+bool Ceiling::getPlaneShape(Plane& plane, ShadeTiers& tiers) const
+{
+    plane = this->plane;
+    tiers = SHADE_TIERS;
+    return true;
+}
+
+Glyph Ceiling::getCharByDistance(float depth, float distance)
+{
+    return SHADE_TIERS.shade(distance);
+}
+
+std::pair<float, Glyph> Ceiling::getIntersection(Line line, float depth)
+{
+    Glyph resChar = ' ';
+    std::pair<Vector3D, float> localRes = this->plane.getLineIntersection(line);
+    resChar = this->getCharByDistance(16.0f, localRes.second);
+    return { sqrtf(localRes.second), resChar };
+}
+
+
+Player::Player(): GameObject()
+{
+    this->fAngle = 0.0;
+    this->fRotationSpeed = 0.0f;
+}
+
+Player::Player(Vector3D centerPos, float speed): GameObject(centerPos, ' ', 0, speed)
+{
+    this->fAngle = 0.0;
+    this->fRotationSpeed = 0.5f;
+}
+
+std::pair<float, Glyph> Player::getIntersection(Line line, float depth)
+{
+    return { -1, ' ' };
+}
+
+Glyph Player::getCharByDistance(float depth, float distance)
+{
+    return ' ';
+}
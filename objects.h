@@ -0,0 +1,213 @@
+#ifndef OBJECTS_H
+#define OBJECTS_H
+
+#include <vector>
+#include "geometry.h"
+#include "packet.h"
+
+/*
+    Scene objects shared by the game and the headless renderer.
+    Nothing in here depends on the platform console API.
+*/
+
+// 1 map square is MAP_WORLD_RATION worlds' "squares"
+const int N_MAP_WORLD_RATIO = 5;
+const int N_SCREEN_WORLD_RATIO = 10;
+
+// Character written to a screen cell (UCS-2 code point)
+typedef wchar_t Glyph;
+
+// Color attribute of a screen cell, bit-compatible with Win32 console attributes
+typedef unsigned short Color;
+
+const Color COLOR_BLUE      = 0x0001;
+const Color COLOR_GREEN     = 0x0002;
+const Color COLOR_RED       = 0x0004;
+const Color COLOR_INTENSITY = 0x0008;
+
+// Characters picked by distance: the first tier is taken up to and including its limit,
+// the others below their limit, fFar past the last one
+struct ShadeTiers
+{
+    float fLimits[4];
+    Glyph wChars[4];
+    Glyph wFar;
+
+    Glyph shade(float distance) const
+    {
+        if (distance <= fLimits[0])     { return wChars[0]; }
+        else if (distance < fLimits[1]) { return wChars[1]; }
+        else if (distance < fLimits[2]) { return wChars[2]; }
+        else if (distance < fLimits[3]) { return wChars[3]; }
+        return wFar;
+    }
+};
+
+class GameObject
+{
+protected:
+    Vector3D v3CenterWorldPos;           // Center of the object
+    float fMapPos[2];                    // Position in map coordinates
+    Glyph wChar;
+    Color wPixelColor;
+    float fSpeed;
+
+public:
+    GameObject();
+
+    GameObject(Vector3D centerPos, Glyph objectChar, Color color, float speed);
+
+    virtual ~GameObject() {}
+
+    Vector3D getCenterPos() const { return this->v3CenterWorldPos; }
+
+    Glyph getChar() const { return this->wChar; }
+
+    Color getPixelColor() const { return this->wPixelColor; }
+
+    float getSpeed() const { return this->fSpeed; }
+
+    virtual void setCenterPos(Vector3D centerPos);
+
+    virtual void move(Vector3D direction, float dt);
+
+    // Writes axis-aligned bounds of the object, returns false if the object is unbounded
+    virtual bool getBounds(Vector3D& /*minCorner*/, Vector3D& /*maxCorner*/) const { return false; }
+
+    // True if getIntersection is the plain box test boxkernel.h repeats, so the
+    //     object can be intersected by a box kernel from its bounds alone
+    virtual bool isBox() const { return false; }
+
+    // Writes the plane and shade tiers of an infinite plane object, returns false for other objects
+    virtual bool getPlaneShape(Plane& /*plane*/, ShadeTiers& /*tiers*/) const { return false; }
+
+    // Returns distance to the closest point that belongs to object and lies on the line,
+    //     returns -1 if there is not points on the line
+    virtual std::pair<float, Glyph> getIntersection(Line line, float depth) = 0;
+
+    // Writes what getIntersection returns for every ray of the packet. The default calls it ray by ray,
+    //     objects that can test several rays at once override it
+    virtual void intersectPacket(const RayPacket& packet, float depth, std::pair<float, Glyph>* intersections);
+
+    virtual Glyph getCharByDistance(float depth, float distance) = 0;
+};
+
+class Cube: public GameObject
+{
+private:
+    float size;
+    Plane planes[6];  // Planes define cube
+    float fMinX, fMaxX;
+    float fMinY, fMaxY;
+    float fMinZ, fMaxZ;
+
+    // Recomputes planes and bounds around the current center
+    void updateBounds();
+
+public:
+    Cube(Vector3D centerPos, Glyph objectChar, Color color, float speed);
+
+    // Shade tiers for the given render depth
+    static ShadeTiers getShadeTiers(float depth);
+
+    void setCenterPos(Vector3D centerPos);
+
+    void move(Vector3D direction, float dt);
+
+    bool getBounds(Vector3D& minCorner, Vector3D& maxCorner) const;
+
+    bool isBox() const { return true; }
+
+    Glyph getCharByDistance(float depth, float distance);
+
+    std::pair<float, Glyph> getIntersection(Line line, float depth = 16.0f);
+
+    void intersectPacket(const RayPacket& packet, float depth, std::pair<float, Glyph>* intersections);
+};
+
+// Axis-aligned box of any size shaded like a Cube, e.g. a run of merged wall squares.
+//     Intersected with the same arithmetic as Cube, so box kernels find the same hits on it
+class Box: public GameObject
+{
+private:
+    Plane planes[6];
+    float fMin[3];
+    float fMax[3];
+
+    void updatePlanes();
+
+public:
+    Box(Vector3D minCorner, Vector3D maxCorner, Glyph objectChar, Color color);
+
+    void setCenterPos(Vector3D centerPos);
+
+    void move(Vector3D direction, float dt);
+
+    bool getBounds(Vector3D& minCorner, Vector3D& maxCorner) const;
+
+    bool isBox() const { return true; }
+
+    Glyph getCharByDistance(float depth, float distance);
+
+    std::pair<float, Glyph> getIntersection(Line line, float depth = 16.0f);
+
+    void intersectPacket(const RayPacket& packet, float depth, std::pair<float, Glyph>* intersections);
+};
+
+class Floor: public GameObject
+{
+private:
+    Plane plane;
+
+public:
+    Floor(Color color);
+
+    static const ShadeTiers SHADE_TIERS;
+
+    bool getPlaneShape(Plane& plane, ShadeTiers& tiers) const;
+
+    Glyph getCharByDistance(float depth, float distance);
+
+    std::pair<float, Glyph> getIntersection(Line line, float depth = 16.0f);
+};
+
+class Ceiling: public GameObject
+{
+private:
+    Plane plane;
+
+public:
+    Ceiling(Color color);
+
+    static const ShadeTiers SHADE_TIERS;
+
+    bool getPlaneShape(Plane& plane, ShadeTiers& tiers) const;
+
+    Glyph getCharByDistance(float depth, float distance);
+
+    std::pair<float, Glyph> getIntersection(Line line, float depth = 16.0f);
+};
+
+class Player: public GameObject
+{
+private:
+    float fAngle;
+    float fRotationSpeed;
+
+public:
+    Player();
+
+    Player(Vector3D centerPos, float speed);
+
+    float getAngle() const { return this->fAngle; }
+
+    void setAngle(float angle) { this->fAngle = angle; }
+
+    void rotateAngle(int dir, float dt) { this->fAngle += dir * this->fRotationSpeed * dt; }
+
+    std::pair<float, Glyph> getIntersection(Line line, float depth = 16.0f);
+
+    Glyph getCharByDistance(float depth, float distance);
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include "packet.h"
+
+// Widest direction interval, per component, a packet is still traced as a whole
+const float F_MAX_PACKET_SPREAD = 0.25f;
+// Direction components closer to 0 may belong to rays parallel to the axis
+const float F_PARALLEL_EPSILON = 1e-6f;
+
+
+void RayPacket::reset(Vector3D origin)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        this->fOrigin[i] = origin[i];
+    }
+    this->nCount = 0;
+}
+
+void RayPacket::add(const Line& line)
+{
+    Vector3D direction = line.getDirection();
+    int index = this->nCount++;
+    this->lines[index] = line;
+
+    // Copies of the ray fill its group of 4
+    int padded = std::min((this->nCount + 3) & ~3, N_MAX_PACKET_RAYS);
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float d = direction[axis];
+        unsigned int mask = fabs(d) < 1e-6 ? 0u : ~0u;     // Compared as double, like intersectBox does
+        for (int i = index; i < padded; i++)
+        {
+            this->fDirection[axis][i] = d;
+            this->nAxisMask[axis][i] = mask;
+        }
+
+        this->fDirMin[axis] = index == 0 ? d : std::min(this->fDirMin[axis], d);
+        this->fDirMax[axis] = index == 0 ? d : std::max(this->fDirMax[axis], d);
+    }
+}
+
+bool RayPacket::isCoherent() const
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (this->fDirMax[axis] - this->fDirMin[axis] > F_MAX_PACKET_SPREAD)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+float RayPacket::intersectBounds(const float boxMin[3], const float boxMax[3], float tLimit) const
+{
+    float tEnter = 0.0f;
+    float tExit = tLimit;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        // Some ray may be parallel to the slab or cross it anywhere, no bound on t from this axis
+        float dirMin = this->fDirMin[axis];
+        float dirMax = this->fDirMax[axis];
+        if (dirMin <= F_PARALLEL_EPSILON && dirMax >= -F_PARALLEL_EPSILON)
+        {
+            continue;
+        }
+
+        float margin = 1e-3f + 1e-5f * (fabsf(boxMin[axis]) + fabsf(boxMax[axis]));
+        float low = boxMin[axis] - margin - this->fOrigin[axis];
+        float high = boxMax[axis] + margin - this->fOrigin[axis];
+
+        // Directions don't change sign within the interval, so every ray's slab lies between these
+        float t1 = low / dirMin;
+        float t2 = low / dirMax;
+        float t3 = high / dirMin;
+        float t4 = high / dirMax;
+        tEnter = std::max(tEnter, std::min(std::min(t1, t2), std::min(t3, t4)));
+        tExit = std::min(tExit, std::max(std::max(t1, t2), std::max(t3, t4)));
+        if (tEnter > tExit)
+        {
+            return std::numeric_limits<float>::infinity();
+        }
+    }
+    return tEnter;
+}
@@ -0,0 +1,44 @@
+#ifndef PACKET_H
+#define PACKET_H
+
+#include "geometry.h"
+
+/*
+    Packet of primary rays from one origin, e.g. the rays of an 8x8 block of screen cells.
+    Directions are kept as structure of arrays, normalized exactly like Line does it, so
+    kernels running one ray per SIMD lane find the same hits as the single ray tests.
+    The packet also keeps the interval every direction component lies in. A box that no
+    direction of the interval can reach is missed by every ray of the packet, which lets
+    the renderer skip objects and BVH nodes for the whole packet with one test.
+*/
+
+const int N_PACKET_SIZE = 8;                                    // Packets cover N_PACKET_SIZE x N_PACKET_SIZE cells
+const int N_MAX_PACKET_RAYS = N_PACKET_SIZE * N_PACKET_SIZE;
+
+struct RayPacket
+{
+    float fOrigin[3];
+    // Padded to a multiple of 4 with copies of the last ray, so kernels may read whole groups of 4
+    float fDirection[3][N_MAX_PACKET_RAYS];
+    // All bits set where the ray isn't parallel to the axis (|direction| >= 1e-6), like in Plane
+    unsigned int nAxisMask[3][N_MAX_PACKET_RAYS];
+    float fDirMin[3];
+    float fDirMax[3];
+    Line lines[N_MAX_PACKET_RAYS];
+    int nCount = 0;
+
+    // Empties the packet, all rays added later have to start at origin
+    void reset(Vector3D origin);
+
+    void add(const Line& line);
+
+    // Rays spread over too wide a cone to be culled together are traced one by one
+    bool isCoherent() const;
+
+    // Returns a lower bound of the ray parameter at which rays of the packet enter the box, or infinity
+    //     if none of them can hit it with 0 < t < tLimit. Bounds are widened a bit, so rounding in the
+    //     exact tests never makes a culled box a hit
+    float intersectBounds(const float boxMin[3], const float boxMax[3], float tLimit) const;
+};
+
+#endif
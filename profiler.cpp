@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <algorithm>
+#include "profiler.h"
+
+// std::min takes it by reference
+const int Profiler::N_WINDOW;
+
+Profiler::Profiler(size_t maxFrames)
+{
+    this->nOrigin = getProfileTime();
+    this->nMaxFrames = maxFrames;
+    this->frames.reserve(maxFrames * STAGE_COUNT);
+    this->frameStarts.reserve(maxFrames);
+    this->events.reserve(maxFrames * STAGE_COUNT);
+
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        this->current[i] = 0;
+        this->summed[i].store(0);
+        for (int j = 0; j < N_WINDOW; j++)
+        {
+            this->window[i][j] = 0;
+        }
+    }
+}
+
+const char* Profiler::getStageName(ProfileStage stage)
+{
+    switch (stage)
+    {
+        case STAGE_FRAME:           return "frame";
+        case STAGE_INPUT:           return "input";
+        case STAGE_UPDATE:          return "update";
+        case STAGE_RENDER:          return "render";
+        case STAGE_RAY_GENERATION:  return "ray generation";
+        case STAGE_INTERSECTION:    return "intersection";
+        case STAGE_SHADING:         return "shading";
+        case STAGE_SPRITES:         return "sprites";
+        case STAGE_OVERLAY:         return "overlay";
+        case STAGE_PRESENT:         return "present";
+        default:                    return "?";
+    }
+}
+
+void Profiler::record(ProfileStage stage, ProfileTime start, ProfileTime end)
+{
+    this->current[stage] += end - start;
+
+    if (this->frameStarts.size() < this->nMaxFrames)
+    {
+        TraceEvent event = { stage, start - this->nOrigin, end - start };
+        this->events.push_back(event);
+    }
+}
+
+void Profiler::endFrame(ProfileTime frameStart)
+{
+    this->record(STAGE_FRAME, frameStart, getProfileTime());
+
+    bool keep = this->frameStarts.size() < this->nMaxFrames;
+    if (keep)
+    {
+        this->frameStarts.push_back(frameStart - this->nOrigin);
+    }
+
+    int slot = this->nFrame % N_WINDOW;
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        ProfileTime time = this->current[i] + this->summed[i].exchange(0);
+        this->window[i][slot] = time;
+        if (keep)
+        {
+            this->frames.push_back(time);
+        }
+        this->current[i] = 0;
+    }
+
+    this->nFrame++;
+    this->nWindowFrames = std::min(this->nWindowFrames + 1, N_WINDOW);
+}
+
+ProfileTime Profiler::getMean(ProfileStage stage) const
+{
+    if (this->nWindowFrames == 0)
+    {
+        return 0;
+    }
+
+    ProfileTime total = 0;
+    for (int i = 0; i < this->nWindowFrames; i++)
+    {
+        total += this->window[stage][i];
+    }
+    return total / this->nWindowFrames;
+}
+
+ProfileTime Profiler::getPercentile(ProfileStage stage, int percentile) const
+{
+    if (this->nWindowFrames == 0)
+    {
+        return 0;
+    }
+
+    ProfileTime sorted[N_WINDOW];
+    std::copy(this->window[stage], this->window[stage] + this->nWindowFrames, sorted);
+    int index = (this->nWindowFrames - 1) * percentile / 100;
+    std::nth_element(sorted, sorted + index, sorted + this->nWindowFrames);
+    return sorted[index];
+}
+
+void Profiler::drawOverlay(Framebuffer& frame, int x, int y) const
+{
+    wchar_t line[64];
+    for (int i = 0; i < STAGE_COUNT && y + i < frame.nHeight; i++)
+    {
+        ProfileStage stage = (ProfileStage)i;
+        int length = swprintf(line, 64, L"%-14s %7.3f %7.3f", getStageName(stage),
+            this->getMean(stage) / 1e6, this->getPercentile(stage, 99) / 1e6);
+
+        for (int j = 0; j < length && x + j < frame.nWidth; j++)
+        {
+            frame.set(x + j, y + i, line[j], COLOR_GREEN | COLOR_INTENSITY);
+        }
+    }
+}
+
+bool Profiler::exportCsv(const std::string& path) const
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    fprintf(file, "frame,start_us");
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        fprintf(file, ",%s_us", getStageName((ProfileStage)i));
+    }
+    fprintf(file, "\n");
+
+    for (size_t f = 0; f < this->frameStarts.size(); f++)
+    {
+        fprintf(file, "%d,%.3f", (int)f, this->frameStarts[f] / 1e3);
+        for (int i = 0; i < STAGE_COUNT; i++)
+        {
+            fprintf(file, ",%.3f", this->frames[f * STAGE_COUNT + i] / 1e3);
+        }
+        fprintf(file, "\n");
+    }
+
+    fclose(file);
+    return true;
+}
+
+bool Profiler::exportChromeTrace(const std::string& path) const
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+
+    // Stages timed on the main thread as complete events
+    for (const TraceEvent& event: this->events)
+    {
+        fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+            first ? "" : ",\n", getStageName(event.stage), event.start / 1e3, event.duration / 1e3);
+        first = false;
+    }
+
+    // Stages summed over rows and threads as counters
+    const ProfileStage counters[] = { STAGE_RAY_GENERATION, STAGE_INTERSECTION, STAGE_SHADING };
+    for (size_t f = 0; f < this->frameStarts.size(); f++)
+    {
+        for (ProfileStage stage: counters)
+        {
+            fprintf(file, "%s{\"name\":\"%s (cpu us)\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"value\":%.3f}}",
+                first ? "" : ",\n", getStageName(stage), this->frameStarts[f] / 1e3, this->frames[f * STAGE_COUNT + stage] / 1e3);
+            first = false;
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+}
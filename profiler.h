@@ -0,0 +1,115 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "framebuffer.h"
+
+/*
+    Frame-time profiler.
+    Stages are timed with ScopedTimer (or summed by the caller and added with addTime) and
+    every frame the time of each stage goes into a rolling window for the overlay and into
+    a per-frame record that can be exported as CSV or as Chrome trace JSON (chrome://tracing).
+    Timing a stage costs two steady_clock reads; with no profiler set nothing is timed.
+*/
+
+enum ProfileStage
+{
+    STAGE_FRAME,
+    STAGE_INPUT,
+    STAGE_UPDATE,
+    STAGE_RENDER,
+    STAGE_RAY_GENERATION,   // Summed over rows and threads
+    STAGE_INTERSECTION,     // Summed over rows and threads
+    STAGE_SHADING,          // Summed over rows and threads
+    STAGE_SPRITES,          // Sprites drawn over the rendered frame
+    STAGE_OVERLAY,          // Map and stats drawn over the frame
+    STAGE_PRESENT,          // Writing the frame to the console
+    STAGE_COUNT
+};
+
+typedef long long ProfileTime;  // Nanoseconds
+
+inline ProfileTime getProfileTime()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class Profiler
+{
+private:
+    static const int N_WINDOW = 128;    // Frames kept for the overlay statistics
+
+    struct TraceEvent
+    {
+        ProfileStage stage;
+        ProfileTime start;
+        ProfileTime duration;
+    };
+
+    ProfileTime nOrigin;
+    ProfileTime current[STAGE_COUNT];               // Time of every stage in the frame being recorded
+    std::atomic<ProfileTime> summed[STAGE_COUNT];   // Times added from worker threads
+    ProfileTime window[STAGE_COUNT][N_WINDOW];
+    int nWindowFrames = 0;
+    int nFrame = 0;
+
+    size_t nMaxFrames;
+    std::vector<ProfileTime> frames;        // STAGE_COUNT times per recorded frame
+    std::vector<ProfileTime> frameStarts;
+    std::vector<TraceEvent> events;         // Timed stages of the recorded frames
+
+public:
+    // Keeps per-frame records of up to maxFrames frames for export, memory is reserved up front
+    explicit Profiler(size_t maxFrames = 10000);
+
+    static const char* getStageName(ProfileStage stage);
+
+    // Records a stage that ran from start to end, call from the thread that calls endFrame
+    void record(ProfileStage stage, ProfileTime start, ProfileTime end);
+
+    // Adds time to a stage, can be called from any thread
+    void addTime(ProfileStage stage, ProfileTime duration) { this->summed[stage].fetch_add(duration, std::memory_order_relaxed); }
+
+    // Closes the frame that started at frameStart
+    void endFrame(ProfileTime frameStart);
+
+    // Statistics of the last frames in the window, in nanoseconds
+    ProfileTime getMean(ProfileStage stage) const;
+
+    ProfileTime getPercentile(ProfileStage stage, int percentile) const;
+
+    // Draws one line per stage with mean / p99 in milliseconds, starting at row y
+    void drawOverlay(Framebuffer& frame, int x, int y) const;
+
+    // One row per recorded frame, one column per stage in microseconds
+    bool exportCsv(const std::string& path) const;
+
+    bool exportChromeTrace(const std::string& path) const;
+};
+
+class ScopedTimer
+{
+private:
+    Profiler* profiler;
+    ProfileStage stage;
+    ProfileTime start;
+
+public:
+    ScopedTimer(Profiler* profiler, ProfileStage stage): profiler(profiler), stage(stage)
+    {
+        this->start = profiler != nullptr ? getProfileTime() : 0;
+    }
+
+    ~ScopedTimer()
+    {
+        if (this->profiler != nullptr)
+        {
+            this->profiler->record(this->stage, this->start, getProfileTime());
+        }
+    }
+};
+
+#endif
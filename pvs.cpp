@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <math.h>
+#include "pvs.h"
+
+// Boxes are shrunk by this many squares, so lines along a wall face or through a corner where two walls meet
+//     are never taken as blocked, whatever the renderer's rounding makes of them
+const float F_PVS_MARGIN = 0.01f;
+
+
+template<typename Visit>
+bool PvsTable::walkBoxes(const float from[2], const float to[2], Visit visit) const
+{
+    // Squares are centered on their integer coordinates
+    const float fInf = std::numeric_limits<float>::infinity();
+    int square[2];
+    int step[2];
+    float tNext[2];
+    float tDelta[2];
+    for (int axis = 0; axis < 2; axis++)
+    {
+        float d = to[axis] - from[axis];
+        square[axis] = (int)floorf(from[axis] + 0.5f);
+        step[axis] = d > 0.0f ? 1 : -1;
+        tNext[axis] = d == 0.0f ? fInf : (square[axis] + 0.5f * step[axis] - from[axis]) / d;
+        tDelta[axis] = d == 0.0f ? fInf : 1.0f / fabsf(d);
+    }
+
+    // A segment passes the squares of a box one after another
+    int lastBox = -1;
+    while (true)
+    {
+        if (square[0] >= 0 && square[0] < this->nWidth && square[1] >= 0 && square[1] < this->nHeight)
+        {
+            int box = this->squareBoxes[(size_t)square[1] * this->nWidth + square[0]];
+            if (box >= 0 && box != lastBox)
+            {
+                lastBox = box;
+                if (visit(box))
+                {
+                    return true;
+                }
+            }
+        }
+
+        if (tNext[0] > 1.0f && tNext[1] > 1.0f)
+        {
+            return false;
+        }
+        int axis = tNext[0] < tNext[1] ? 0 : 1;
+        square[axis] += step[axis];
+        tNext[axis] += tDelta[axis];
+    }
+}
+
+bool PvsTable::crossesBox(const float from[2], const float to[2], int box) const
+{
+    const WallRect& rect = this->boxes[box];
+    float boxMin[2] = { rect.nX - 0.5f + F_PVS_MARGIN, rect.nY - 0.5f + F_PVS_MARGIN };
+    float boxMax[2] = { rect.nX + rect.nWidth - 0.5f - F_PVS_MARGIN, rect.nY + rect.nHeight - 0.5f - F_PVS_MARGIN };
+
+    float tEnter = 0.0f;
+    float tExit = 1.0f;
+    for (int axis = 0; axis < 2; axis++)
+    {
+        float d = to[axis] - from[axis];
+        if (d == 0.0f)
+        {
+            if (from[axis] <= boxMin[axis] || from[axis] >= boxMax[axis])
+            {
+                return false;
+            }
+            continue;
+        }
+
+        float t1 = (boxMin[axis] - from[axis]) / d;
+        float t2 = (boxMax[axis] - from[axis]) / d;
+        tEnter = std::max(tEnter, std::min(t1, t2));
+        tExit = std::min(tExit, std::max(t1, t2));
+    }
+    return tEnter < tExit;
+}
+
+bool PvsTable::isClear(const float from[2], const float to[2], int target) const
+{
+    return !this->walkBoxes(from, to, [&](int box) { return box != target && this->crossesBox(from, to, box); });
+}
+
+bool PvsTable::isBundleVisible(const float source[4], const float target[4], int box, int splits) const
+{
+    float sourceMid[2] = { (source[0] + source[2]) * 0.5f, (source[1] + source[3]) * 0.5f };
+    float targetMid[2] = { (target[0] + target[2]) * 0.5f, (target[1] + target[3]) * 0.5f };
+    if (this->isClear(sourceMid, targetMid, box))
+    {
+        return true;
+    }
+
+    // A convex box crossed by all four corner lines is crossed by every line of the bundle
+    const float* s0 = source;
+    const float* s1 = source + 2;
+    const float* t0 = target;
+    const float* t1 = target + 2;
+    bool blocked = this->walkBoxes(s0, t0, [&](int other)
+        {
+            return other != box && this->crossesBox(s0, t0, other) && this->crossesBox(s0, t1, other) &&
+                this->crossesBox(s1, t0, other) && this->crossesBox(s1, t1, other);
+        });
+    if (blocked)
+    {
+        return false;
+    }
+    if (splits == 0)
+    {
+        return true;
+    }
+
+    // Split the longer end
+    float sourceLength = (source[2] - source[0]) * (source[2] - source[0]) + (source[3] - source[1]) * (source[3] - source[1]);
+    float targetLength = (target[2] - target[0]) * (target[2] - target[0]) + (target[3] - target[1]) * (target[3] - target[1]);
+    if (sourceLength >= targetLength)
+    {
+        float first[4] = { source[0], source[1], sourceMid[0], sourceMid[1] };
+        float second[4] = { sourceMid[0], sourceMid[1], source[2], source[3] };
+        return this->isBundleVisible(first, target, box, splits - 1) || this->isBundleVisible(second, target, box, splits - 1);
+    }
+    float first[4] = { target[0], target[1], targetMid[0], targetMid[1] };
+    float second[4] = { targetMid[0], targetMid[1], target[2], target[3] };
+    return this->isBundleVisible(source, first, box, splits - 1) || this->isBundleVisible(source, second, box, splits - 1);
+}
+
+bool PvsTable::build(const MapFile& map, const std::vector<WallRect>& wallBoxes)
+{
+    this->clear();
+    int width = map.getWidth();
+    int height = map.getHeight();
+    long long openSquares = (long long)width * height - map.getWallCount();
+    if (wallBoxes.empty() || openSquares * (long long)wallBoxes.size() > N_MAX_PVS_PAIRS)
+    {
+        return false;
+    }
+
+    this->nWidth = width;
+    this->nHeight = height;
+    this->nBoxCount = (int)wallBoxes.size();
+    this->nWords = (this->nBoxCount + 63) / 64;
+    this->boxes = wallBoxes;
+    this->squareBoxes.assign((size_t)width * height, -1);
+    for (int i = 0; i < this->nBoxCount; i++)
+    {
+        const WallRect& rect = wallBoxes[i];
+        for (int y = rect.nY; y < rect.nY + rect.nHeight; y++)
+        {
+            for (int x = rect.nX; x < rect.nX + rect.nWidth; x++)
+            {
+                this->squareBoxes[(size_t)y * width + x] = i;
+            }
+        }
+    }
+
+    // A line from inside a square or box can be extended within it until it meets one of its diagonals,
+    //     so lines between the diagonals stand for all lines between the square and the box
+    this->squareSets.assign((size_t)width * height, -1);
+    std::map<std::vector<unsigned long long>, int> setIndices;
+    std::vector<unsigned long long> set(this->nWords);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            if (map.getCell(x, y) == '#')
+            {
+                continue;
+            }
+
+            std::fill(set.begin(), set.end(), 0ull);
+            float squareDiagonals[2][4] = { { x - 0.5f, y - 0.5f, x + 0.5f, y + 0.5f }, { x - 0.5f, y + 0.5f, x + 0.5f, y - 0.5f } };
+            for (int box = 0; box < this->nBoxCount; box++)
+            {
+                const WallRect& rect = wallBoxes[box];
+                float left = rect.nX - 0.5f;
+                float right = rect.nX + rect.nWidth - 0.5f;
+                float top = rect.nY - 0.5f;
+                float bottom = rect.nY + rect.nHeight - 0.5f;
+                float boxDiagonals[2][4] = { { left, top, right, bottom }, { left, bottom, right, top } };
+
+                bool visible = false;
+                for (int i = 0; i < 4 && !visible; i++)
+                {
+                    visible = this->isBundleVisible(squareDiagonals[i >> 1], boxDiagonals[i & 1], box, N_MAX_PVS_SPLITS);
+                }
+                if (visible)
+                {
+                    set[box >> 6] |= 1ull << (box & 63);
+                }
+            }
+
+            auto found = setIndices.emplace(set, this->nSetCount);
+            if (found.second)
+            {
+                this->sets.insert(this->sets.end(), set.begin(), set.end());
+                this->nSetCount++;
+            }
+            this->squareSets[(size_t)y * width + x] = found.first->second;
+        }
+    }
+
+    std::vector<WallRect>().swap(this->boxes);
+    std::vector<int>().swap(this->squareBoxes);
+    return true;
+}
+
+void PvsTable::clear()
+{
+    this->nWidth = 0;
+    this->nHeight = 0;
+    this->nBoxCount = 0;
+    this->nWords = 0;
+    this->nSetCount = 0;
+    std::vector<int>().swap(this->squareSets);
+    std::vector<unsigned long long>().swap(this->sets);
+    std::vector<WallRect>().swap(this->boxes);
+    std::vector<int>().swap(this->squareBoxes);
+}
+
+const unsigned long long* PvsTable::getSet(int squareX, int squareY) const
+{
+    if (!this->isBuilt() || squareX < 0 || squareX >= this->nWidth || squareY < 0 || squareY >= this->nHeight)
+    {
+        return nullptr;
+    }
+    int set = this->squareSets[(size_t)squareY * this->nWidth + squareX];
+    return set < 0 ? nullptr : this->sets.data() + (size_t)set * this->nWords;
+}
@@ -0,0 +1,73 @@
+#ifndef PVS_H
+#define PVS_H
+
+#include <vector>
+#include "mapfile.h"
+#include "wallmesh.h"
+
+/*
+    Potentially visible sets of wall boxes, one per open map square.
+    Walls are full height boxes standing on the floor, so from an eye between the floor and
+    the ceiling a wall is hidden exactly when every line to it in the map plane is blocked by
+    other walls. The set of a square holds every wall box some line from anywhere in the
+    square reaches. Lines are tested in bundles: a bundle from a part of the square to a part
+    of the box is visible if its middle line is clear, hidden if a single box blocks all of its
+    corner lines, and split in half otherwise. Bundles still undecided after N_MAX_PVS_SPLITS
+    splits count as visible, so the sets may hold a hidden box but never miss a visible one.
+    Sets are bitsets over the boxes in object order; squares with the same set share it.
+*/
+
+const int N_MAX_PVS_PAIRS = 1 << 22;    // Open squares times wall boxes of the largest map that gets sets
+const int N_MAX_PVS_SPLITS = 10;
+
+class PvsTable
+{
+private:
+    int nWidth = 0;
+    int nHeight = 0;
+    int nBoxCount = 0;
+    int nWords = 0;                         // 64 bit words per set
+    std::vector<int> squareSets;            // Set index of every square, -1 for walls
+    std::vector<unsigned long long> sets;
+    int nSetCount = 0;
+
+    // Built from the boxes for the build only
+    std::vector<WallRect> boxes;
+    std::vector<int> squareBoxes;           // Box of every wall square, -1 for open squares
+
+    // Calls visit(box) for the wall boxes of the squares the segment passes, stops when it returns true
+    template<typename Visit>
+    bool walkBoxes(const float from[2], const float to[2], Visit visit) const;
+
+    // True if the segment passes through the inside of the box
+    bool crossesBox(const float from[2], const float to[2], int box) const;
+
+    // True if the segment reaches the target box without passing through any other box
+    bool isClear(const float from[2], const float to[2], int target) const;
+
+    // True if some line from segment source to segment target reaches the target box, see above
+    bool isBundleVisible(const float source[4], const float target[4], int box, int splits) const;
+
+public:
+    // Builds the sets of a map whose wall boxes are boxes, in object order. Maps with more than
+    //     N_MAX_PVS_PAIRS open squares times boxes get no sets; returns false then
+    bool build(const MapFile& map, const std::vector<WallRect>& wallBoxes);
+
+    void clear();
+
+    bool isBuilt() const { return this->nWords > 0; }
+
+    int getBoxCount() const { return this->nBoxCount; }
+
+    // Distinct sets, squares with the same set share one
+    int getSetCount() const { return this->nSetCount; }
+
+    size_t getBytesUsed() const { return this->sets.size() * sizeof(unsigned long long) + this->squareSets.size() * sizeof(int); }
+
+    // Set of the square, nullptr if there are no sets, the square is a wall or is outside of the map
+    const unsigned long long* getSet(int squareX, int squareY) const;
+
+    static bool contains(const unsigned long long* set, int box) { return (set[box >> 6] >> (box & 63)) & 1; }
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <math.h>
+#include "raycast.h"
+
+const int N_QUERIES_PER_JOB = 64;
+// Segments end this much short of their target point, so a target on a surface doesn't block itself
+const float F_SIGHT_MARGIN = 1e-3f;
+
+
+RayCaster::RayCaster()
+{
+    this->pool = nullptr;
+    this->setBoxKernel(getBestBoxKernel());
+}
+
+void RayCaster::setBoxKernel(BoxKernelType type)
+{
+    this->boxKernelType = isBoxKernelSupported(type) ? type : BOX_KERNEL_NONE;
+    this->boxKernel = getBoxKernel(this->boxKernelType);
+}
+
+RayQueryHit RayCaster::cast(const World& world, const RayQuery& query) const
+{
+    RayQueryHit hit = { nullptr, -1, query.fMaxDistance, false };
+    Vector3D direction(query.fDirection[0], query.fDirection[1], query.fDirection[2]);
+    if (!(query.fMaxDistance > 0.0f) || (direction[0] == 0.0f && direction[1] == 0.0f && direction[2] == 0.0f))
+    {
+        return hit;
+    }
+
+    // Objects and the grid report the square root of the distance
+    Line ray(Vector3D(query.fOrigin[0], query.fOrigin[1], query.fOrigin[2]), direction);
+    float depth = sqrtf(query.fMaxDistance);
+
+    std::pair<float, Glyph> intersection;
+    int index;
+    float nearest = depth;
+    GameObject* obj = world.getBvh().findNearestHit(ray, depth, this->boxKernel, intersection, &index);
+    if (obj != nullptr)
+    {
+        hit = { obj, index, intersection.first * intersection.first, true };
+        nearest = intersection.first;
+    }
+
+    // Walls of large maps are only in the grid. They come before all other objects, so they win ties
+    if (!world.hasWallObjects())
+    {
+        GameObject* wall;
+        if (world.getGrid().findFirstHit(ray, depth, intersection, wall) && intersection.first <= nearest)
+        {
+            hit = { wall, -1, intersection.first * intersection.first, true };
+        }
+    }
+    return hit;
+}
+
+bool RayCaster::isVisible(const World& world, const SightQuery& query) const
+{
+    RayQuery ray;
+    float length = 0.0f;
+    for (int i = 0; i < 3; i++)
+    {
+        ray.fOrigin[i] = query.fFrom[i];
+        ray.fDirection[i] = query.fTo[i] - query.fFrom[i];
+        length += ray.fDirection[i] * ray.fDirection[i];
+    }
+    ray.fMaxDistance = sqrtf(length) - F_SIGHT_MARGIN;
+    return !this->cast(world, ray).bHit;
+}
+
+void RayCaster::runBlocks(int count, const JobFunction& fn) const
+{
+    int jobCount = (count + N_QUERIES_PER_JOB - 1) / N_QUERIES_PER_JOB;
+    if (this->pool == nullptr)
+    {
+        for (int i = 0; i < jobCount; i++)
+        {
+            fn(i);
+        }
+        return;
+    }
+    this->pool->run(jobCount, fn);
+}
+
+void RayCaster::castAll(const World& world, const RayQuery* queries, int count, RayQueryHit* hits) const
+{
+    this->runBlocks(count, [&](int job)
+        {
+            int end = std::min(count, (job + 1) * N_QUERIES_PER_JOB);
+            for (int i = job * N_QUERIES_PER_JOB; i < end; i++)
+            {
+                hits[i] = this->cast(world, queries[i]);
+            }
+        });
+}
+
+void RayCaster::checkAll(const World& world, const SightQuery* queries, int count, bool* visible) const
+{
+    this->runBlocks(count, [&](int job)
+        {
+            int end = std::min(count, (job + 1) * N_QUERIES_PER_JOB);
+            for (int i = job * N_QUERIES_PER_JOB; i < end; i++)
+            {
+                visible[i] = this->isVisible(world, queries[i]);
+            }
+        });
+}
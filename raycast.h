@@ -0,0 +1,75 @@
+#ifndef RAYCAST_H
+#define RAYCAST_H
+
+#include "geometry.h"
+#include "objects.h"
+#include "boxkernel.h"
+#include "threadpool.h"
+#include "world.h"
+
+/*
+    Ray queries for game logic: hitscan shots, AI line of sight and visibility checks.
+    Queries are arbitrary rays, cast in batches through the same structures the renderer
+    uses: the world's BVH and, on maps whose walls are only in the map cells, the grid. So a
+    query costs about as much as a primary ray in BVH mode, however many objects the world has.
+    Batches are split into blocks of queries that run on the thread pool; the world must not
+    change while a batch runs. Results are the same on any number of threads and with any box kernel.
+    Distances are world units along the ray. Origins should lie outside of objects: a ray
+    starting inside a cube hits its far face.
+*/
+
+struct RayQuery
+{
+    float fOrigin[3];
+    float fDirection[3];    // Needn't be normalized
+    float fMaxDistance;     // Hits farther away are ignored
+};
+
+struct RayQueryHit
+{
+    GameObject* object;     // nullptr if nothing was hit, or a wall without an object was hit
+    int nObject;            // Index of object in World::getObjects(), -1 if object is nullptr
+    float fDistance;        // To the hit, fMaxDistance if nothing was hit
+    bool bHit;
+};
+
+// Is anything between two points?
+struct SightQuery
+{
+    float fFrom[3];
+    float fTo[3];
+};
+
+class RayCaster
+{
+private:
+    ThreadPool* pool;
+    BoxKernelType boxKernelType;
+    BoxKernel boxKernel;
+
+    // Calls fn(job) for every block of the count queries, on the pool if there is one
+    void runBlocks(int count, const JobFunction& fn) const;
+
+public:
+    RayCaster();
+
+    // Batches run as jobs on the pool, nullptr runs them on the calling thread only
+    void setThreadPool(ThreadPool* threadPool) { this->pool = threadPool; }
+
+    BoxKernelType getBoxKernelType() const { return this->boxKernelType; }
+
+    // Kernel used for boxes in BVH leaves, falls back to BOX_KERNEL_NONE if the CPU doesn't support it
+    void setBoxKernel(BoxKernelType type);
+
+    // Nearest hit along one ray. Walls without objects win ties; between coincident faces of objects either may be returned
+    RayQueryHit cast(const World& world, const RayQuery& query) const;
+
+    void castAll(const World& world, const RayQuery* queries, int count, RayQueryHit* hits) const;
+
+    // True if the segment between the points hits nothing short of its end
+    bool isVisible(const World& world, const SightQuery& query) const;
+
+    void checkAll(const World& world, const SightQuery* queries, int count, bool* visible) const;
+};
+
+#endif
@@ -0,0 +1,815 @@
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <limits>
+#include <math.h>
+#include "renderer.h"
+
+
+Renderer::Renderer(float fov, float depth): history(0, 0)
+{
+    this->fFov = fov;
+    this->fDepth = depth;
+    this->mode = RENDER_LINEAR;
+    this->pool = nullptr;
+    this->profiler = nullptr;
+    this->quality = QUALITY_FULL;
+    this->fTargetTime = 0.0f;
+    this->fRayCost = 0.0;
+    this->nRaysTraced = 0;
+    this->nFrame = 0;
+    this->bHistoryValid = false;
+    this->historyWorld = nullptr;
+    this->nHistoryRevision = 0;
+    this->bReprojection = false;
+    this->bPackets = false;
+    this->bVisibilityCulling = false;
+    this->candidates = nullptr;
+    this->nCandidates = 0;
+    this->columns = nullptr;
+    this->nSpritesDrawn = 0;
+    this->nSpriteCells = 0;
+    this->setBoxKernel(getBestBoxKernel());
+}
+
+const char* Renderer::getQualityName(RenderQuality quality)
+{
+    switch (quality)
+    {
+        case QUALITY_FULL:          return "full";
+        case QUALITY_CHECKERBOARD:  return "checkerboard";
+        case QUALITY_HALF:          return "half";
+        case QUALITY_QUARTER:       return "quarter";
+        default:                    return "?";
+    }
+}
+
+void Renderer::setBoxKernel(BoxKernelType type)
+{
+    this->boxKernelType = isBoxKernelSupported(type) ? type : BOX_KERNEL_NONE;
+    this->boxKernel = getBoxKernel(this->boxKernelType);
+}
+
+RayHit Renderer::traceRay(Line ray, const std::vector<GameObject*>& objects) const
+{
+    return this->traceObjects(ray, objects.data(), (int)objects.size());
+}
+
+RayHit Renderer::traceObjects(Line ray, GameObject* const* objects, int count) const
+{
+    RayHit hit = { this->fDepth, ' ', 0, nullptr }; // Init with depth limit
+    for (int i = 0; i < count; i++)
+    {
+        GameObject* obj = objects[i];
+        std::pair<float, Glyph> intersection = obj->getIntersection(ray, this->fDepth);
+
+        if (intersection.first > 0 && intersection.first < hit.fDistance)
+        {
+            hit.fDistance = intersection.first;
+            hit.wColor = obj->getPixelColor();
+            hit.wChar = intersection.second;
+            hit.object = obj;
+        }
+    }
+    return hit;
+}
+
+RayHit Renderer::traceRay(Line ray, const MapGrid& grid) const
+{
+    RayHit hit = { this->fDepth, ' ', 0, nullptr }; // Init with depth limit
+
+    std::pair<float, Glyph> intersection;
+    GameObject* obj;
+    if (grid.findFirstHit(ray, this->fDepth, intersection, obj))
+    {
+        hit.fDistance = intersection.first;
+        hit.wColor = grid.getWallColor();
+        hit.wChar = intersection.second;
+        hit.object = obj;
+    }
+
+    // Loose objects come after cubes in World's object list, so they only win if strictly closer
+    for (GameObject* loose: grid.getLooseObjects())
+    {
+        intersection = loose->getIntersection(ray, this->fDepth);
+
+        if (intersection.first > 0 && intersection.first < hit.fDistance)
+        {
+            hit.fDistance = intersection.first;
+            hit.wColor = loose->getPixelColor();
+            hit.wChar = intersection.second;
+            hit.object = loose;
+        }
+    }
+    return hit;
+}
+
+RayHit Renderer::traceRay(Line ray, const Bvh& bvh) const
+{
+    RayHit hit = { this->fDepth, ' ', 0, nullptr }; // Init with depth limit
+
+    std::pair<float, Glyph> intersection;
+    GameObject* obj = bvh.findNearestHit(ray, this->fDepth, this->boxKernel, intersection);
+    if (obj != nullptr)
+    {
+        hit.fDistance = intersection.first;
+        hit.wColor = obj->getPixelColor();
+        hit.wChar = intersection.second;
+        hit.object = obj;
+    }
+    return hit;
+}
+
+RayHit Renderer::traceRay(Line ray, const Scene& scene) const
+{
+    // The scene only knows object indices, traceRay(ray, world) looks the object up
+    SceneHit sceneHit = scene.findNearestHit(ray, this->fDepth, this->boxKernel);
+    RayHit hit = { sceneHit.fDistance, sceneHit.wChar, sceneHit.wColor, nullptr };
+    return hit;
+}
+
+RayHit Renderer::traceRay(Line ray, const World& world) const
+{
+    RayHit hit;
+    switch (this->mode)
+    {
+        case RENDER_GRID:
+        case RENDER_COLUMN: return this->traceRay(ray, world.getGrid());
+        case RENDER_BVH:   hit = this->traceRay(ray, world.getBvh()); break;
+        case RENDER_SCENE:
+        {
+            SceneHit sceneHit = world.getScene().findNearestHit(ray, this->fDepth, this->boxKernel);
+            hit = { sceneHit.fDistance, sceneHit.wChar, sceneHit.wColor,
+                sceneHit.nObject >= 0 ? world.getObjects()[sceneHit.nObject] : nullptr };
+            break;
+        }
+        default:           hit = this->traceObjects(ray, this->candidates, this->nCandidates); break;
+    }
+
+    this->traceGridWalls(ray, world, hit);
+    return hit;
+}
+
+void Renderer::traceGridWalls(Line ray, const World& world, RayHit& hit) const
+{
+    // Walls of large maps are only in the grid. They come before all other objects, so they win ties
+    if (!world.hasWallObjects())
+    {
+        std::pair<float, Glyph> intersection;
+        GameObject* obj;
+        const MapGrid& grid = world.getGrid();
+        if (grid.findFirstHit(ray, this->fDepth, intersection, obj) && intersection.first <= hit.fDistance)
+        {
+            hit = { intersection.first, intersection.second, grid.getWallColor(), obj };
+        }
+    }
+}
+
+void Renderer::tracePacket(const RayPacket& packet, const World& world, RayHit* hits) const
+{
+    if (!packet.isCoherent())
+    {
+        for (int i = 0; i < packet.nCount; i++)
+        {
+            hits[i] = this->traceRay(packet.lines[i], world);
+        }
+        return;
+    }
+
+    std::pair<float, Glyph> intersections[N_MAX_PACKET_RAYS];
+    if (this->mode == RENDER_BVH)
+    {
+        GameObject* objects[N_MAX_PACKET_RAYS];
+        world.getBvh().findNearestHits(packet, this->fDepth, objects, intersections);
+        for (int i = 0; i < packet.nCount; i++)
+        {
+            hits[i] = { this->fDepth, ' ', 0, nullptr }; // Init with depth limit
+            if (objects[i] != nullptr)
+            {
+                hits[i] = { intersections[i].first, intersections[i].second, objects[i]->getPixelColor(), objects[i] };
+            }
+        }
+    }
+    else
+    {
+        for (int i = 0; i < packet.nCount; i++)
+        {
+            hits[i] = { this->fDepth, ' ', 0, nullptr }; // Init with depth limit
+        }
+
+        // Objects later in the list only win if strictly closer, so the ones every ray sees past its hit are skipped.
+        //     Distances are square roots of the ray parameter, the slack covers rounding
+        const float fInf = std::numeric_limits<float>::infinity();
+        float tLimit = this->fDepth * this->fDepth * 1.0001f + 1e-4f;
+        for (int k = 0; k < this->nCandidates; k++)
+        {
+            GameObject* obj = this->candidates[k];
+            Vector3D minCorner, maxCorner;
+            if (obj->getBounds(minCorner, maxCorner))
+            {
+                float boxMin[3] = { minCorner[0], minCorner[1], minCorner[2] };
+                float boxMax[3] = { maxCorner[0], maxCorner[1], maxCorner[2] };
+                if (packet.intersectBounds(boxMin, boxMax, tLimit) == fInf)
+                {
+                    continue;
+                }
+            }
+
+            obj->intersectPacket(packet, this->fDepth, intersections);
+            bool changed = false;
+            for (int i = 0; i < packet.nCount; i++)
+            {
+                if (intersections[i].first > 0 && intersections[i].first < hits[i].fDistance)
+                {
+                    hits[i] = { intersections[i].first, intersections[i].second, obj->getPixelColor(), obj };
+                    changed = true;
+                }
+            }
+
+            if (changed)
+            {
+                float farthest = 0.0f;
+                for (int i = 0; i < packet.nCount; i++)
+                {
+                    farthest = std::max(farthest, hits[i].fDistance);
+                }
+                tLimit = farthest * farthest * 1.0001f + 1e-4f;
+            }
+        }
+    }
+
+    for (int i = 0; i < packet.nCount; i++)
+    {
+        this->traceGridWalls(packet.lines[i], world, hits[i]);
+    }
+}
+
+void Renderer::prepareCandidates(const World& world)
+{
+    const std::vector<GameObject*>& objects = world.getObjects();
+    this->candidates = objects.data();
+    this->nCandidates = (int)objects.size();
+    if (!this->bVisibilityCulling || this->mode != RENDER_LINEAR)
+    {
+        return;
+    }
+
+    // The sets only hold for eyes between the floor and the ceiling, where walls block lines in the map plane
+    Vector3D eye = this->camera.getPosition();
+    const PvsTable& pvs = world.getPvs();
+    const unsigned long long* set = nullptr;
+    if (eye[2] > 0.0f && eye[2] < (float)N_MAP_WORLD_RATIO)
+    {
+        set = pvs.getSet((int)floorf(eye[0] / N_MAP_WORLD_RATIO + 0.5f), (int)floorf(eye[1] / N_MAP_WORLD_RATIO + 0.5f));
+    }
+    if (set == nullptr)
+    {
+        return;
+    }
+
+    // Wall objects come first, the order is kept so ties go to the same object
+    GameObject** visible = this->frameArena.allocateArray<GameObject*>(objects.size());
+    int count = 0;
+    for (int i = 0; i < (int)objects.size(); i++)
+    {
+        if (i >= pvs.getBoxCount() || PvsTable::contains(set, i))
+        {
+            visible[count++] = objects[i];
+        }
+    }
+    this->candidates = visible;
+    this->nCandidates = count;
+}
+
+RayHit Renderer::traceCell(Line ray, int x, const World& world) const
+{
+    return this->mode == RENDER_COLUMN ? this->traceColumnRay(ray, x, world) : this->traceRay(ray, world);
+}
+
+void Renderer::prepareColumns(const World& world)
+{
+    const MapGrid& grid = world.getGrid();
+    const std::vector<GameObject*>& looseObjects = grid.getLooseObjects();
+    Vector3D eye = this->camera.getPosition();
+    int width = this->camera.getWidth();
+
+    this->columns = this->frameArena.allocateArray<ColumnView>(width);
+    this->columnObjects.clear();
+    this->wallTiers = Cube::getShadeTiers(this->fDepth);
+
+    // Pixel rays only differ from their column's direction by rounding, bounds are widened to cover it
+    const float fMargin = 0.05f;
+
+    for (int x = 0; x < width; x++)
+    {
+        ColumnView& column = this->columns[x];
+        Line ray(eye, this->camera.getColumnDirection(x));
+        int wallX, wallY;
+        column.bWall = grid.findFirstWall(ray, this->fDepth * this->fDepth, wallX, wallY, column.fWallEntry);
+        column.wall = column.bWall ? grid.getWallBox(wallX, wallY, column.fWallMin, column.fWallMax) : nullptr;
+
+        // Loose objects whose footprint the column's plane crosses in front of the camera, in list order
+        Vector3D direction = ray.getDirection();
+        column.nFirstObject = (int)this->columnObjects.size();
+        for (GameObject* obj: looseObjects)
+        {
+            Vector3D minCorner, maxCorner;
+            if (obj->getBounds(minCorner, maxCorner))
+            {
+                float tEnter = -std::numeric_limits<float>::infinity();
+                float tExit = std::numeric_limits<float>::infinity();
+                for (int i = 0; i < 2; i++)
+                {
+                    float low = minCorner[i] - fMargin;
+                    float high = maxCorner[i] + fMargin;
+                    if (fabsf(direction[i]) < 1e-6f)
+                    {
+                        if (eye[i] < low || eye[i] > high)
+                        {
+                            tExit = -1.0f;
+                        }
+                        continue;
+                    }
+                    float t1 = (low - eye[i]) / direction[i];
+                    float t2 = (high - eye[i]) / direction[i];
+                    tEnter = std::max(tEnter, std::min(t1, t2));
+                    tExit = std::min(tExit, std::max(t1, t2));
+                }
+                if (tExit < 0.0f || tEnter > tExit)
+                {
+                    continue;
+                }
+            }
+            this->columnObjects.push_back(obj);
+        }
+        column.nObjectCount = (int)this->columnObjects.size() - column.nFirstObject;
+    }
+}
+
+RayHit Renderer::traceColumnRay(Line ray, int x, const World& world) const
+{
+    const ColumnView& column = this->columns[x];
+    RayHit hit = { this->fDepth, ' ', 0, nullptr }; // Init with depth limit
+
+    // Every ray of the column reaches the column's first wall square, unless it hits the floor or ceiling first
+    if (column.bWall)
+    {
+        float tHit;
+        intersectBox(column.fWallMin, column.fWallMax, BoxRay(ray), (float)INT_MAX, tHit);
+        float distance = sqrtf(tHit);
+        if (distance > 0 && distance < this->fDepth)
+        {
+            hit = { distance, this->wallTiers.shade(tHit), world.getGrid().getWallColor(), column.wall };
+        }
+        else
+        {
+            // Rays that reach the square within the wall's height but miss its box by rounding go on to the walls
+            //     behind it, trace those the usual way
+            Vector3D origin = ray.getOwnPoint();
+            Vector3D direction = ray.getDirection();
+            float horizontal = sqrtf(direction[0] * direction[0] + direction[1] * direction[1]);
+            float z = origin[2] + direction[2] * column.fWallEntry / horizontal;
+            if (z > column.fWallMin[2] - 0.01f && z < column.fWallMax[2] + 0.01f)
+            {
+                return this->traceRay(ray, world.getGrid());
+            }
+        }
+    }
+
+    // Loose objects come after walls, so they only win if strictly closer
+    for (int i = column.nFirstObject; i < column.nFirstObject + column.nObjectCount; i++)
+    {
+        GameObject* obj = this->columnObjects[i];
+        std::pair<float, Glyph> intersection = obj->getIntersection(ray, this->fDepth);
+        if (intersection.first > 0 && intersection.first < hit.fDistance)
+        {
+            hit = { intersection.first, intersection.second, obj->getPixelColor(), obj };
+        }
+    }
+    return hit;
+}
+
+void Renderer::renderRow(int y, int first, int step, const World& world, Framebuffer& frame) const
+{
+    // Rays are generated, traced and written in chunks, so each step can be timed with few clock reads
+    const int N_CHUNK = 64;
+    Line rays[N_CHUNK];
+    RayHit hits[N_CHUNK];
+    ProfileTime generationTime = 0;
+    ProfileTime intersectionTime = 0;
+    ProfileTime shadingTime = 0;
+
+    int cellCount = first < frame.nWidth ? (frame.nWidth - 1 - first) / step + 1 : 0;
+    for (int chunk = 0; chunk < cellCount; chunk += N_CHUNK)
+    {
+        int count = std::min(N_CHUNK, cellCount - chunk);
+        int x = first + chunk * step;
+        ProfileTime time1 = this->profiler != nullptr ? getProfileTime() : 0;
+
+        for (int i = 0; i < count; i++)
+        {
+            rays[i] = this->camera.getRay(x + i * step, y);
+        }
+        ProfileTime time2 = this->profiler != nullptr ? getProfileTime() : 0;
+
+        // Find nearest seen objects
+        for (int i = 0; i < count; i++)
+        {
+            hits[i] = this->traceCell(rays[i], x + i * step, world);
+        }
+        ProfileTime time3 = this->profiler != nullptr ? getProfileTime() : 0;
+
+        for (int i = 0; i < count; i++)
+        {
+            frame.set(x + i * step, y, hits[i].wChar, hits[i].wColor, hits[i].fDistance * hits[i].fDistance);
+        }
+
+        if (this->profiler != nullptr)
+        {
+            ProfileTime time4 = getProfileTime();
+            generationTime += time2 - time1;
+            intersectionTime += time3 - time2;
+            shadingTime += time4 - time3;
+        }
+    }
+
+    if (this->profiler != nullptr)
+    {
+        this->profiler->addTime(STAGE_RAY_GENERATION, generationTime);
+        this->profiler->addTime(STAGE_INTERSECTION, intersectionTime);
+        this->profiler->addTime(STAGE_SHADING, shadingTime);
+    }
+}
+
+void Renderer::renderPacketRow(int y, const World& world, Framebuffer& frame) const
+{
+    RayPacket packet;
+    RayHit hits[N_MAX_PACKET_RAYS];
+    ProfileTime generationTime = 0;
+    ProfileTime intersectionTime = 0;
+    ProfileTime shadingTime = 0;
+
+    int rowCount = std::min(N_PACKET_SIZE, frame.nHeight - y);
+    for (int x = 0; x < frame.nWidth; x += N_PACKET_SIZE)
+    {
+        int columnCount = std::min(N_PACKET_SIZE, frame.nWidth - x);
+        ProfileTime time1 = this->profiler != nullptr ? getProfileTime() : 0;
+
+        packet.reset(this->camera.getPosition());
+        for (int row = 0; row < rowCount; row++)
+        {
+            for (int column = 0; column < columnCount; column++)
+            {
+                packet.add(this->camera.getRay(x + column, y + row));
+            }
+        }
+        ProfileTime time2 = this->profiler != nullptr ? getProfileTime() : 0;
+
+        this->tracePacket(packet, world, hits);
+        ProfileTime time3 = this->profiler != nullptr ? getProfileTime() : 0;
+
+        for (int row = 0; row < rowCount; row++)
+        {
+            for (int column = 0; column < columnCount; column++)
+            {
+                const RayHit& hit = hits[row * columnCount + column];
+                frame.set(x + column, y + row, hit.wChar, hit.wColor, hit.fDistance * hit.fDistance);
+            }
+        }
+
+        if (this->profiler != nullptr)
+        {
+            ProfileTime time4 = getProfileTime();
+            generationTime += time2 - time1;
+            intersectionTime += time3 - time2;
+            shadingTime += time4 - time3;
+        }
+    }
+
+    if (this->profiler != nullptr)
+    {
+        this->profiler->addTime(STAGE_RAY_GENERATION, generationTime);
+        this->profiler->addTime(STAGE_INTERSECTION, intersectionTime);
+        this->profiler->addTime(STAGE_SHADING, shadingTime);
+    }
+}
+
+void Renderer::reconstructRow(int y, int parity, bool useHistory, Framebuffer& frame) const
+{
+    int width = frame.nWidth;
+    int height = frame.nHeight;
+
+    for (int x = (y + parity + 1) & 1; x < width; x += 2)
+    {
+        int cell = y * width + x;
+
+        // The camera didn't move, so the cell is still what was traced for it last frame
+        if (useHistory)
+        {
+            frame.chars[cell] = this->history.chars[cell];
+            frame.colors[cell] = this->history.colors[cell];
+            frame.depths[cell] = this->history.depths[cell];
+            continue;
+        }
+
+        // All 4 neighbours were traced this frame. Take a pair that agrees, so edges stay sharp
+        int left = x > 0 ? cell - 1 : -1;
+        int right = x + 1 < width ? cell + 1 : -1;
+        int up = y > 0 ? cell - width : -1;
+        int down = y + 1 < height ? cell + width : -1;
+
+        int source;
+        if (left >= 0 && right >= 0 && frame.chars[left] == frame.chars[right] && frame.colors[left] == frame.colors[right])
+        {
+            source = left;
+        }
+        else if (up >= 0 && down >= 0 && frame.chars[up] == frame.chars[down] && frame.colors[up] == frame.colors[down])
+        {
+            source = up;
+        }
+        else
+        {
+            source = left >= 0 ? left : (right >= 0 ? right : (up >= 0 ? up : down));
+        }
+
+        if (source >= 0)
+        {
+            frame.chars[cell] = frame.chars[source];
+            frame.colors[cell] = frame.colors[source];
+            frame.depths[cell] = frame.depths[source];
+        }
+    }
+}
+
+void Renderer::renderBlockRow(int y, int block, const World& world, Framebuffer& frame) const
+{
+    int width = frame.nWidth;
+    this->renderRow(y, 0, block, world, frame);
+
+    // Spread each traced cell over its block in this row, then copy the row down
+    Glyph* chars = &frame.chars[y * width];
+    Color* colors = &frame.colors[y * width];
+    float* depths = &frame.depths[y * width];
+    for (int x = 0; x < width; x += block)
+    {
+        int end = std::min(x + block, width);
+        std::fill(chars + x + 1, chars + end, chars[x]);
+        std::fill(colors + x + 1, colors + end, colors[x]);
+        std::fill(depths + x + 1, depths + end, depths[x]);
+    }
+
+    int lastRow = std::min(y + block, frame.nHeight);
+    for (int row = y + 1; row < lastRow; row++)
+    {
+        std::copy(chars, chars + width, &frame.chars[row * width]);
+        std::copy(colors, colors + width, &frame.colors[row * width]);
+        std::copy(depths, depths + width, &frame.depths[row * width]);
+    }
+}
+
+int Renderer::reprojectRow(int y, bool reuse, const World& world, Framebuffer& frame)
+{
+    int traced = 0;
+    for (int x = 0; x < frame.nWidth; x++)
+    {
+        Line ray = this->camera.getRay(x, y);
+
+        // Intersect the object reprojected here and keep it if it is hit about where expected,
+        //     in front of the objects reprojected next to it
+        GameObject* candidates[5];
+        float expected;
+        int count = reuse ? this->reprojection.getCandidates(x, y, candidates, expected) : 0;
+        if (count > 0)
+        {
+            std::pair<float, Glyph> intersection = candidates[0]->getIntersection(ray, this->fDepth);
+            float distance = intersection.first * intersection.first;   // getIntersection returns its square root
+            bool valid = intersection.first > 0 && intersection.first < this->fDepth && fabsf(distance - expected) <= 0.05f * expected;
+
+            for (int i = 1; i < count && valid; i++)
+            {
+                // Ties are traced, the scene decides them by object order
+                std::pair<float, Glyph> other = candidates[i]->getIntersection(ray, this->fDepth);
+                valid = !(other.first > 0 && other.first <= intersection.first);
+            }
+
+            if (valid)
+            {
+                frame.set(x, y, intersection.second, candidates[0]->getPixelColor(), distance);
+                this->reprojection.store(x, y, ray.getPoint(distance), candidates[0], false);
+                continue;
+            }
+        }
+
+        RayHit hit = this->traceCell(ray, x, world);
+        frame.set(x, y, hit.wChar, hit.wColor, hit.fDistance * hit.fDistance);
+        this->reprojection.store(x, y, ray.getPoint(hit.fDistance * hit.fDistance), hit.object, true);
+        traced++;
+    }
+    return traced;
+}
+
+void Renderer::drawSprites(const World& world, Framebuffer& frame)
+{
+    const std::vector<Sprite>& sprites = world.getSprites();
+    this->nSpritesDrawn = 0;
+    this->nSpriteCells = 0;
+    if (sprites.empty())
+    {
+        return;
+    }
+
+    // Cull against the view distance and the screen
+    SpriteView* views = this->frameArena.allocateArray<SpriteView>(sprites.size());
+    Vector3D eye = this->camera.getPosition();
+    float maxDistance = this->fDepth * this->fDepth;    // Where rays stop
+    int count = 0;
+    for (int i = 0; i < (int)sprites.size(); i++)
+    {
+        const Sprite& sprite = sprites[i];
+        float dx = sprite.fPos[0] - eye[0];
+        float dy = sprite.fPos[1] - eye[1];
+        float dz = sprite.fPos[2] - eye[2];
+        float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+        float left, right, top, bottom;
+        if (distance >= maxDistance || !this->camera.projectBillboard(Vector3D(sprite.fPos[0], sprite.fPos[1], sprite.fPos[2]),
+            sprite.fWidth, sprite.fHeight, left, right, top, bottom))
+        {
+            continue;
+        }
+
+        // Cells whose rays pass through the rectangle; clamped first, near sprites can span far past the screen
+        SpriteView& view = views[count];
+        view.nLeft = (int)ceilf(std::max(left, 0.0f));
+        view.nRight = (int)floorf(std::min(right, frame.nWidth - 1.0f));
+        view.nTop = (int)ceilf(std::max(top, 0.0f));
+        view.nBottom = (int)floorf(std::min(bottom, frame.nHeight - 1.0f));
+        if (view.nLeft > view.nRight || view.nTop > view.nBottom)
+        {
+            continue;
+        }
+        view.fDistance = distance;
+        view.nIndex = i;
+        count++;
+    }
+
+    // Nearest first: each sprite writes its distance, so farther ones only fill the cells left to them
+    std::sort(views, views + count, [](const SpriteView& a, const SpriteView& b)
+        {
+            return a.fDistance < b.fDistance || (a.fDistance == b.fDistance && a.nIndex < b.nIndex);
+        });
+
+    for (int i = 0; i < count; i++)
+    {
+        const SpriteView& view = views[i];
+        const Sprite& sprite = sprites[view.nIndex];
+        for (int y = view.nTop; y <= view.nBottom; y++)
+        {
+            int row = y * frame.nWidth;
+            for (int x = view.nLeft; x <= view.nRight; x++)
+            {
+                if (view.fDistance < frame.depths[row + x])
+                {
+                    frame.chars[row + x] = sprite.wChar;
+                    frame.colors[row + x] = sprite.wColor;
+                    frame.depths[row + x] = view.fDistance;
+                }
+            }
+        }
+        this->nSpriteCells += (view.nRight - view.nLeft + 1) * (view.nBottom - view.nTop + 1);
+    }
+    this->nSpritesDrawn = count;
+}
+
+void Renderer::runRows(int rowCount, const JobFunction& fn)
+{
+    if (this->pool == nullptr)
+    {
+        for (int y = 0; y < rowCount; y++)
+        {
+            fn(y);
+        }
+        return;
+    }
+
+    this->pool->run(rowCount, fn);
+}
+
+int Renderer::getRayCount(RenderQuality quality, int width, int height)
+{
+    switch (quality)
+    {
+        case QUALITY_CHECKERBOARD:  return (width * height + 1) / 2;
+        case QUALITY_HALF:          return ((width + 1) / 2) * ((height + 1) / 2);
+        case QUALITY_QUARTER:       return ((width + 3) / 4) * ((height + 3) / 4);
+        default:                    return width * height;
+    }
+}
+
+void Renderer::adaptQuality(int width, int height, double renderTime)
+{
+    if (this->nRaysTraced == 0)
+    {
+        return;
+    }
+
+    // Smooth the cost so a single slow frame doesn't drop the quality
+    double cost = renderTime / this->nRaysTraced;
+    this->fRayCost = this->fRayCost == 0.0 ? cost : this->fRayCost * 0.75 + cost * 0.25;
+    double budget = this->fTargetTime / this->fRayCost;
+
+    RenderQuality best = QUALITY_QUARTER;
+    for (int i = QUALITY_FULL; i < QUALITY_QUARTER; i++)
+    {
+        // Going up needs some headroom, otherwise the quality flips every frame near the limit
+        RenderQuality candidate = (RenderQuality)i;
+        double limit = candidate < this->quality ? budget * 0.8 : budget;
+        if (getRayCount(candidate, width, height) <= limit)
+        {
+            best = candidate;
+            break;
+        }
+    }
+    this->quality = best;
+}
+
+void Renderer::render(const Player& player, const World& world, Framebuffer& frame)
+{
+    ScopedTimer timer(this->profiler, STAGE_RENDER);
+    ProfileTime startTime = getProfileTime();
+
+    this->camera.setProjection(frame.nWidth, frame.nHeight, this->fFov);
+    this->camera.setPose(player.getCenterPos(), player.getAngle());
+
+    Vector3D pos = player.getCenterPos();
+    float pose[4] = { pos[0], pos[1], pos[2], player.getAngle() };
+    this->frameArena.reset();
+    this->prepareCandidates(world);
+
+    if (this->mode == RENDER_COLUMN)
+    {
+        ScopedTimer columnTimer(this->profiler, STAGE_INTERSECTION);
+        this->prepareColumns(world);
+    }
+
+    // Rows only read the scene and the camera and write their own cells
+    if (this->quality == QUALITY_FULL && this->bReprojection)
+    {
+        bool reuse = this->reprojection.reproject(this->camera, world);
+        std::atomic<int> traced(0);
+        this->runRows(frame.nHeight, [&](int y) { traced += this->reprojectRow(y, reuse, world, frame); });
+        this->reprojection.commit(world);
+        this->nRaysTraced = traced;
+    }
+    else if (this->quality == QUALITY_FULL && this->usesPackets())
+    {
+        int packetRows = (frame.nHeight + N_PACKET_SIZE - 1) / N_PACKET_SIZE;
+        this->runRows(packetRows, [&](int row) { this->renderPacketRow(row * N_PACKET_SIZE, world, frame); });
+    }
+    else if (this->quality == QUALITY_FULL)
+    {
+        this->runRows(frame.nHeight, [&](int y) { this->renderRow(y, 0, 1, world, frame); });
+    }
+    else if (this->quality == QUALITY_CHECKERBOARD)
+    {
+        int parity = this->nFrame & 1;
+        // Moved or added objects change the world's revision, the last frame doesn't show them
+        bool useHistory = this->bHistoryValid && this->history.nWidth == frame.nWidth && this->history.nHeight == frame.nHeight &&
+            std::equal(pose, pose + 4, this->fHistoryPose) && this->historyWorld == &world && this->nHistoryRevision == world.getRevision();
+
+        // Neighbours come from other rows, so all rows are traced before any is rebuilt
+        this->runRows(frame.nHeight, [&](int y) { this->renderRow(y, (y + parity) & 1, 2, world, frame); });
+        this->runRows(frame.nHeight, [&](int y) { this->reconstructRow(y, parity, useHistory, frame); });
+    }
+    else
+    {
+        int block = this->quality == QUALITY_HALF ? 2 : 4;
+        this->runRows((frame.nHeight + block - 1) / block, [&](int row) { this->renderBlockRow(row * block, block, world, frame); });
+    }
+
+    // Keep the frame for the next checkerboard frame, before sprites and overlays are drawn over it
+    this->bHistoryValid = this->quality <= QUALITY_CHECKERBOARD && (this->quality == QUALITY_CHECKERBOARD || this->fTargetTime > 0.0f);
+    if (this->bHistoryValid)
+    {
+        this->history = frame;
+        std::copy(pose, pose + 4, this->fHistoryPose);
+        this->historyWorld = &world;
+        this->nHistoryRevision = world.getRevision();
+    }
+
+    {
+        ScopedTimer spriteTimer(this->profiler, STAGE_SPRITES);
+        this->drawSprites(world, frame);
+    }
+
+    if (this->quality != QUALITY_FULL || !this->bReprojection)
+    {
+        this->reprojection.invalidate();
+        this->nRaysTraced = getRayCount(this->quality, frame.nWidth, frame.nHeight);
+    }
+    this->nFrame++;
+
+    if (this->fTargetTime > 0.0f)
+    {
+        this->adaptQuality(frame.nWidth, frame.nHeight, (getProfileTime() - startTime) * 1e-9);
+    }
+}
@@ -0,0 +1,244 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <vector>
+#include "geometry.h"
+#include "objects.h"
+#include "framebuffer.h"
+#include "world.h"
+#include "boxkernel.h"
+#include "threadpool.h"
+#include "camera.h"
+#include "profiler.h"
+#include "reprojection.h"
+#include "arena.h"
+
+/*
+    Raycasting renderer. Knows nothing about the console it is shown on:
+    it takes the player pose and scene objects and fills a Framebuffer.
+*/
+
+// Nearest object seen along a ray
+struct RayHit
+{
+    float fDistance;
+    Glyph wChar;
+    Color wColor;
+    GameObject* object;     // nullptr if nothing is hit
+};
+
+// How rays find the objects they hit
+enum RenderMode
+{
+    RENDER_LINEAR,  // Test every object for every ray
+    RENDER_GRID,    // Walk the map grid, test only cubes in pierced cells
+    RENDER_BVH,     // Traverse the bounding volume hierarchy of all objects
+    RENDER_SCENE,   // Batched passes over the data-oriented scene arrays
+    RENDER_COLUMN   // Walk the map grid once per screen column, then test each cell's ray against what its column sees
+};
+
+// How many cells get their own ray
+enum RenderQuality
+{
+    QUALITY_FULL,           // Every cell
+    QUALITY_CHECKERBOARD,   // Every other cell, alternating each frame, the rest rebuilt from neighbours and the previous frame
+    QUALITY_HALF,           // One cell per 2x2 block
+    QUALITY_QUARTER,        // One cell per 4x4 block
+    QUALITY_COUNT
+};
+
+class Renderer
+{
+private:
+    float fFov;
+    float fDepth;
+    RenderMode mode;
+    BoxKernelType boxKernelType;
+    BoxKernel boxKernel;
+    ThreadPool* pool;
+    Camera camera;
+    Profiler* profiler;
+
+    // Adaptive quality
+    RenderQuality quality;
+    float fTargetTime;      // Seconds per render() the quality is tuned for, 0 keeps the quality fixed
+    double fRayCost;        // Smoothed seconds per traced ray
+    int nRaysTraced;        // In the last frame
+    int nFrame;
+
+    // Last full frame and the pose and world it was rendered from, for checkerboard reconstruction
+    Framebuffer history;
+    bool bHistoryValid;
+    float fHistoryPose[4];
+    const World* historyWorld;
+    unsigned int nHistoryRevision;
+
+    bool bReprojection;
+    ReprojectionCache reprojection;
+
+    bool bPackets;
+
+    bool bVisibilityCulling;
+    // Objects linear mode tests this frame: with culling, only the wall objects the eye's square may see, then the rest
+    GameObject* const* candidates;
+    int nCandidates;
+
+    // Scratch of the current frame, reset at the start of render()
+    Arena frameArena;
+
+    // Column mode: the first wall square each column's rays reach and the loose objects its vertical plane meets
+    struct ColumnView
+    {
+        bool bWall;
+        float fWallEntry;       // Horizontal distance at which the wall square is entered
+        float fWallMin[3];
+        float fWallMax[3];
+        GameObject* wall;
+        int nFirstObject;       // Range of columnObjects
+        int nObjectCount;
+    };
+    ColumnView* columns;    // One per screen column, in frameArena
+    std::vector<GameObject*> columnObjects;
+    ShadeTiers wallTiers;
+
+    // Sprite in view: the cells its rectangle covers, clipped to the screen
+    struct SpriteView
+    {
+        float fDistance;
+        int nIndex;
+        int nLeft, nRight;      // Inclusive
+        int nTop, nBottom;
+    };
+    int nSpritesDrawn;
+    int nSpriteCells;       // Cells covered by sprites in view, whether or not walls hid them
+
+    RayHit traceRay(Line ray, const World& world) const;
+
+    RayHit traceObjects(Line ray, GameObject* const* objects, int count) const;
+
+    // Picks the objects linear mode tests from the square the camera is on
+    void prepareCandidates(const World& world);
+
+    // Walls that are only in the grid, on top of the hit the render mode found
+    void traceGridWalls(Line ray, const World& world, RayHit& hit) const;
+
+    bool usesPackets() const { return this->bPackets && (this->mode == RENDER_LINEAR || this->mode == RENDER_BVH); }
+
+    // Same hits as traceRay(ray, world) for every ray of the packet. Objects are culled for the whole packet,
+    //     incoherent packets are traced ray by ray
+    void tracePacket(const RayPacket& packet, const World& world, RayHit* hits) const;
+
+    // Traces rows [y, y + N_PACKET_SIZE) in packets of N_PACKET_SIZE x N_PACKET_SIZE cells
+    void renderPacketRow(int y, const World& world, Framebuffer& frame) const;
+
+    // Traces the ray of a cell in column x, through the column's view in column mode
+    RayHit traceCell(Line ray, int x, const World& world) const;
+
+    // Walks the map grid along every column of the camera for column mode
+    void prepareColumns(const World& world);
+
+    // Same result as traceRay(ray, world.getGrid()) for a ray in column x
+    RayHit traceColumnRay(Line ray, int x, const World& world) const;
+
+    // Traces cells first, first + step, ... of row y
+    void renderRow(int y, int first, int step, const World& world, Framebuffer& frame) const;
+
+    // Fills untraced checkerboard cells of row y from traced neighbours, or from history if the pose didn't change
+    void reconstructRow(int y, int parity, bool useHistory, Framebuffer& frame) const;
+
+    // Traces one cell per block of block x block cells in rows [y, y + block) and fills the rest of the block
+    void renderBlockRow(int y, int block, const World& world, Framebuffer& frame) const;
+
+    // Renders row y reusing last frame's hits where the cache allows, returns the number of rays traced
+    int reprojectRow(int y, bool reuse, const World& world, Framebuffer& frame);
+
+    void runRows(int rowCount, const JobFunction& fn);
+
+    // Draws the sprites in view over the frame, nearest first, where they are nearer than the frame's depth
+    void drawSprites(const World& world, Framebuffer& frame);
+
+    static int getRayCount(RenderQuality quality, int width, int height);
+
+    // Picks the best quality whose rays fit in the target time at the measured cost per ray
+    void adaptQuality(int width, int height, double renderTime);
+
+public:
+    Renderer(float fov = 3.14159f / 4.0f, float depth = 60.0f);
+
+    float getFov() const { return this->fFov; }
+
+    float getDepth() const { return this->fDepth; }
+
+    void setFov(float fov) { this->fFov = fov; }
+
+    const Camera& getCamera() const { return this->camera; }
+
+    RenderMode getMode() const { return this->mode; }
+
+    void setMode(RenderMode renderMode) { this->mode = renderMode; }
+
+    BoxKernelType getBoxKernelType() const { return this->boxKernelType; }
+
+    // Kernel used for cubes in BVH leaves and scene arrays, falls back to BOX_KERNEL_NONE if the CPU doesn't support it
+    void setBoxKernel(BoxKernelType type);
+
+    // Rows are rendered as jobs on the pool, nullptr renders on the calling thread only
+    void setThreadPool(ThreadPool* threadPool) { this->pool = threadPool; }
+
+    // Times render stages into the profiler, nullptr turns timing off
+    void setProfiler(Profiler* frameProfiler) { this->profiler = frameProfiler; }
+
+    RenderQuality getQuality() const { return this->quality; }
+
+    // Renders at a fixed quality and turns adaptive quality off
+    void setQuality(RenderQuality renderQuality) { this->quality = renderQuality; this->fTargetTime = 0.0f; }
+
+    // Changes quality after every frame so render() takes about targetTime seconds, 0 turns it off
+    void setAdaptiveQuality(float targetTime) { this->fTargetTime = targetTime; }
+
+    float getTargetTime() const { return this->fTargetTime; }
+
+    int getRaysTraced() const { return this->nRaysTraced; }
+
+    // Sprites that survived culling in the last frame
+    int getSpritesDrawn() const { return this->nSpritesDrawn; }
+
+    int getSpriteCells() const { return this->nSpriteCells; }
+
+    bool getReprojection() const { return this->bReprojection; }
+
+    // Reuses hits of the previous frame at full quality, see ReprojectionCache
+    void setReprojection(bool enabled) { this->bReprojection = enabled; this->reprojection.invalidate(); }
+
+    bool getPacketTracing() const { return this->bPackets; }
+
+    // Traces full quality frames in ray packets in linear and BVH mode, see RayPacket
+    void setPacketTracing(bool enabled) { this->bPackets = enabled; }
+
+    bool getVisibilityCulling() const { return this->bVisibilityCulling; }
+
+    // Linear mode only tests the wall objects in the potentially visible set of the camera's square, see PvsTable
+    void setVisibilityCulling(bool enabled) { this->bVisibilityCulling = enabled; }
+
+    // Objects linear mode tested rays against in the last frame
+    int getCandidateCount() const { return this->nCandidates; }
+
+    static const char* getQualityName(RenderQuality quality);
+
+    // Returns nearest object hit by the ray, distance is fDepth if nothing is hit
+    RayHit traceRay(Line ray, const std::vector<GameObject*>& objects) const;
+
+    // Same as above, but only tests cubes in grid cells the ray passes through
+    RayHit traceRay(Line ray, const MapGrid& grid) const;
+
+    // Same as above, but only tests objects in BVH nodes the ray passes through
+    RayHit traceRay(Line ray, const Bvh& bvh) const;
+
+    // Same as above, but tests the scene arrays type by type
+    RayHit traceRay(Line ray, const Scene& scene) const;
+
+    // Points the camera from the player and renders the world into frame
+    void render(const Player& player, const World& world, Framebuffer& frame);
+};
+
+#endif
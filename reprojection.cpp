@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <math.h>
+#include <limits>
+#include "reprojection.h"
+
+
+bool ReprojectionCache::reproject(const Camera& camera, const World& world)
+{
+    int width = camera.getWidth();
+    int height = camera.getHeight();
+    if (width != this->nWidth || height != this->nHeight)
+    {
+        int size = width * height;
+        this->nWidth = width;
+        this->nHeight = height;
+        this->pointX.assign(size, 0.0f);
+        this->pointY.assign(size, 0.0f);
+        this->pointZ.assign(size, 0.0f);
+        this->objects.assign(size, nullptr);
+        this->ages.assign(size, 0);
+        this->candidates.assign(size, nullptr);
+        this->candidateDistances.assign(size, 0.0f);
+        this->candidateAges.assign(size, 0);
+        this->bValid = false;
+    }
+
+    if (!this->bValid || this->world != &world || this->nWorldRevision != world.getRevision())
+    {
+        this->bValid = false;
+        return false;
+    }
+
+    std::fill(this->candidates.begin(), this->candidates.end(), nullptr);
+    std::fill(this->candidateDistances.begin(), this->candidateDistances.end(), std::numeric_limits<float>::max());
+
+    Vector3D eye = camera.getPosition();
+    for (int cell = 0; cell < width * height; cell++)
+    {
+        if (this->objects[cell] == nullptr)
+        {
+            continue;
+        }
+
+        Vector3D point(this->pointX[cell], this->pointY[cell], this->pointZ[cell]);
+        float screenX, screenY;
+        if (!camera.project(point, screenX, screenY))
+        {
+            continue;
+        }
+
+        int x = (int)floorf(screenX + 0.5f);
+        int y = (int)floorf(screenY + 0.5f);
+        if (x < 0 || x >= width || y < 0 || y >= height)
+        {
+            continue;
+        }
+
+        // Nearest hit landing on a cell wins, the others are hidden behind it now
+        float dx = point[0] - eye[0];
+        float dy = point[1] - eye[1];
+        float dz = point[2] - eye[2];
+        float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+
+        int target = y * width + x;
+        if (distance < this->candidateDistances[target])
+        {
+            this->candidates[target] = this->objects[cell];
+            this->candidateDistances[target] = distance;
+            this->candidateAges[target] = this->ages[cell] + 1;
+        }
+    }
+    return true;
+}
+
+int ReprojectionCache::getCandidates(int x, int y, GameObject* objects[5], float& distance) const
+{
+    int cell = y * this->nWidth + x;
+    if (this->candidates[cell] == nullptr || this->candidateAges[cell] >= N_MAX_AGE)
+    {
+        return 0;
+    }
+
+    int neighbours[4] = {
+        x > 0 ? cell - 1 : -1,
+        x + 1 < this->nWidth ? cell + 1 : -1,
+        y > 0 ? cell - this->nWidth : -1,
+        y + 1 < this->nHeight ? cell + this->nWidth : -1
+    };
+
+    int count = 0;
+    objects[count++] = this->candidates[cell];
+    for (int neighbour: neighbours)
+    {
+        if (neighbour < 0)
+        {
+            continue;
+        }
+
+        // Something not seen last frame may be showing up next to a hole
+        GameObject* candidate = this->candidates[neighbour];
+        if (candidate == nullptr)
+        {
+            return 0;
+        }
+
+        if (std::find(objects, objects + count, candidate) == objects + count)
+        {
+            objects[count++] = candidate;
+        }
+    }
+
+    distance = this->candidateDistances[cell];
+    return count;
+}
+
+void ReprojectionCache::store(int x, int y, Vector3D point, GameObject* object, bool traced)
+{
+    int cell = y * this->nWidth + x;
+    this->pointX[cell] = point[0];
+    this->pointY[cell] = point[1];
+    this->pointZ[cell] = point[2];
+    this->objects[cell] = object;
+
+    if (!traced)
+    {
+        this->ages[cell] = this->candidateAges[cell];
+    }
+    else
+    {
+        // After a full trace ages are staggered, so cells don't all expire in the same frame
+        this->ages[cell] = this->bValid ? 0 : (unsigned char)((x * 5 + y * 3) % N_MAX_AGE);
+    }
+}
+
+void ReprojectionCache::commit(const World& world)
+{
+    this->world = &world;
+    this->nWorldRevision = world.getRevision();
+    this->bValid = true;
+}
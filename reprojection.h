@@ -0,0 +1,61 @@
+#ifndef REPROJECTION_H
+#define REPROJECTION_H
+
+#include <vector>
+#include "geometry.h"
+#include "objects.h"
+#include "camera.h"
+#include "world.h"
+
+/*
+    Per-cell cache of what the previous frame saw, for reusing it in the next one.
+    Every cell keeps the object it hit and the hit point. Before a frame the hit points are
+    projected with the new camera pose, the nearest one landing on a cell making its object
+    the candidate for that cell. The renderer then intersects the cell's ray with that one
+    object instead of tracing the whole scene. Cells without a candidate (disocclusions,
+    screen borders), cells on an object edge and cells reused too many frames in a row are
+    traced again. The cache is dropped when the world changes or the screen is resized.
+*/
+
+class ReprojectionCache
+{
+private:
+    static const int N_MAX_AGE = 16;    // Frames a cell can be reused before it is traced again
+
+    int nWidth = 0;
+    int nHeight = 0;
+    const World* world = nullptr;
+    unsigned int nWorldRevision = 0;
+    bool bValid = false;
+
+    // What each cell saw in the last frame
+    std::vector<float> pointX;
+    std::vector<float> pointY;
+    std::vector<float> pointZ;
+    std::vector<GameObject*> objects;
+    std::vector<unsigned char> ages;
+
+    // What was reprojected onto each cell for the current frame
+    std::vector<GameObject*> candidates;
+    std::vector<float> candidateDistances;
+    std::vector<unsigned char> candidateAges;
+
+public:
+    // Projects the last frame's hits with the new camera pose.
+    //     Returns false if they can't be reused, the whole frame has to be traced then
+    bool reproject(const Camera& camera, const World& world);
+
+    // Objects whose hits landed on cell (x, y) and its 4 neighbours, the cell's own first, each once.
+    //     distance is where the cell's own object is expected. Returns 0 if the cell has to be traced
+    int getCandidates(int x, int y, GameObject* objects[5], float& distance) const;
+
+    // Records what cell (x, y) saw this frame, traced or reused
+    void store(int x, int y, Vector3D point, GameObject* object, bool traced);
+
+    // Marks the frame stored with store() as usable for the next one
+    void commit(const World& world);
+
+    void invalidate() { this->bValid = false; }
+};
+
+#endif
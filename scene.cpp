@@ -0,0 +1,142 @@
+#include <math.h>
+#include "scene.h"
+
+
+Scene::Scene()
+{
+}
+
+void Scene::build(const std::vector<GameObject*>& objects)
+{
+    this->arena.reset();
+    this->others.clear();
+    this->otherObjects.clear();
+    this->boxOfObject.clear();
+
+    Vector3D minCorner, maxCorner;
+    Plane plane;
+    ShadeTiers tiers;
+
+    int boxCount = 0;
+    int planeCount = 0;
+    for (GameObject* obj: objects)
+    {
+        if (obj->isBox())                          { boxCount++; }
+        else if (obj->getPlaneShape(plane, tiers)) { planeCount++; }
+    }
+
+    this->boxes.resize(boxCount, this->arena);
+    this->boxColors = this->arena.allocateArray<Color>(boxCount);
+    this->boxObjects = this->arena.allocateArray<int>(boxCount);
+
+    this->nPlanes = planeCount;
+    this->planeNormalX = this->arena.allocateArray<float>(planeCount);
+    this->planeNormalY = this->arena.allocateArray<float>(planeCount);
+    this->planeNormalZ = this->arena.allocateArray<float>(planeCount);
+    this->planeD = this->arena.allocateArray<float>(planeCount);
+    this->planeTiers = this->arena.allocateArray<ShadeTiers>(planeCount);
+    this->planeColors = this->arena.allocateArray<Color>(planeCount);
+    this->planeObjects = this->arena.allocateArray<int>(planeCount);
+
+    int box = 0;
+    int planeIndex = 0;
+    for (int i = 0; i < (int)objects.size(); i++)
+    {
+        GameObject* obj = objects[i];
+        if (obj->isBox())
+        {
+            obj->getBounds(minCorner, maxCorner);
+            this->boxes.set(box, minCorner, maxCorner);
+            this->boxColors[box] = obj->getPixelColor();
+            this->boxObjects[box] = i;
+            this->boxOfObject[obj] = box;
+            box++;
+        }
+        else if (obj->getPlaneShape(plane, tiers))
+        {
+            const vecmath::Plane& equation = plane.getEquation();
+            this->planeNormalX[planeIndex] = equation.normal.x;
+            this->planeNormalY[planeIndex] = equation.normal.y;
+            this->planeNormalZ[planeIndex] = equation.normal.z;
+            this->planeD[planeIndex] = equation.d;
+            this->planeTiers[planeIndex] = tiers;
+            this->planeColors[planeIndex] = obj->getPixelColor();
+            this->planeObjects[planeIndex] = i;
+            planeIndex++;
+        }
+        else
+        {
+            this->others.push_back(obj);
+            this->otherObjects.push_back(i);
+        }
+    }
+}
+
+void Scene::updateObject(GameObject* obj)
+{
+    std::unordered_map<GameObject*, int>::const_iterator it = this->boxOfObject.find(obj);
+    if (it == this->boxOfObject.end())
+    {
+        return;
+    }
+
+    Vector3D minCorner, maxCorner;
+    obj->getBounds(minCorner, maxCorner);
+    this->boxes.set(it->second, minCorner, maxCorner);
+}
+
+SceneHit Scene::findNearestHit(Line ray, float depth, BoxKernel boxKernel) const
+{
+    SceneHit hit = { depth, ' ', 0, -1 };
+
+    // Keeps a candidate if it is closer, or as close and earlier in the object list
+    auto offer = [&](float distance, Glyph ch, Color color, int object)
+    {
+        if (distance > 0 && (distance < hit.fDistance || (distance == hit.fDistance && hit.nObject != -1 && object < hit.nObject)))
+        {
+            hit.fDistance = distance;
+            hit.wChar = ch;
+            hit.wColor = color;
+            hit.nObject = object;
+        }
+    };
+
+    // Boxes: one kernel call over the whole array, same result as Cube::getIntersection
+    if (this->boxes.nCount > 0)
+    {
+        if (boxKernel == nullptr)
+        {
+            boxKernel = getBoxKernel(BOX_KERNEL_SCALAR);
+        }
+
+        float t;
+        int box = boxKernel(this->boxes, 0, this->boxes.nCount, BoxRay(ray), depth * depth, t);
+        if (box != -1)
+        {
+            offer(sqrtf(t), Cube::getShadeTiers(depth).shade(t), this->boxColors[box], this->boxObjects[box]);
+        }
+    }
+
+    // Planes: same arithmetic as Plane::getLineIntersection
+    const vecmath::Ray& r = ray.getRay();
+    for (int i = 0; i < this->nPlanes; i++)
+    {
+        vecmath::Vec3 normal(this->planeNormalX[i], this->planeNormalY[i], this->planeNormalZ[i]);
+        vecmath::Plane plane(normal, this->planeD[i]);
+
+        float t;
+        if (!plane.intersect(r, t))
+        {
+            t = 0;
+        }
+        offer(sqrtf(t), this->planeTiers[i].shade(t), this->planeColors[i], this->planeObjects[i]);
+    }
+
+    for (int i = 0; i < (int)this->others.size(); i++)
+    {
+        std::pair<float, Glyph> intersection = this->others[i]->getIntersection(ray, depth);
+        offer(intersection.first, intersection.second, this->others[i]->getPixelColor(), this->otherObjects[i]);
+    }
+
+    return hit;
+}
@@ -0,0 +1,73 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <unordered_map>
+#include <vector>
+#include "geometry.h"
+#include "objects.h"
+#include "arena.h"
+#include "boxkernel.h"
+
+/*
+    Data-oriented copy of the scene objects for rendering.
+    Objects are sorted by type into contiguous arrays (boxes, infinite planes) and every
+    type is intersected in one batched pass over its arrays, without virtual calls.
+    All arrays live in one arena that is released in bulk when the scene is rebuilt.
+    Objects of other types keep going through GameObject::getIntersection.
+*/
+
+struct SceneHit
+{
+    float fDistance;
+    Glyph wChar;
+    Color wColor;
+    int nObject;    // Index in the list the scene was built from, -1 if nothing is hit
+};
+
+class Scene
+{
+private:
+    Arena arena;
+
+    // Boxes: every object with isBox()
+    BoxArray boxes;
+    Color* boxColors = nullptr;
+    int* boxObjects = nullptr;
+
+    // Infinite planes: dot(normal, p) + d = 0
+    int nPlanes = 0;
+    float* planeNormalX = nullptr;
+    float* planeNormalY = nullptr;
+    float* planeNormalZ = nullptr;
+    float* planeD = nullptr;
+    ShadeTiers* planeTiers = nullptr;
+    Color* planeColors = nullptr;
+    int* planeObjects = nullptr;
+
+    std::vector<GameObject*> others;
+    std::vector<int> otherObjects;
+
+    std::unordered_map<GameObject*, int> boxOfObject;
+
+public:
+    Scene();
+
+    void build(const std::vector<GameObject*>& objects);
+
+    // Copies new bounds of a moved box
+    void updateObject(GameObject* obj);
+
+    int getBoxCount() const { return this->boxes.nCount; }
+
+    int getPlaneCount() const { return this->nPlanes; }
+
+    int getOtherCount() const { return (int)this->others.size(); }
+
+    size_t getBytesUsed() const { return this->arena.getBytesUsed(); }
+
+    // Returns the nearest hit closer than depth, same as testing every object in order.
+    //     Boxes are tested with boxKernel, the scalar kernel if it is nullptr.
+    SceneHit findNearestHit(Line ray, float depth, BoxKernel boxKernel) const;
+};
+
+#endif
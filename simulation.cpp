@@ -0,0 +1,101 @@
+#include "simulation.h"
+
+static PlayerState getPlayerState(const Player& player)
+{
+    Vector3D pos = player.getCenterPos();
+    return { { pos[0], pos[1], pos[2] }, player.getAngle() };
+}
+
+Simulation::Simulation(float tickSeconds): bRunning(false), nTicks(0)
+{
+    this->fTickSeconds = tickSeconds;
+    this->tickDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(tickSeconds));
+}
+
+Simulation::~Simulation()
+{
+    this->stop();
+}
+
+void Simulation::start(const Player& player, const StepFunction& step)
+{
+    this->stop();
+
+    this->player = player;
+    this->step = step;
+    this->nTicks.store(0, std::memory_order_relaxed);
+
+    // The reader always has a state, even before the first tick
+    this->publish(getPlayerState(player), std::chrono::steady_clock::now());
+
+    this->bRunning.store(true, std::memory_order_release);
+    this->thread = std::thread(&Simulation::run, this);
+}
+
+void Simulation::stop()
+{
+    this->bRunning.store(false, std::memory_order_release);
+    if (this->thread.joinable())
+    {
+        this->thread.join();
+    }
+}
+
+void Simulation::publish(const PlayerState& previous, std::chrono::steady_clock::time_point tickStart)
+{
+    SimSnapshot& snapshot = this->snapshots.getBack();
+    snapshot.previous = previous;
+    snapshot.current = getPlayerState(this->player);
+    snapshot.tickStart = tickStart;
+    snapshot.nTick = this->nTicks.load(std::memory_order_relaxed);
+    this->snapshots.publish();
+}
+
+void Simulation::run()
+{
+    auto nextTick = std::chrono::steady_clock::now();
+
+    while (this->bRunning.load(std::memory_order_acquire))
+    {
+        auto now = std::chrono::steady_clock::now();
+
+        // Run every tick that is due; if the simulation fell too far behind, drop the time it can't catch up
+        for (int i = 0; nextTick <= now; i++)
+        {
+            if (i == N_MAX_CATCH_UP)
+            {
+                nextTick = now;
+                break;
+            }
+
+            PlayerState previous = getPlayerState(this->player);
+            if (!this->step(this->player, this->fTickSeconds))
+            {
+                this->bRunning.store(false, std::memory_order_release);
+                return;
+            }
+            this->nTicks.fetch_add(1, std::memory_order_relaxed);
+            this->publish(previous, nextTick);
+            nextTick += this->tickDuration;
+        }
+
+        std::this_thread::sleep_until(nextTick);
+    }
+}
+
+void Simulation::getInterpolatedPlayer(Player& player, std::chrono::steady_clock::time_point now)
+{
+    this->snapshots.update();
+    const SimSnapshot& snapshot = this->snapshots.getFront();
+
+    // The state of a tick is reached one tick after it started, in between the states are blended
+    float alpha = std::chrono::duration<float>(now - snapshot.tickStart).count() / this->fTickSeconds;
+    alpha = alpha < 0.0f ? 0.0f : (alpha > 1.0f ? 1.0f : alpha);
+
+    const PlayerState& a = snapshot.previous;
+    const PlayerState& b = snapshot.current;
+    player.setCenterPos(Vector3D(a.fPos[0] + (b.fPos[0] - a.fPos[0]) * alpha,
+        a.fPos[1] + (b.fPos[1] - a.fPos[1]) * alpha,
+        a.fPos[2] + (b.fPos[2] - a.fPos[2]) * alpha));
+    player.setAngle(a.fAngle + (b.fAngle - a.fAngle) * alpha);
+}
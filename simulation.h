@@ -0,0 +1,117 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include "objects.h"
+
+/*
+    Fixed-timestep simulation on its own thread.
+    The simulation steps the player at a fixed rate on steady_clock, independent of how long
+    frames take to render. After every tick it publishes the previous and the new state through
+    a triple buffer; the render thread takes the newest one without locking and interpolates
+    between the two states for the time it renders at.
+*/
+
+// Single producer, single consumer buffer that always hands the reader the newest value
+template<typename T>
+class TripleBuffer
+{
+private:
+    static const int N_FRESH = 4;   // Set on the middle index when it holds a value the reader has not taken
+
+    struct alignas(64) Slot
+    {
+        T value;
+    };
+
+    Slot slots[3];
+    std::atomic<int> nMiddle;
+    int nBack = 0;      // Only used by the writer
+    int nFront = 1;     // Only used by the reader
+
+public:
+    TripleBuffer(): nMiddle(2) {}
+
+    // Writer: fill the back value, then publish it
+    T& getBack() { return this->slots[this->nBack].value; }
+
+    void publish() { this->nBack = this->nMiddle.exchange(this->nBack | N_FRESH, std::memory_order_acq_rel) & 3; }
+
+    // Reader: takes the newest published value, returns false if nothing was published since the last call
+    bool update()
+    {
+        if ((this->nMiddle.load(std::memory_order_relaxed) & N_FRESH) == 0)
+        {
+            return false;
+        }
+        this->nFront = this->nMiddle.exchange(this->nFront, std::memory_order_acq_rel) & 3;
+        return true;
+    }
+
+    const T& getFront() const { return this->slots[this->nFront].value; }
+};
+
+struct PlayerState
+{
+    float fPos[3];
+    float fAngle;
+};
+
+struct SimSnapshot
+{
+    PlayerState previous;   // State at tickStart
+    PlayerState current;    // State one tick later
+    std::chrono::steady_clock::time_point tickStart;
+    long long nTick;
+};
+
+class Simulation
+{
+public:
+    // Advances the player by one tick of dt seconds, returns false to stop the simulation
+    typedef std::function<bool(Player& player, float dt)> StepFunction;
+
+private:
+    static const int N_MAX_CATCH_UP = 5;    // Ticks run at most in a row before dropping time
+
+    std::chrono::steady_clock::duration tickDuration;
+    float fTickSeconds;
+
+    Player player;      // Owned by the simulation thread while it runs
+    StepFunction step;
+    TripleBuffer<SimSnapshot> snapshots;
+    std::atomic<bool> bRunning;
+    std::atomic<long long> nTicks;
+    std::thread thread;
+
+    void run();
+
+    void publish(const PlayerState& previous, std::chrono::steady_clock::time_point tickStart);
+
+public:
+    explicit Simulation(float tickSeconds = 1.0f / 60.0f);
+
+    ~Simulation();
+
+    Simulation(const Simulation&) = delete;
+
+    Simulation& operator=(const Simulation&) = delete;
+
+    float getTickSeconds() const { return this->fTickSeconds; }
+
+    long long getTickCount() const { return this->nTicks.load(std::memory_order_relaxed); }
+
+    bool isRunning() const { return this->bRunning.load(std::memory_order_acquire); }
+
+    void start(const Player& player, const StepFunction& step);
+
+    void stop();
+
+    // Reader: sets the position and angle of player to the simulated state interpolated for time now
+    void getInterpolatedPlayer(Player& player, std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef SPRITE_H
+#define SPRITE_H
+
+#include "objects.h"
+
+/*
+    Sprites: entities such as enemies and items, drawn as rectangles that face the camera.
+    They are plain data kept in one array by the world, not scene objects, so rays never test
+    them. The renderer draws them after the walls: the sprites in view are sorted by distance
+    and each fills the cells of its rectangle where it is nearer than what is already there,
+    so a sprite costs as much as the cells it covers, not a test in every cell.
+*/
+
+struct Sprite
+{
+    float fPos[3];      // Center in world coordinates
+    float fWidth;       // World units
+    float fHeight;
+    Glyph wChar;
+    Color wColor;
+};
+
+#endif
@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <stdlib.h>
+#include "streamer.h"
+
+
+ChunkStreamer::~ChunkStreamer()
+{
+    this->stop();
+}
+
+void ChunkStreamer::start(int width, int height, int chunkShift, size_t memoryCap, const ChunkLoader& chunkLoader)
+{
+    this->stop();
+
+    this->nChunkShift = chunkShift;
+    this->nChunkSize = 1 << chunkShift;
+    this->nChunksX = (width + this->nChunkSize - 1) >> chunkShift;
+    this->nChunksY = (height + this->nChunkSize - 1) >> chunkShift;
+    this->nMaxChunks = std::max(1, (int)(memoryCap / ((size_t)this->nChunkSize * this->nChunkSize)));
+    this->loader = chunkLoader;
+
+    this->table.assign(this->nChunksX * this->nChunksY, nullptr);
+    this->pending.assign(this->nChunksX * this->nChunksY, 0);
+    this->nLoads = 0;
+    this->nEvictions = 0;
+
+    this->bStopping = false;
+    this->thread = std::thread(&ChunkStreamer::loaderLoop, this);
+}
+
+void ChunkStreamer::stop()
+{
+    if (this->thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->bStopping = true;
+        }
+        this->wakeUp.notify_all();
+        this->thread.join();
+    }
+
+    std::lock_guard<ChunkTableLock> tableLock(this->tableLock);
+    for (unsigned char* buffer: this->allBuffers)
+    {
+        delete[] buffer;
+    }
+    this->allBuffers.clear();
+    this->freeBuffers.clear();
+    this->requests.clear();
+    this->nNextRequest = 0;
+    this->loaded.clear();
+    this->resident.clear();
+    std::fill(this->table.begin(), this->table.end(), nullptr);
+    std::fill(this->pending.begin(), this->pending.end(), 0);
+}
+
+void ChunkStreamer::loaderLoop()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true)
+    {
+        this->wakeUp.wait(lock, [this]() { return this->bStopping || this->nNextRequest < this->requests.size(); });
+        if (this->bStopping)
+        {
+            return;
+        }
+
+        ChunkBuffer request = this->requests[this->nNextRequest++];
+        this->nLoading++;
+
+        // Load without holding the lock, so the main thread never waits for a load
+        lock.unlock();
+        int chunkX = request.first % this->nChunksX;
+        int chunkY = request.first / this->nChunksX;
+        this->loader(chunkX << this->nChunkShift, chunkY << this->nChunkShift, this->nChunkSize, request.second);
+        lock.lock();
+
+        this->loaded.push_back(request);
+        this->nLoading--;
+        this->idle.notify_all();
+    }
+}
+
+int ChunkStreamer::getChunkDistance(int chunk, int centerX, int centerY) const
+{
+    int dx = abs(chunk % this->nChunksX - centerX);
+    int dy = abs(chunk / this->nChunksX - centerY);
+    return std::max(dx, dy);
+}
+
+void ChunkStreamer::evict(int residentIndex)
+{
+    int chunk = this->resident[residentIndex];
+    this->freeBuffers.push_back(this->table[chunk]);
+    this->table[chunk] = nullptr;
+    this->resident[residentIndex] = this->resident.back();
+    this->resident.pop_back();
+    this->nEvictions++;
+}
+
+unsigned char* ChunkStreamer::takeBuffer(int distance, int centerX, int centerY)
+{
+    if (this->freeBuffers.empty() && (int)this->allBuffers.size() < this->nMaxChunks)
+    {
+        this->allBuffers.push_back(new unsigned char[this->nChunkSize * this->nChunkSize]);
+        this->freeBuffers.push_back(this->allBuffers.back());
+    }
+
+    if (this->freeBuffers.empty())
+    {
+        // At the cap: give up the farthest resident chunk if it is farther than the one wanted
+        int farthest = -1;
+        int farthestDistance = distance;
+        for (int i = 0; i < (int)this->resident.size(); i++)
+        {
+            int residentDistance = this->getChunkDistance(this->resident[i], centerX, centerY);
+            if (residentDistance > farthestDistance)
+            {
+                farthest = i;
+                farthestDistance = residentDistance;
+            }
+        }
+        if (farthest < 0)
+        {
+            return nullptr;
+        }
+        this->evict(farthest);
+    }
+
+    unsigned char* buffer = this->freeBuffers.back();
+    this->freeBuffers.pop_back();
+    return buffer;
+}
+
+bool ChunkStreamer::update(int squareX, int squareY)
+{
+    if (!this->isStarted())
+    {
+        return false;
+    }
+
+    int centerX = squareX >> this->nChunkShift;
+    int centerY = squareY >> this->nChunkShift;
+    long long evictions = this->nEvictions;
+    bool changed = false;
+
+    // Take finished chunks and the requests the loader hasn't started, they are queued again below.
+    //     Swapping keeps the capacity of both vectors
+    std::vector<ChunkBuffer>& finished = this->finished;
+    finished.clear();
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        finished.swap(this->loaded);
+        for (size_t i = this->nNextRequest; i < this->requests.size(); i++)
+        {
+            this->pending[this->requests[i].first] = 0;
+            this->freeBuffers.push_back(this->requests[i].second);
+        }
+        this->requests.clear();
+        this->nNextRequest = 0;
+    }
+
+    // Readers on other threads wait while the table changes, until the buffers of evicted chunks are
+    //     only the loader's
+    std::lock_guard<ChunkTableLock> tableLock(this->tableLock);
+    for (const ChunkBuffer& chunk: finished)
+    {
+        this->pending[chunk.first] = 0;
+        this->nLoads++;
+        if (this->getChunkDistance(chunk.first, centerX, centerY) <= this->nLoadRadius + 1)
+        {
+            this->table[chunk.first] = chunk.second;
+            this->resident.push_back(chunk.first);
+            changed = true;
+        }
+        else
+        {
+            this->freeBuffers.push_back(chunk.second);
+        }
+    }
+
+    // Chunks one ring past the load radius stay, so walking along a chunk border doesn't reload them
+    for (int i = (int)this->resident.size() - 1; i >= 0; i--)
+    {
+        if (this->getChunkDistance(this->resident[i], centerX, centerY) > this->nLoadRadius + 1)
+        {
+            this->evict(i);
+            changed = true;
+        }
+    }
+
+    // Missing chunks in range, nearest first
+    std::vector<std::pair<int, int>>& wanted = this->wanted;
+    wanted.clear();
+    for (int y = std::max(0, centerY - this->nLoadRadius); y <= std::min(this->nChunksY - 1, centerY + this->nLoadRadius); y++)
+    {
+        for (int x = std::max(0, centerX - this->nLoadRadius); x <= std::min(this->nChunksX - 1, centerX + this->nLoadRadius); x++)
+        {
+            int chunk = y * this->nChunksX + x;
+            if (this->table[chunk] == nullptr && !this->pending[chunk])
+            {
+                int dx = x - centerX;
+                int dy = y - centerY;
+                wanted.push_back(std::make_pair(dx * dx + dy * dy, chunk));
+            }
+        }
+    }
+    std::sort(wanted.begin(), wanted.end());
+
+    std::vector<ChunkBuffer>& newRequests = this->newRequests;
+    newRequests.clear();
+    for (const std::pair<int, int>& chunk: wanted)
+    {
+        unsigned char* buffer = this->takeBuffer(this->getChunkDistance(chunk.second, centerX, centerY), centerX, centerY);
+        if (buffer == nullptr)
+        {
+            break;
+        }
+        this->pending[chunk.second] = 1;
+        newRequests.push_back(std::make_pair(chunk.second, buffer));
+    }
+
+    if (!newRequests.empty())
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->requests.insert(this->requests.end(), newRequests.begin(), newRequests.end());
+        }
+        this->wakeUp.notify_one();
+    }
+    return changed || this->nEvictions != evictions;
+}
+
+void ChunkStreamer::waitUntilIdle()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->idle.wait(lock, [this]() { return this->nNextRequest == this->requests.size() && this->nLoading == 0; });
+}
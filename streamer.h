@@ -0,0 +1,191 @@
+#ifndef STREAMER_H
+#define STREAMER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*
+    Streams map cells in square chunks around the player.
+    The map is split into chunks of 2^shift x 2^shift squares. update() is called between
+    frames with the player position: it publishes the chunks the loader thread has finished,
+    evicts chunks that are out of range and queues the missing chunks near the player, nearest
+    first. Chunk buffers never exceed the memory cap; when it is reached, the farthest resident
+    chunk is evicted for a nearer one. The renderer reads the chunk table between updates and
+    treats chunks that are not resident as empty, so it never waits for a load.
+    Other threads (e.g. collision on the simulation thread) read the table under its
+    ChunkTableLock, which update() takes while it changes the table.
+*/
+
+// Readers don't wait for each other, only while the writer changes the table; the writer waits
+//     for the reads in progress. Reads and changes are short, so both sides spin
+class ChunkTableLock
+{
+private:
+    std::atomic<int> nReaders;
+    std::atomic<bool> bWriting;
+
+public:
+    ChunkTableLock(): nReaders(0), bWriting(false) {}
+
+    void lockShared()
+    {
+        while (true)
+        {
+            this->nReaders++;
+            if (!this->bWriting)
+            {
+                return;
+            }
+            this->nReaders--;
+            while (this->bWriting)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void unlockShared() { this->nReaders--; }
+
+    // Single writer
+    void lock()
+    {
+        this->bWriting = true;
+        while (this->nReaders != 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    void unlock() { this->bWriting = false; }
+};
+
+// Holds a ChunkTableLock for reading while in scope, nothing if it is nullptr
+class SharedChunkLock
+{
+private:
+    ChunkTableLock* tableLock;
+
+public:
+    explicit SharedChunkLock(ChunkTableLock* lock): tableLock(lock)
+    {
+        if (this->tableLock != nullptr)
+        {
+            this->tableLock->lockShared();
+        }
+    }
+
+    ~SharedChunkLock()
+    {
+        if (this->tableLock != nullptr)
+        {
+            this->tableLock->unlockShared();
+        }
+    }
+
+    SharedChunkLock(const SharedChunkLock&) = delete;
+
+    SharedChunkLock& operator=(const SharedChunkLock&) = delete;
+};
+
+class ChunkStreamer
+{
+public:
+    // Fills size x size cells of squares [firstX, firstX + size) x [firstY, firstY + size), row by row
+    typedef std::function<void(int firstX, int firstY, int size, unsigned char* cells)> ChunkLoader;
+
+private:
+    typedef std::pair<int, unsigned char*> ChunkBuffer;    // Chunk index and its cells
+
+    int nChunkShift = 0;
+    int nChunkSize = 0;
+    int nChunksX = 0;
+    int nChunksY = 0;
+    int nMaxChunks = 0;
+    int nLoadRadius = 1;
+    ChunkLoader loader;
+
+    // Main thread only, changes to table under tableLock
+    std::vector<unsigned char*> table;      // Cells of every chunk, nullptr if not resident
+    mutable ChunkTableLock tableLock;
+    std::vector<char> pending;              // Chunk is queued or being loaded
+    std::vector<int> resident;
+    std::vector<unsigned char*> freeBuffers;
+    std::vector<unsigned char*> allBuffers;
+    long long nLoads = 0;
+    long long nEvictions = 0;
+    // Scratch of update(), kept so steady-state updates don't allocate
+    std::vector<ChunkBuffer> finished;
+    std::vector<std::pair<int, int>> wanted;
+    std::vector<ChunkBuffer> newRequests;
+
+    // Shared with the loader thread
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable idle;
+    std::vector<ChunkBuffer> requests;     // The loader takes them from nNextRequest on
+    size_t nNextRequest = 0;
+    std::vector<ChunkBuffer> loaded;
+    int nLoading = 0;
+    bool bStopping = false;
+    std::thread thread;
+
+    void loaderLoop();
+
+    int getChunkDistance(int chunk, int centerX, int centerY) const;
+
+    void evict(int residentIndex);
+
+    // Free buffer for a chunk at the given distance, evicts a farther chunk if the cap is reached
+    unsigned char* takeBuffer(int distance, int centerX, int centerY);
+
+public:
+    ChunkStreamer() {}
+
+    ~ChunkStreamer();
+
+    ChunkStreamer(const ChunkStreamer&) = delete;
+
+    ChunkStreamer& operator=(const ChunkStreamer&) = delete;
+
+    // Starts streaming a width x height map, keeping at most memoryCap bytes of chunks
+    void start(int width, int height, int chunkShift, size_t memoryCap, const ChunkLoader& chunkLoader);
+
+    void stop();
+
+    bool isStarted() const { return this->thread.joinable(); }
+
+    // Chunks up to radius chunks away from the player's chunk are loaded, the ones farther than radius + 1 evicted
+    void setLoadRadius(int radius) { this->nLoadRadius = radius; }
+
+    // Call between frames with the map square the player is on. Returns true if the resident chunks changed
+    bool update(int squareX, int squareY);
+
+    // Blocks until all queued chunks are loaded; they are published by the next update()
+    void waitUntilIdle();
+
+    const unsigned char* const* getTable() const { return this->table.data(); }
+
+    // For reading the table on threads other than the one that calls update()
+    ChunkTableLock* getTableLock() const { return &this->tableLock; }
+
+    int getChunkShift() const { return this->nChunkShift; }
+
+    int getChunksX() const { return this->nChunksX; }
+
+    int getResidentCount() const { return (int)this->resident.size(); }
+
+    size_t getResidentBytes() const { return this->resident.size() * (size_t)this->nChunkSize * this->nChunkSize; }
+
+    size_t getAllocatedBytes() const { return this->allBuffers.size() * (size_t)this->nChunkSize * this->nChunkSize; }
+
+    long long getLoadCount() const { return this->nLoads; }
+
+    long long getEvictionCount() const { return this->nEvictions; }
+};
+
+#endif
@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "terminal.h"
+
+#ifdef _WIN32
+#include <io.h>
+#define write _write
+#else
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+
+// Number of decimal digits of a positive number
+static int digitCount(int n)
+{
+    int digits = 1;
+    while (n >= 10)
+    {
+        n /= 10;
+        digits++;
+    }
+    return digits;
+}
+
+static int utf8Length(Glyph ch)
+{
+    unsigned int code = (unsigned int)ch;
+    if (code < 0x80)  { return 1; }
+    if (code < 0x800) { return 2; }
+    return 3;
+}
+
+// Win32 attribute bits are blue = 1, green = 2, red = 4, ANSI colors are red = 1, green = 2, blue = 4
+static int ansiColor(int bits)
+{
+    return ((bits & 4) ? 1 : 0) | ((bits & 2) ? 2 : 0) | ((bits & 1) ? 4 : 0);
+}
+
+
+TerminalOutput::TerminalOutput(int fd): previous(0, 0)
+{
+    this->fd = fd;
+}
+
+TerminalOutput::~TerminalOutput()
+{
+}
+
+void TerminalOutput::begin()
+{
+    this->buffer = "\x1b[?1049h\x1b[?25l\x1b[0m\x1b[2J";
+    this->flush();
+    this->bValid = false;
+}
+
+void TerminalOutput::end()
+{
+    this->buffer = "\x1b[0m\x1b[?25h\x1b[?1049l";
+    this->flush();
+    this->bValid = false;
+}
+
+bool TerminalOutput::flush()
+{
+    const char* data = this->buffer.data();
+    size_t left = this->buffer.size();
+    while (left > 0)
+    {
+        long written = (long)write(this->fd, data, (unsigned int)left);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+#ifndef _WIN32
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            // Someone else made the terminal non-blocking, wait until it takes more
+            pollfd ready = { this->fd, POLLOUT, 0 };
+            poll(&ready, 1, -1);
+            continue;
+        }
+#endif
+        if (written <= 0)
+        {
+            return false;
+        }
+        data += written;
+        left -= written;
+    }
+    return true;
+}
+
+void TerminalOutput::moveCursor(int x, int y, const Framebuffer& frame)
+{
+    if (this->nCursorY == y && this->nCursorX == x)
+    {
+        return;
+    }
+
+    char sequence[32];
+    if (this->nCursorY == y && this->nCursorX != -1 && x > this->nCursorX)
+    {
+        int gap = x - this->nCursorX;
+        int forwardCost = 3 + digitCount(gap);
+
+        // Rewriting a few unchanged cells is cheaper than moving past them, if they need no color change
+        int rewriteCost = 0;
+        for (int i = this->nCursorX; i < x && rewriteCost <= forwardCost; i++)
+        {
+            int index = y * frame.nWidth + i;
+            rewriteCost = frame.colors[index] == this->nColor ? rewriteCost + utf8Length(frame.chars[index]) : forwardCost + 1;
+        }
+
+        if (rewriteCost <= forwardCost)
+        {
+            for (int i = this->nCursorX; i < x; i++)
+            {
+                this->appendGlyph(frame.chars[y * frame.nWidth + i]);
+            }
+        }
+        else
+        {
+            snprintf(sequence, sizeof(sequence), "\x1b[%dC", gap);
+            this->buffer += sequence;
+        }
+    }
+    else if (this->nCursorY != -1 && this->nCursorY == y - 1 &&
+        2 + (x > 0 ? 3 + digitCount(x) : 0) < 4 + digitCount(y + 1) + digitCount(x + 1))
+    {
+        // Next line is usually cheaper to reach with a newline
+        this->buffer += "\r\n";
+        if (x > 0)
+        {
+            snprintf(sequence, sizeof(sequence), "\x1b[%dC", x);
+            this->buffer += sequence;
+        }
+    }
+    else
+    {
+        snprintf(sequence, sizeof(sequence), "\x1b[%d;%dH", y + 1, x + 1);
+        this->buffer += sequence;
+    }
+
+    this->nCursorX = x;
+    this->nCursorY = y;
+}
+
+void TerminalOutput::setColor(Color color)
+{
+    if (this->nColor == color)
+    {
+        return;
+    }
+
+    int foreground = ansiColor(color & 0x7) + ((color & 0x8) ? 90 : 30);
+    int background = ansiColor((color >> 4) & 0x7) + ((color & 0x80) ? 100 : 40);
+
+    char sequence[32];
+    snprintf(sequence, sizeof(sequence), "\x1b[%d;%dm", foreground, background);
+    this->buffer += sequence;
+    this->nColor = color;
+}
+
+void TerminalOutput::appendGlyph(Glyph ch)
+{
+    unsigned int code = (unsigned int)ch;
+    if (code == 0)
+    {
+        code = ' ';
+    }
+
+    if (code < 0x80)
+    {
+        this->buffer += (char)code;
+    }
+    else if (code < 0x800)
+    {
+        this->buffer += (char)(0xC0 | (code >> 6));
+        this->buffer += (char)(0x80 | (code & 0x3F));
+    }
+    else
+    {
+        this->buffer += (char)(0xE0 | ((code >> 12) & 0x0F));
+        this->buffer += (char)(0x80 | ((code >> 6) & 0x3F));
+        this->buffer += (char)(0x80 | (code & 0x3F));
+    }
+}
+
+void TerminalOutput::present(const Framebuffer& frame)
+{
+    if (frame.nWidth != this->previous.nWidth || frame.nHeight != this->previous.nHeight)
+    {
+        this->previous = Framebuffer(frame.nWidth, frame.nHeight);
+        this->bValid = false;
+    }
+
+    this->buffer.clear();
+    this->nCursorX = -1;
+    this->nCursorY = -1;
+    this->nLastCells = 0;
+    if (!this->bValid)
+    {
+        // Unknown terminal state: start from a known color
+        this->buffer += "\x1b[0m";
+        this->nColor = -1;
+    }
+
+    for (int y = 0; y < frame.nHeight; y++)
+    {
+        int rowStart = y * frame.nWidth;
+        if (this->bValid &&
+            memcmp(&frame.chars[rowStart], &this->previous.chars[rowStart], frame.nWidth * sizeof(Glyph)) == 0 &&
+            memcmp(&frame.colors[rowStart], &this->previous.colors[rowStart], frame.nWidth * sizeof(Color)) == 0)
+        {
+            continue;
+        }
+
+        for (int x = 0; x < frame.nWidth; x++)
+        {
+            int index = rowStart + x;
+            if (this->bValid && frame.chars[index] == this->previous.chars[index] && frame.colors[index] == this->previous.colors[index])
+            {
+                continue;
+            }
+
+            this->moveCursor(x, y, frame);
+            this->setColor(frame.colors[index]);
+            this->appendGlyph(frame.chars[index]);
+            this->nLastCells++;
+
+            // Past the last column the cursor position depends on the terminal's wrap mode
+            this->nCursorX = x + 1 < frame.nWidth ? x + 1 : -1;
+        }
+    }
+
+    this->previous.chars = frame.chars;
+    this->previous.colors = frame.colors;
+
+    // After a short write the screen is unknown, the next frame is drawn in full
+    this->bValid = this->flush();
+    this->nLastBytes = (long long)this->buffer.size();
+    this->nTotalBytes += this->nLastBytes;
+    this->nFrames++;
+}
@@ -0,0 +1,71 @@
+#ifndef TERMINAL_H
+#define TERMINAL_H
+
+#include <string>
+#include <vector>
+#include "framebuffer.h"
+
+/*
+    Output backend for ANSI/VT terminals (Linux consoles, terminal emulators, SSH sessions).
+    Keeps the last presented frame and only sends the cells that changed since then:
+    rows that are equal are skipped, the cursor is only moved when the next changed cell
+    isn't where it already is, and SGR color sequences are only sent when the color changes.
+    Every frame is written with one write() from a buffer that is reused between frames.
+*/
+
+class TerminalOutput
+{
+private:
+    int fd;
+    Framebuffer previous;
+    bool bValid = false;    // previous matches what is on the terminal
+    std::string buffer;
+
+    // Cursor and color the terminal is in while a frame is encoded, -1 if unknown
+    int nCursorX = -1;
+    int nCursorY = -1;
+    int nColor = -1;
+
+    long long nLastBytes = 0;
+    long long nTotalBytes = 0;
+    long long nFrames = 0;
+    int nLastCells = 0;
+
+    void moveCursor(int x, int y, const Framebuffer& frame);
+
+    void setColor(Color color);
+
+    void appendGlyph(Glyph ch);
+
+    // Writes the buffer, returns false if not all of it was written
+    bool flush();
+
+public:
+    // fd is usually 1 (stdout)
+    explicit TerminalOutput(int fd = 1);
+
+    ~TerminalOutput();
+
+    // Switches to the alternate screen and hides the cursor
+    void begin();
+
+    // Restores the screen, cursor and colors
+    void end();
+
+    // Forces a full redraw on the next present(), e.g. after the terminal was resized
+    void invalidate() { this->bValid = false; }
+
+    void present(const Framebuffer& frame);
+
+    // Bytes written for the last frame
+    long long getLastFrameBytes() const { return this->nLastBytes; }
+
+    // Cells sent for the last frame
+    int getLastFrameCells() const { return this->nLastCells; }
+
+    long long getTotalBytes() const { return this->nTotalBytes; }
+
+    long long getFrameCount() const { return this->nFrames; }
+};
+
+#endif
@@ -0,0 +1,160 @@
+#include "threadpool.h"
+
+
+static unsigned long long packRange(unsigned int first, unsigned int last)
+{
+    return ((unsigned long long)first << 32) | last;
+}
+
+static unsigned int rangeFirst(unsigned long long range) { return (unsigned int)(range >> 32); }
+
+static unsigned int rangeLast(unsigned long long range) { return (unsigned int)range; }
+
+
+ThreadPool::ThreadPool(int threadCount)
+{
+    if (threadCount <= 0)
+    {
+        threadCount = (int)std::thread::hardware_concurrency();
+        threadCount = threadCount > 0 ? threadCount : 1;
+    }
+
+    this->ranges = std::vector<JobRange>(threadCount);
+    for (JobRange& range: this->ranges)
+    {
+        range.range.store(0);
+    }
+
+    // Worker 0 is the thread calling run()
+    for (int i = 1; i < threadCount; i++)
+    {
+        this->threads.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->bStopping = true;
+    }
+    this->wakeUp.notify_all();
+
+    for (std::thread& thread: this->threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::run(int jobCount, const JobFunction& fn)
+{
+    if (jobCount <= 0)
+    {
+        return;
+    }
+
+    int workers = (int)this->ranges.size();
+    if (workers == 1)
+    {
+        for (int i = 0; i < jobCount; i++)
+        {
+            fn(i);
+        }
+        return;
+    }
+
+    // Even split, stealing evens out whatever is left
+    for (int i = 0; i < workers; i++)
+    {
+        unsigned int first = (unsigned int)((long long)jobCount * i / workers);
+        unsigned int last = (unsigned int)((long long)jobCount * (i + 1) / workers);
+        this->ranges[i].range.store(packRange(first, last));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->job = &fn;
+        this->nBusyThreads = (int)this->threads.size();
+        this->nGeneration++;
+    }
+    this->wakeUp.notify_all();
+
+    this->drain(0);
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->finished.wait(lock, [this]() { return this->nBusyThreads == 0; });
+    this->job = nullptr;
+}
+
+void ThreadPool::workerLoop(int worker)
+{
+    unsigned long long seenGeneration = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->wakeUp.wait(lock, [&]() { return this->bStopping || this->nGeneration != seenGeneration; });
+            if (this->bStopping)
+            {
+                return;
+            }
+            seenGeneration = this->nGeneration;
+        }
+
+        this->drain(worker);
+
+        bool last;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            last = --this->nBusyThreads == 0;
+        }
+        if (last)
+        {
+            this->finished.notify_one();
+        }
+    }
+}
+
+void ThreadPool::drain(int worker)
+{
+    const JobFunction& fn = *this->job;
+    int index;
+    while (this->takeOwn(worker, index) || this->steal(worker, index))
+    {
+        fn(index);
+    }
+}
+
+bool ThreadPool::takeOwn(int worker, int& index)
+{
+    std::atomic<unsigned long long>& own = this->ranges[worker].range;
+    unsigned long long range = own.load();
+    while (rangeFirst(range) < rangeLast(range))
+    {
+        if (own.compare_exchange_weak(range, packRange(rangeFirst(range) + 1, rangeLast(range))))
+        {
+            index = (int)rangeFirst(range);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::steal(int worker, int& index)
+{
+    int workers = (int)this->ranges.size();
+    for (int offset = 1; offset < workers; offset++)
+    {
+        std::atomic<unsigned long long>& victim = this->ranges[(worker + offset) % workers].range;
+        unsigned long long range = victim.load();
+        while (rangeFirst(range) < rangeLast(range))
+        {
+            if (victim.compare_exchange_weak(range, packRange(rangeFirst(range), rangeLast(range) - 1)))
+            {
+                index = (int)rangeLast(range) - 1;
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,84 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+    Persistent pool of worker threads for data-parallel loops.
+    Threads are created once and sleep between calls of run(). Each call splits the jobs
+    into one contiguous range per worker; a worker takes jobs from the front of its own
+    range and, when that is empty, steals from the back of the others'. Ranges are packed
+    into one 64-bit atomic each, so taking and stealing never lock.
+*/
+
+// Non-owning reference to a callable taking a job index. Unlike std::function it never allocates,
+//     the callable has to outlive the reference (a lambda passed straight to run() does)
+class JobFunction
+{
+private:
+    const void* callable;
+    void (*invoke)(const void* callable, int index);
+
+    template<typename F>
+    static void invokeCallable(const void* callable, int index) { (*static_cast<const F*>(callable))(index); }
+
+public:
+    template<typename F>
+    JobFunction(const F& fn): callable(&fn), invoke(&JobFunction::invokeCallable<F>) {}
+
+    void operator()(int index) const { this->invoke(this->callable, index); }
+};
+
+class ThreadPool
+{
+private:
+    // Jobs [first, last) that still belong to a worker. Padded by hand rather than with alignas: std::vector
+    //     doesn't honour over-alignment before C++17, and 64 bytes apart no two ranges share a cache line anyway
+    struct JobRange
+    {
+        std::atomic<unsigned long long> range;
+        char padding[64 - sizeof(std::atomic<unsigned long long>)];
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<JobRange> ranges;   // One per thread plus one for the caller
+
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable finished;
+    unsigned long long nGeneration = 0;
+    int nBusyThreads = 0;
+    bool bStopping = false;
+
+    const JobFunction* job = nullptr;
+
+    void workerLoop(int worker);
+
+    // Runs jobs of the current call until none are left anywhere
+    void drain(int worker);
+
+    bool takeOwn(int worker, int& index);
+
+    bool steal(int worker, int& index);
+
+public:
+    // threadCount includes the calling thread, 0 means hardware concurrency
+    explicit ThreadPool(int threadCount = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int getThreadCount() const { return (int)this->ranges.size(); }
+
+    // Calls fn(0) ... fn(jobCount - 1) on the pool and the calling thread, returns when all are done
+    void run(int jobCount, const JobFunction& fn);
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef VECMATH_H
+#define VECMATH_H
+
+#include <math.h>
+
+/*
+    Header-only vector math used by the hot rendering code.
+    Everything that can be is constexpr and inline; nothing computes a square root
+    unless length() or normalized() is asked for.
+*/
+
+namespace vecmath
+{
+
+struct Vec3
+{
+    float x, y, z;
+
+    constexpr Vec3(): x(0.0f), y(0.0f), z(0.0f) {}
+
+    constexpr Vec3(float x, float y, float z): x(x), y(y), z(z) {}
+
+    // Out of range index reads x
+    constexpr float operator[](int index) const { return index == 1 ? y : (index == 2 ? z : x); }
+
+    float& operator[](int index) { return index == 1 ? y : (index == 2 ? z : x); }
+};
+
+constexpr Vec3 operator+(Vec3 a, Vec3 b) { return Vec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+
+constexpr Vec3 operator-(Vec3 a, Vec3 b) { return Vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+
+constexpr Vec3 operator-(Vec3 a) { return Vec3(-a.x, -a.y, -a.z); }
+
+constexpr Vec3 operator*(Vec3 a, float s) { return Vec3(a.x * s, a.y * s, a.z * s); }
+
+constexpr Vec3 operator/(Vec3 a, float s) { return Vec3(a.x / s, a.y / s, a.z / s); }
+
+constexpr bool operator==(Vec3 a, Vec3 b) { return a.x == b.x && a.y == b.y && a.z == b.z; }
+
+constexpr float dot(Vec3 a, Vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+constexpr Vec3 cross(Vec3 a, Vec3 b) { return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+
+constexpr float lengthSquared(Vec3 a) { return dot(a, a); }
+
+inline float length(Vec3 a) { return sqrtf(lengthSquared(a)); }
+
+// Zero vector stays zero
+inline Vec3 normalized(Vec3 a)
+{
+    float len = length(a);
+    return len != 0.0f ? a / len : a;
+}
+
+// origin + direction * t
+struct Ray
+{
+    Vec3 origin;
+    Vec3 direction;
+
+    constexpr Ray() {}
+
+    constexpr Ray(Vec3 origin, Vec3 direction): origin(origin), direction(direction) {}
+
+    constexpr Vec3 at(float t) const { return Vec3(origin.x + direction.x * t, origin.y + direction.y * t, origin.z + direction.z * t); }
+};
+
+// dot(normal, p) + d = 0
+struct Plane
+{
+    Vec3 normal;
+    float d;
+
+    constexpr Plane(): d(0.0f) {}
+
+    constexpr Plane(Vec3 normal, float d): normal(normal), d(d) {}
+
+    static constexpr Plane fromPointNormal(Vec3 point, Vec3 normal) { return Plane(normal, -1 * dot(normal, point)); }
+
+    constexpr float signedDistance(Vec3 p) const { return dot(p, normal) + d; }
+
+    // Writes ray parameter of the intersection, returns false if the ray is parallel to the plane
+    bool intersect(const Ray& ray, float& t) const
+    {
+        float denominator = dot(ray.direction, normal);
+        if (fabsf(denominator) < 1e-6)
+        {
+            return false;
+        }
+        t = -signedDistance(ray.origin) / denominator;
+        return true;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,59 @@
+#include "wallmesh.h"
+
+
+std::vector<WallRect> mergeWallSquares(const MapFile& map)
+{
+    int width = map.getWidth();
+    int height = map.getHeight();
+    std::vector<bool> merged((size_t)width * height, false);
+    std::vector<WallRect> rects;
+
+    auto isFree = [&](int x, int y)
+    {
+        return map.getCell(x, y) == '#' && !merged[(size_t)y * width + x];
+    };
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            if (!isFree(x, y))
+            {
+                continue;
+            }
+
+            int runWidth = 1;
+            while (x + runWidth < width && isFree(x + runWidth, y))
+            {
+                runWidth++;
+            }
+
+            int runHeight = 1;
+            while (y + runHeight < height)
+            {
+                bool full = true;
+                for (int i = 0; i < runWidth && full; i++)
+                {
+                    full = isFree(x + i, y + runHeight);
+                }
+                if (!full)
+                {
+                    break;
+                }
+                runHeight++;
+            }
+
+            for (int j = 0; j < runHeight; j++)
+            {
+                for (int i = 0; i < runWidth; i++)
+                {
+                    merged[(size_t)(y + j) * width + x + i] = true;
+                }
+            }
+
+            WallRect rect = { x, y, runWidth, runHeight };
+            rects.push_back(rect);
+        }
+    }
+    return rects;
+}
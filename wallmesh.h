@@ -0,0 +1,24 @@
+#ifndef WALLMESH_H
+#define WALLMESH_H
+
+#include <vector>
+#include "mapfile.h"
+
+/*
+    Greedy meshing of wall squares into boxes.
+    Wall squares are merged in row-major order: a run of walls is grown along x as far as
+    it goes, then along y while the whole run below is wall too. Every wall square ends up
+    in exactly one rectangle, so the faces between neighbouring walls, which can never be
+    seen, are gone with the squares merged over them.
+*/
+
+struct WallRect
+{
+    int nX, nY;             // First square
+    int nWidth, nHeight;    // In squares
+};
+
+// Merges the '#' squares of the map, rectangles come in the order of their first square
+std::vector<WallRect> mergeWallSquares(const MapFile& map);
+
+#endif
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include "world.h"
+#include "wallmesh.h"
+
+
+World::World()
+{
+}
+
+World::~World()
+{
+    for (GameObject* obj: this->objects)
+    {
+        delete obj;
+    }
+}
+
+void World::clearWorld()
+{
+    // The streamer, grid and collision map read the map cells, let go of them before the cells change
+    this->streamer.stop();
+    this->grid = MapGrid();
+    this->collisionMap = CollisionMap();
+
+    for (GameObject* obj: this->objects)
+    {
+        delete obj;
+    }
+    this->objects.clear();
+    this->sprites.clear();
+    this->bvh.build(this->objects);
+    this->scene.build(this->objects);
+    this->pvs.clear();
+    this->bWallObjects = false;
+    this->nWallBoxCount = 0;
+    this->nRevision++;
+}
+
+void World::setUpMap()
+{
+    this->clearWorld();
+    std::wstring map;
+    map += L"################";
+    map += L"#..............#";
+    map += L"#..............#";
+    map += L"#..............#";
+    map += L"#..............#";
+    map += L"#..............#";
+    map += L"#..............#";
+    map += L"#........##....#";
+    map += L"#..............#";
+    map += L"#..............#";
+    map += L"#..............#";
+    map += L"#..............#";
+    map += L"#..............#";
+    map += L"#..............#";
+    map += L"#..............#";
+    map += L"################";
+    this->mapFile.setCells(16, 16, map);
+}
+
+void World::setMap(int width, int height, const std::wstring& cells)
+{
+    this->clearWorld();
+    this->mapFile.setCells(width, height, cells);
+}
+
+bool World::loadMap(const std::string& path)
+{
+    this->clearWorld();
+    return this->mapFile.load(path, this->nStreamingCap > 0);
+}
+
+wchar_t World::getMapCell(int x, int y) const
+{
+    if (this->mapFile.isStreamed())
+    {
+        return this->grid.isWall(x, y) ? '#' : '.';
+    }
+    return this->mapFile.getCell(x, y);
+}
+
+void World::enableStreaming(size_t memoryCap, int loadRadius)
+{
+    this->nStreamingCap = memoryCap;
+    this->nStreamingRadius = loadRadius;
+}
+
+void World::buildWorldFromMap()
+{
+    this->clearWorld();
+    int nMapWidth = this->mapFile.getWidth();
+    int nMapHeight = this->mapFile.getHeight();
+    this->grid = MapGrid(nMapWidth, nMapHeight, this->mapFile.getCells(), COLOR_BLUE);
+    this->collisionMap = CollisionMap(nMapWidth, nMapHeight, this->mapFile.getCells());
+
+    if (this->nStreamingCap > 0)
+    {
+        // Chunks are read from the map file, or copied from the map cells if they are in memory.
+        //     Past the map edge is empty
+        const MapFile& map = this->mapFile;
+        this->streamer.start(nMapWidth, nMapHeight, N_STREAMING_CHUNK_SHIFT, this->nStreamingCap,
+            [&map](int firstX, int firstY, int size, unsigned char* cells)
+            {
+                memset(cells, '.', size * size);
+                int width = std::min(size, map.getWidth() - firstX);
+                int height = std::min(size, map.getHeight() - firstY);
+                if (!map.readCells(firstX, firstY, width, height, cells, size))
+                {
+                    // A chunk that can't be read is empty
+                    memset(cells, '.', size * size);
+                }
+            });
+        this->streamer.setLoadRadius(this->nStreamingRadius);
+        this->grid.setChunks(this->streamer.getTable(), N_STREAMING_CHUNK_SHIFT, this->streamer.getChunksX());
+        if (this->mapFile.isStreamed())
+        {
+            this->collisionMap.setChunks(this->streamer.getTable(), N_STREAMING_CHUNK_SHIFT, this->streamer.getChunksX(),
+                this->streamer.getTableLock());
+        }
+    }
+
+    this->bWallObjects = this->nStreamingCap == 0 && !this->mapFile.isStreamed() && this->mapFile.getWallCount() <= this->nWallObjectLimit;
+    std::vector<WallRect> wallRects;    // Squares of every wall object
+    if (this->bWallObjects && this->bMergeWalls)
+    {
+        // The grid wants the squares of wall objects in row-major order
+        std::vector<std::pair<long long, GameObject*>> squares;
+        squares.reserve(this->mapFile.getWallCount());
+
+        wallRects = mergeWallSquares(this->mapFile);
+        for (const WallRect& rect: wallRects)
+        {
+            Vector3D minCorner(rect.nX * N_MAP_WORLD_RATIO - 2.5f, rect.nY * N_MAP_WORLD_RATIO - 2.5f, 0.0f);
+            Vector3D maxCorner((rect.nX + rect.nWidth - 1) * N_MAP_WORLD_RATIO + 2.5f, (rect.nY + rect.nHeight - 1) * N_MAP_WORLD_RATIO + 2.5f, 5.0f);
+            Box* newBox = new Box(minCorner, maxCorner, '#', COLOR_BLUE);
+            this->objects.push_back(newBox);
+            this->nWallBoxCount++;
+
+            for (int y = rect.nY; y < rect.nY + rect.nHeight; y++)
+            {
+                for (int x = rect.nX; x < rect.nX + rect.nWidth; x++)
+                {
+                    squares.push_back(std::make_pair((long long)y * nMapWidth + x, (GameObject*)newBox));
+                }
+            }
+        }
+
+        std::sort(squares.begin(), squares.end());
+        for (const std::pair<long long, GameObject*>& square: squares)
+        {
+            this->grid.addWallObject((int)(square.first % nMapWidth), (int)(square.first / nMapWidth), square.second);
+        }
+    }
+    else if (this->bWallObjects)
+    {
+        for (int y = 0; y < nMapHeight; y++)
+        {
+            for (int x = 0; x < nMapWidth; x++)
+            {
+                if (this->mapFile.getCell(x, y) == '#')
+                {
+                    Vector3D centerPos(x * N_MAP_WORLD_RATIO, y * N_MAP_WORLD_RATIO, 2.5f);
+                    Cube* newCube = new Cube(centerPos, '#', COLOR_BLUE, 0.0f);
+                    this->objects.push_back(newCube);
+                    this->grid.addWallObject(x, y, newCube);
+                    this->nWallBoxCount++;
+                    wallRects.push_back({ x, y, 1, 1 });
+                }
+            }
+        }
+    }
+    Floor* floor = new Floor(COLOR_RED);
+    Ceiling* ceiling = new Ceiling(COLOR_RED | COLOR_GREEN);
+    this->objects.push_back(floor);
+    this->objects.push_back(ceiling);
+    this->grid.addLooseObject(floor);
+    this->grid.addLooseObject(ceiling);
+
+    // Objects from the map's object table
+    const MapObjectRecord* records = this->mapFile.getObjects();
+    for (int i = 0; i < this->mapFile.getObjectCount(); i++)
+    {
+        if (records[i].nType == MAP_OBJECT_CUBE)
+        {
+            Vector3D centerPos(records[i].fPos[0], records[i].fPos[1], records[i].fPos[2]);
+            Cube* newCube = new Cube(centerPos, (Glyph)records[i].nGlyph, records[i].nColor, 0.0f);
+            this->objects.push_back(newCube);
+            this->grid.addLooseObject(newCube);
+        }
+    }
+
+    this->bvh.build(this->objects);
+    this->scene.build(this->objects);
+    if (this->bBuildPvs && !this->mapFile.isStreamed())
+    {
+        this->pvs.build(this->mapFile, wallRects);
+    }
+    else
+    {
+        this->pvs.clear();
+    }
+    this->nRevision++;
+}
+
+void World::updateStreaming(Vector3D playerPos)
+{
+    int squareX = (int)floorf((playerPos[0] + N_MAP_WORLD_RATIO / 2.0f) / N_MAP_WORLD_RATIO);
+    int squareY = (int)floorf((playerPos[1] + N_MAP_WORLD_RATIO / 2.0f) / N_MAP_WORLD_RATIO);
+    if (this->streamer.update(squareX, squareY))
+    {
+        // What the grid sees changed, cached frames are stale
+        this->nRevision++;
+    }
+}
+
+void World::addObjects(const std::vector<GameObject*>& newObjects)
+{
+    for (GameObject* obj: newObjects)
+    {
+        this->objects.push_back(obj);
+        this->grid.addLooseObject(obj);
+    }
+    this->bvh.build(this->objects);
+    this->scene.build(this->objects);
+    this->nRevision++;
+}
+
+int World::addSprite(const Sprite& sprite)
+{
+    // Sprites aren't in the render structures, so frames reused by reprojection stay valid
+    this->sprites.push_back(sprite);
+    return (int)this->sprites.size() - 1;
+}
+
+void World::setSpritePos(int index, Vector3D pos)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        this->sprites[index].fPos[i] = pos[i];
+    }
+}
+
+void World::moveObject(GameObject* obj, Vector3D direction, float dt)
+{
+    obj->move(direction, dt);
+    this->bvh.refit(obj);
+    this->scene.updateObject(obj);
+    this->nRevision++;
+}
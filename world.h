@@ -0,0 +1,149 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <string>
+#include <vector>
+#include "objects.h"
+#include "mapfile.h"
+#include "grid.h"
+#include "bvh.h"
+#include "scene.h"
+#include "streamer.h"
+#include "collision.h"
+#include "sprite.h"
+#include "pvs.h"
+
+/*
+    Map and the scene objects built from it.
+    Map characters: '#' - wall, '.' - empty
+    Maps with up to N_MAX_WALL_OBJECTS walls get wall objects like any other object: runs of
+    wall squares are merged into Box objects (see wallmesh.h), or a Cube per wall if merging is off.
+    Larger maps keep their walls only in the map cells, which the grid reads in place, so
+    memory grows with the objects in the map and not with its area.
+    Wall objects come first in the object list. On request, small enough maps also get the
+    potentially visible sets of their wall objects (see pvs.h).
+    With streaming enabled the grid only sees the map chunks near the player, which a
+    ChunkStreamer loads in the background and evicts under a memory cap. A binary map loaded
+    with streaming enabled is opened for streaming (see mapfile.h): its cells stay in the file,
+    chunks are read from it and collision reads the resident chunks, so the map's cells take no
+    more memory than the cap and startup doesn't grow with its size. A text map is read into
+    memory in full, chunks are copied from it and collision reads the full cells.
+*/
+
+const int N_MAX_WALL_OBJECTS = 1 << 16;
+const int N_STREAMING_CHUNK_SHIFT = 6;  // Streamed chunks are 64 x 64 squares
+
+class World
+{
+private:
+    MapFile mapFile;
+    ChunkStreamer streamer;         // After mapFile, so its loader stops before the map goes away
+    size_t nStreamingCap = 0;
+    int nStreamingRadius = 1;
+    int nWallObjectLimit = N_MAX_WALL_OBJECTS;
+    bool bWallObjects = false;
+    bool bMergeWalls = true;
+    bool bBuildPvs = false;
+    int nWallBoxCount = 0;          // Wall objects built, boxes or cubes
+    std::vector<GameObject*> objects;
+    std::vector<Sprite> sprites;
+    MapGrid grid;
+    CollisionMap collisionMap;
+    Bvh bvh;
+    PvsTable pvs;
+    Scene scene;
+    unsigned int nRevision = 0;     // Changes whenever objects are added or moved
+
+    // Deletes the objects and sprites and empties the structures built from the map
+    void clearWorld();
+
+public:
+    World();
+
+    ~World();
+
+    int getMapWidth() const { return this->mapFile.getWidth(); }
+
+    int getMapHeight() const { return this->mapFile.getHeight(); }
+
+    // Squares of chunks that are not resident read as empty while a streamed map file is open
+    wchar_t getMapCell(int x, int y) const;
+
+    const MapFile& getMapFile() const { return this->mapFile; }
+
+    // True if every wall has a Cube in the object list, otherwise walls are only in the grid
+    bool hasWallObjects() const { return this->bWallObjects; }
+
+    // Most walls that get objects, takes effect in buildWorldFromMap
+    void setWallObjectLimit(int limit) { this->nWallObjectLimit = limit; }
+
+    // Merge wall squares into boxes (default) or give each its own Cube, takes effect in buildWorldFromMap
+    void setMergeWalls(bool merge) { this->bMergeWalls = merge; }
+
+    // Build the potentially visible sets of the wall objects, takes effect in buildWorldFromMap.
+    //     Costs about a microsecond per open square and wall object
+    void setBuildPvs(bool build) { this->bBuildPvs = build; }
+
+    int getWallBoxCount() const { return this->nWallBoxCount; }
+
+    const std::vector<GameObject*>& getObjects() const { return this->objects; }
+
+    const std::vector<Sprite>& getSprites() const { return this->sprites; }
+
+    // Sprites are drawn over the rendered walls, see sprite.h. Returns the index of the new sprite
+    int addSprite(const Sprite& sprite);
+
+    void setSpritePos(int index, Vector3D pos);
+
+    void clearSprites() { this->sprites.clear(); }
+
+    const MapGrid& getGrid() const { return this->grid; }
+
+    // Walls movers collide with, only the resident chunks of a streamed map file
+    const CollisionMap& getCollisionMap() const { return this->collisionMap; }
+
+    const Bvh& getBvh() const { return this->bvh; }
+
+    const Scene& getScene() const { return this->scene; }
+
+    // Wall objects each open square may see, empty if not requested, walls have no objects or the map is too large
+    const PvsTable& getPvs() const { return this->pvs; }
+
+    const ChunkStreamer& getStreamer() const { return this->streamer; }
+
+    unsigned int getRevision() const { return this->nRevision; }
+
+    // Replacing the map deletes everything built from the old one, objects and sprites included.
+    //     The world is empty until it is built again
+    void setUpMap();
+
+    // Replaces the map with a width x height one, rows are stored one after another
+    void setMap(int width, int height, const std::wstring& cells);
+
+    // Loads a text or binary map file (see mapfile.h). Call enableStreaming first to stream it from the file
+    bool loadMap(const std::string& path);
+
+    bool saveMap(const std::string& path) const { return this->mapFile.saveBinary(path); }
+
+    // Streams the map around the player in chunks, keeping at most memoryCap bytes of chunks.
+    //     Walls get no Cube objects then. Takes effect in loadMap and buildWorldFromMap
+    void enableStreaming(size_t memoryCap, int loadRadius = 1);
+
+    // Builds the objects, grid and render structures, replacing those of an earlier build.
+    //     Objects and sprites added since are deleted as well
+    void buildWorldFromMap();
+
+    // Publishes loaded chunks and requests the ones near the player, call between frames
+    void updateStreaming(Vector3D playerPos);
+
+    // Blocks until the requested chunks are loaded, the next updateStreaming publishes them
+    void waitForStreaming() { this->streamer.waitUntilIdle(); }
+
+    // Adds free-standing objects (not bound to map squares), the world takes ownership
+    void addObjects(const std::vector<GameObject*>& newObjects);
+
+    // Moves an object and updates the BVH and scene arrays around it
+    void moveObject(GameObject* obj, Vector3D direction, float dt);
+};
+
+#endif